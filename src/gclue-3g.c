@@ -27,6 +27,7 @@
 #include "gclue-modem-manager.h"
 #include "gclue-location.h"
 #include "gclue-mozilla.h"
+#include "gclue-cell-registry.h"
 
 /**
  * SECTION:gclue-3g
@@ -43,6 +44,8 @@ struct _GClue3GPrivate {
         gulong threeg_notify_id;
 
         GClue3GTower *tower;
+        GClueCellRegistry *cell_registry;
+        gulong combining_notify_id;
 };
 
 G_DEFINE_TYPE_WITH_CODE (GClue3G,
@@ -57,10 +60,10 @@ gclue_3g_stop (GClueLocationSource *source);
 static SoupMessage *
 gclue_3g_create_query (GClueWebSource *web,
                        GError        **error);
-static SoupMessage *
-gclue_3g_create_submit_query (GClueWebSource  *web,
-                              GClueLocation   *location,
-                              GError         **error);
+static GClueSubmission *
+gclue_3g_create_submission (GClueWebSource  *web,
+                            GClueLocation   *location,
+                            GError         **error);
 static GClueAccuracyLevel
 gclue_3g_get_available_accuracy_level (GClueWebSource *web,
                                        gboolean available);
@@ -103,6 +106,20 @@ on_is_3g_available_notify (GObject    *gobject,
                                        source);
 }
 
+/* Once the WiFi source stops sending our tower along, we need to look it up
+ * ourselves again.
+ */
+static void
+on_combining_notify (GObject    *gobject,
+                     GParamSpec *pspec,
+                     gpointer    user_data)
+{
+        GClue3G *source = GCLUE_3G (user_data);
+
+        if (!gclue_cell_registry_get_combining (source->priv->cell_registry))
+                gclue_web_source_refresh (GCLUE_WEB_SOURCE (source));
+}
+
 static GClueLocation *
 gclue_3g_parse_response (GClueWebSource *web,
                          const char     *content,
@@ -124,8 +141,12 @@ gclue_3g_finalize (GObject *g3g)
         g_signal_handler_disconnect (priv->modem,
                                      priv->threeg_notify_id);
         priv->threeg_notify_id = 0;
+        g_signal_handler_disconnect (priv->cell_registry,
+                                     priv->combining_notify_id);
+        priv->combining_notify_id = 0;
 
         g_clear_object (&priv->modem);
+        g_clear_object (&priv->cell_registry);
         g_clear_object (&priv->cancellable);
 }
 
@@ -141,7 +162,7 @@ gclue_3g_class_init (GClue3GClass *klass)
         source_class->start = gclue_3g_start;
         source_class->stop = gclue_3g_stop;
         web_class->create_query = gclue_3g_create_query;
-        web_class->create_submit_query = gclue_3g_create_submit_query;
+        web_class->create_submission = gclue_3g_create_submission;
         web_class->parse_response = gclue_3g_parse_response;
         web_class->get_available_accuracy_level =
                 gclue_3g_get_available_accuracy_level;
@@ -163,6 +184,13 @@ gclue_3g_init (GClue3G *source)
                                           "notify::is-3g-available",
                                           G_CALLBACK (on_is_3g_available_notify),
                                           source);
+
+        priv->cell_registry = gclue_cell_registry_get_singleton ();
+        priv->combining_notify_id =
+                        g_signal_connect (priv->cell_registry,
+                                          "notify::combining",
+                                          G_CALLBACK (on_combining_notify),
+                                          source);
 }
 
 static void
@@ -212,13 +240,17 @@ gclue_3g_create_query (GClueWebSource *web,
                 return NULL; /* Not initialized yet */
         }
 
+        /* Sent along with the WiFi query, nothing to do and nothing wrong */
+        if (gclue_cell_registry_get_combining (priv->cell_registry))
+                return NULL;
+
         return gclue_mozilla_create_query (NULL, priv->tower, error);
 }
 
-static SoupMessage *
-gclue_3g_create_submit_query (GClueWebSource  *web,
-                              GClueLocation   *location,
-                              GError         **error)
+static GClueSubmission *
+gclue_3g_create_submission (GClueWebSource  *web,
+                            GClueLocation   *location,
+                            GError         **error)
 {
         GClue3GPrivate *priv = GCLUE_3G (web)->priv;
 
@@ -230,10 +262,10 @@ gclue_3g_create_submit_query (GClueWebSource  *web,
                 return NULL; /* Not initialized yet */
         }
 
-        return gclue_mozilla_create_submit_query (location,
-                                                  NULL,
-                                                  priv->tower,
-                                                  error);
+        return gclue_mozilla_create_submission (location,
+                                                NULL,
+                                                priv->tower,
+                                                error);
 }
 
 static GClueAccuracyLevel
@@ -263,8 +295,10 @@ on_fix_3g (GClueModem *modem,
         priv->tower->mnc = mnc;
         priv->tower->lac = lac;
         priv->tower->cell_id = cell_id;
+        gclue_cell_registry_set_tower (priv->cell_registry, priv->tower);
 
-        gclue_web_source_refresh (GCLUE_WEB_SOURCE (user_data));
+        if (!gclue_cell_registry_get_combining (priv->cell_registry))
+                gclue_web_source_refresh (GCLUE_WEB_SOURCE (user_data));
 }
 
 static gboolean
@@ -314,6 +348,7 @@ gclue_3g_stop (GClueLocationSource *source)
         g_signal_handlers_disconnect_by_func (G_OBJECT (priv->modem),
                                               G_CALLBACK (on_fix_3g),
                                               source);
+        gclue_cell_registry_set_tower (priv->cell_registry, NULL);
 
         if (gclue_modem_get_is_3g_available (priv->modem))
                 if (!gclue_modem_disable_3g (priv->modem,
@@ -0,0 +1,304 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-cell-registry.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <glib.h>
+#include "gclue-cell-registry.h"
+
+/**
+ * SECTION:gclue-cell-registry
+ * @short_description: Current cell tower, shared between sources
+ *
+ * The 3G source publishes the cell tower the modem is currently camped on
+ * here, for as long as it is active. While the street-level WiFi source is
+ * scanning, it sends that tower along with the access points in its queries,
+ * and says so through #GClueCellRegistry:combining. The 3G source then leaves
+ * the querying to it, so there is a single request with both observations,
+ * getting a single answer fused by the geolocation service, rather than two
+ * requests with competing answers.
+ *
+ * Only locators running the street-level WiFi source get that answer though.
+ * While any locator runs the 3G source without it, the tower is still looked
+ * up on its own.
+ **/
+
+struct _GClueCellRegistryPrivate
+{
+        GClue3GTower tower;
+        gboolean has_tower;
+
+        gboolean wifi_combining;
+        guint n_standalone_users; /* Locators without street-level WiFi */
+        gboolean combining;       /* And none of the above */
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueCellRegistry,
+                         gclue_cell_registry,
+                         G_TYPE_OBJECT,
+                         G_ADD_PRIVATE (GClueCellRegistry))
+
+enum
+{
+        PROP_0,
+        PROP_COMBINING,
+        LAST_PROP
+};
+static GParamSpec *gParamSpecs[LAST_PROP];
+
+enum {
+        TOWER_CHANGED,
+        SIGNAL_LAST
+};
+static guint signals[SIGNAL_LAST];
+
+static void
+gclue_cell_registry_get_property (GObject    *object,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+        GClueCellRegistry *registry = GCLUE_CELL_REGISTRY (object);
+
+        switch (prop_id) {
+        case PROP_COMBINING:
+                g_value_set_boolean (value, registry->priv->combining);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_cell_registry_class_init (GClueCellRegistryClass *klass)
+{
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        object_class->get_property = gclue_cell_registry_get_property;
+
+        gParamSpecs[PROP_COMBINING] =
+                g_param_spec_boolean ("combining",
+                                      "Combining",
+                                      "Whether the cell tower is sent along "
+                                      "with the WiFi queries",
+                                      FALSE,
+                                      G_PARAM_READABLE);
+        g_object_class_install_property (object_class,
+                                         PROP_COMBINING,
+                                         gParamSpecs[PROP_COMBINING]);
+
+        /**
+         * GClueCellRegistry::tower-changed:
+         *
+         * Emitted when the current cell tower changed, appeared or went away.
+         **/
+        signals[TOWER_CHANGED] =
+                g_signal_new ("tower-changed",
+                              GCLUE_TYPE_CELL_REGISTRY,
+                              G_SIGNAL_RUN_LAST,
+                              0,
+                              NULL,
+                              NULL,
+                              g_cclosure_marshal_VOID__VOID,
+                              G_TYPE_NONE,
+                              0,
+                              G_TYPE_NONE);
+}
+
+static void
+gclue_cell_registry_init (GClueCellRegistry *registry)
+{
+        registry->priv = G_TYPE_INSTANCE_GET_PRIVATE (registry,
+                                                      GCLUE_TYPE_CELL_REGISTRY,
+                                                      GClueCellRegistryPrivate);
+}
+
+static void
+on_registry_destroyed (gpointer data,
+                       GObject *where_the_object_was)
+{
+        GClueCellRegistry **registry = (GClueCellRegistry **) data;
+
+        *registry = NULL;
+}
+
+/**
+ * gclue_cell_registry_get_singleton:
+ *
+ * Get the #GClueCellRegistry singleton.
+ *
+ * Returns: (transfer full): a new ref to #GClueCellRegistry. Use
+ * g_object_unref() when done.
+ **/
+GClueCellRegistry *
+gclue_cell_registry_get_singleton (void)
+{
+        static GClueCellRegistry *registry = NULL;
+
+        if (registry == NULL) {
+                registry = g_object_new (GCLUE_TYPE_CELL_REGISTRY, NULL);
+                g_object_weak_ref (G_OBJECT (registry),
+                                   on_registry_destroyed,
+                                   &registry);
+        } else
+                g_object_ref (registry);
+
+        return registry;
+}
+
+/**
+ * gclue_cell_registry_get_tower:
+ * @registry: a #GClueCellRegistry
+ *
+ * Gets the cell tower the modem is currently camped on.
+ *
+ * Returns: (transfer none): The current tower, or %NULL if there is no active
+ * 3G source knowing about one.
+ **/
+const GClue3GTower *
+gclue_cell_registry_get_tower (GClueCellRegistry *registry)
+{
+        g_return_val_if_fail (GCLUE_IS_CELL_REGISTRY (registry), NULL);
+
+        if (!registry->priv->has_tower)
+                return NULL;
+
+        return &registry->priv->tower;
+}
+
+/**
+ * gclue_cell_registry_set_tower:
+ * @registry: a #GClueCellRegistry
+ * @tower: (nullable): The current tower, or %NULL if it is not known anymore
+ *
+ * Publishes the cell tower the modem is currently camped on.
+ **/
+void
+gclue_cell_registry_set_tower (GClueCellRegistry  *registry,
+                               const GClue3GTower *tower)
+{
+        GClueCellRegistryPrivate *priv;
+
+        g_return_if_fail (GCLUE_IS_CELL_REGISTRY (registry));
+        priv = registry->priv;
+
+        if (tower == NULL) {
+                if (!priv->has_tower)
+                        return;
+
+                priv->has_tower = FALSE;
+        } else {
+                if (priv->has_tower &&
+                    priv->tower.mcc == tower->mcc &&
+                    priv->tower.mnc == tower->mnc &&
+                    priv->tower.lac == tower->lac &&
+                    priv->tower.cell_id == tower->cell_id)
+                        return;
+
+                priv->tower = *tower;
+                priv->has_tower = TRUE;
+        }
+
+        g_signal_emit (registry, signals[TOWER_CHANGED], 0);
+}
+
+/**
+ * gclue_cell_registry_get_combining:
+ * @registry: a #GClueCellRegistry
+ *
+ * Returns: %TRUE if the current tower is sent along with the WiFi queries,
+ * and every locator using it gets their answer, so it doesn't need to be
+ * looked up on its own.
+ **/
+gboolean
+gclue_cell_registry_get_combining (GClueCellRegistry *registry)
+{
+        g_return_val_if_fail (GCLUE_IS_CELL_REGISTRY (registry), FALSE);
+
+        return registry->priv->combining;
+}
+
+static void
+update_combining (GClueCellRegistry *registry)
+{
+        GClueCellRegistryPrivate *priv = registry->priv;
+        gboolean combining;
+
+        combining = priv->wifi_combining && priv->n_standalone_users == 0;
+        if (priv->combining == combining)
+                return;
+
+        priv->combining = combining;
+        g_debug ("%s cell tower with WiFi queries",
+                 combining ? "Combining" : "No longer combining");
+        g_object_notify_by_pspec (G_OBJECT (registry),
+                                  gParamSpecs[PROP_COMBINING]);
+}
+
+/**
+ * gclue_cell_registry_set_combining:
+ * @registry: a #GClueCellRegistry
+ * @combining: Whether the current tower is sent along with the WiFi queries
+ *
+ * To be called by the WiFi source when it starts or stops sending the current
+ * tower along in its queries.
+ **/
+void
+gclue_cell_registry_set_combining (GClueCellRegistry *registry,
+                                   gboolean           combining)
+{
+        g_return_if_fail (GCLUE_IS_CELL_REGISTRY (registry));
+
+        registry->priv->wifi_combining = combining;
+        update_combining (registry);
+}
+
+/**
+ * gclue_cell_registry_add_standalone_user:
+ * @registry: a #GClueCellRegistry
+ *
+ * To be called by a locator when it starts running the 3G source without the
+ * street-level WiFi source, so it needs the tower looked up on its own.
+ **/
+void
+gclue_cell_registry_add_standalone_user (GClueCellRegistry *registry)
+{
+        g_return_if_fail (GCLUE_IS_CELL_REGISTRY (registry));
+
+        registry->priv->n_standalone_users++;
+        update_combining (registry);
+}
+
+/**
+ * gclue_cell_registry_remove_standalone_user:
+ * @registry: a #GClueCellRegistry
+ *
+ * Undoes gclue_cell_registry_add_standalone_user().
+ **/
+void
+gclue_cell_registry_remove_standalone_user (GClueCellRegistry *registry)
+{
+        g_return_if_fail (GCLUE_IS_CELL_REGISTRY (registry));
+        g_return_if_fail (registry->priv->n_standalone_users > 0);
+
+        registry->priv->n_standalone_users--;
+        update_combining (registry);
+}
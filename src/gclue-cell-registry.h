@@ -0,0 +1,73 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-cell-registry.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_CELL_REGISTRY_H
+#define GCLUE_CELL_REGISTRY_H
+
+#include <glib-object.h>
+#include "gclue-3g-tower.h"
+
+G_BEGIN_DECLS
+
+#define GCLUE_TYPE_CELL_REGISTRY            (gclue_cell_registry_get_type())
+#define GCLUE_CELL_REGISTRY(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_CELL_REGISTRY, GClueCellRegistry))
+#define GCLUE_CELL_REGISTRY_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_CELL_REGISTRY, GClueCellRegistry const))
+#define GCLUE_CELL_REGISTRY_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GCLUE_TYPE_CELL_REGISTRY, GClueCellRegistryClass))
+#define GCLUE_IS_CELL_REGISTRY(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_CELL_REGISTRY))
+#define GCLUE_IS_CELL_REGISTRY_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_CELL_REGISTRY))
+#define GCLUE_CELL_REGISTRY_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_CELL_REGISTRY, GClueCellRegistryClass))
+
+typedef struct _GClueCellRegistry        GClueCellRegistry;
+typedef struct _GClueCellRegistryClass   GClueCellRegistryClass;
+typedef struct _GClueCellRegistryPrivate GClueCellRegistryPrivate;
+
+struct _GClueCellRegistry
+{
+        GObject parent;
+
+        /*< private >*/
+        GClueCellRegistryPrivate *priv;
+};
+
+struct _GClueCellRegistryClass
+{
+        GObjectClass parent_class;
+};
+
+GType               gclue_cell_registry_get_type      (void) G_GNUC_CONST;
+
+GClueCellRegistry * gclue_cell_registry_get_singleton (void);
+const GClue3GTower *
+                    gclue_cell_registry_get_tower     (GClueCellRegistry  *registry);
+void                gclue_cell_registry_set_tower     (GClueCellRegistry  *registry,
+                                                       const GClue3GTower *tower);
+gboolean            gclue_cell_registry_get_combining (GClueCellRegistry  *registry);
+void                gclue_cell_registry_set_combining (GClueCellRegistry  *registry,
+                                                       gboolean            combining);
+void                gclue_cell_registry_add_standalone_user
+                                                      (GClueCellRegistry  *registry);
+void                gclue_cell_registry_remove_standalone_user
+                                                      (GClueCellRegistry  *registry);
+
+G_END_DECLS
+
+#endif /* GCLUE_CELL_REGISTRY_H */
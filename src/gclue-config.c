@@ -38,6 +38,7 @@ struct _GClueConfigPrivate
 
         char *wifi_url;
         gboolean wifi_submit;
+        gboolean wifi_submit_persist;
         gboolean enable_nmea_source;
         gboolean enable_3g_source;
         gboolean enable_cdma_source;
@@ -45,6 +46,23 @@ struct _GClueConfigPrivate
         gboolean enable_wifi_source;
         char *wifi_submit_url;
         char *wifi_submit_nick;
+        guint wifi_cache_size;
+        gdouble wifi_cache_threshold;
+        gboolean wifi_cache_persist;
+        guint wifi_ap_store_size;
+        gboolean wifi_ap_store_persist;
+        gint wifi_weak_signal;
+        guint wifi_max_bss_age;
+        guint wifi_max_query_aps;
+        char *wifi_replay_file;
+        gdouble wifi_replay_speed;
+        GClueWifiChangeMetric wifi_change_metric;
+        gdouble wifi_change_threshold;
+        guint web_cache_size;
+        guint web_cache_ttl;
+        gboolean web_cache_persist;
+        GArray *web_backends; /* GClueWebBackend */
+        guint web_accept_accuracy;
 
         GList *app_configs;
 };
@@ -83,6 +101,8 @@ gclue_config_finalize (GObject *object)
         g_clear_pointer (&priv->wifi_url, g_free);
         g_clear_pointer (&priv->wifi_submit_url, g_free);
         g_clear_pointer (&priv->wifi_submit_nick, g_free);
+        g_clear_pointer (&priv->wifi_replay_file, g_free);
+        g_clear_pointer (&priv->web_backends, g_array_unref);
 
         g_list_foreach (priv->app_configs, (GFunc) app_config_free, NULL);
 
@@ -119,7 +139,7 @@ load_agent_config (GClueConfig *config)
 static void
 load_app_configs (GClueConfig *config)
 {
-        const char *known_groups[] = { "agent", "wifi", "3g", "cdma",
+        const char *known_groups[] = { "agent", "web", "wifi", "3g", "cdma",
                                        "modem-gps", "network-nmea",
                                        NULL };
         GClueConfigPrivate *priv = config->priv;
@@ -145,7 +165,7 @@ load_app_configs (GClueConfig *config)
                                 continue;
                         }
 
-                if (ignore)
+                if (ignore || g_str_has_prefix (groups[i], "backend:"))
                         continue;
 
                 allowed = g_key_file_get_boolean (priv->key_file,
@@ -216,9 +236,218 @@ load_enable_source_config (GClueConfig *config,
         return enable;
 }
 
+static gint
+load_int_config (GClueConfig *config,
+                 const char  *group,
+                 const char  *key,
+                 gint         default_value)
+{
+        GError *error = NULL;
+        gint value;
+
+        value = g_key_file_get_integer (config->priv->key_file,
+                                        group,
+                                        key,
+                                        &error);
+        if (error != NULL) {
+                g_debug ("Failed to get config \"%s/%s\": %s",
+                         group,
+                         key,
+                         error->message);
+                g_error_free (error);
+
+                return default_value;
+        }
+
+        return value;
+}
+
+static gdouble
+load_double_config (GClueConfig *config,
+                    const char  *group,
+                    const char  *key,
+                    gdouble      default_value)
+{
+        GError *error = NULL;
+        gdouble value;
+
+        value = g_key_file_get_double (config->priv->key_file,
+                                       group,
+                                       key,
+                                       &error);
+        if (error != NULL) {
+                g_debug ("Failed to get config \"%s/%s\": %s",
+                         group,
+                         key,
+                         error->message);
+                g_error_free (error);
+
+                return default_value;
+        }
+
+        return value;
+}
+
+#define DEFAULT_WEB_CACHE_SIZE 32
+#define DEFAULT_WEB_CACHE_TTL 60
+#define DEFAULT_WEB_ACCEPT_ACCURACY 100
+#define DEFAULT_WEB_BACKEND_DEADLINE 10
+
+static void
+load_web_config (GClueConfig *config)
+{
+        GClueConfigPrivate *priv = config->priv;
+        GError *error = NULL;
+
+        priv->web_cache_size = MAX (load_int_config (config,
+                                                     "web",
+                                                     "response-cache-size",
+                                                     DEFAULT_WEB_CACHE_SIZE),
+                                    0);
+        priv->web_cache_ttl = MAX (load_int_config (config,
+                                                    "web",
+                                                    "response-cache-ttl",
+                                                    DEFAULT_WEB_CACHE_TTL),
+                                   0);
+        priv->web_cache_persist = g_key_file_get_boolean (priv->key_file,
+                                                          "web",
+                                                          "response-cache-persist",
+                                                          &error);
+        if (error != NULL) {
+                g_debug ("Failed to get config "
+                         "\"web/response-cache-persist\": %s",
+                         error->message);
+                g_error_free (error);
+        }
+
+        priv->web_accept_accuracy =
+                MAX (load_int_config (config,
+                                      "web",
+                                      "accept-accuracy",
+                                      DEFAULT_WEB_ACCEPT_ACCURACY),
+                     0);
+}
+
+static void
+web_backend_clear (GClueWebBackend *backend)
+{
+        g_free (backend->name);
+        g_free (backend->url);
+}
+
+static void
+load_web_backends_config (GClueConfig *config)
+{
+        GClueConfigPrivate *priv = config->priv;
+        GClueWebBackend backend;
+        char **names;
+        gsize num_names = 0, i;
+
+        names = g_key_file_get_string_list (priv->key_file,
+                                            "web",
+                                            "backends",
+                                            &num_names,
+                                            NULL);
+        for (i = 0; i < num_names; i++) {
+                char *group, *dialect;
+                GError *error = NULL;
+
+                group = g_strconcat ("backend:", names[i], NULL);
+                backend.name = g_strdup (names[i]);
+                backend.url = g_key_file_get_string (priv->key_file,
+                                                     group,
+                                                     "url",
+                                                     &error);
+                if (error != NULL) {
+                        g_warning ("Ignoring web backend '%s': %s",
+                                   names[i],
+                                   error->message);
+                        g_error_free (error);
+                        g_free (group);
+                        web_backend_clear (&backend);
+
+                        continue;
+                }
+
+                dialect = g_key_file_get_string (priv->key_file,
+                                                 group,
+                                                 "dialect",
+                                                 NULL);
+                if (dialect == NULL || strcmp (dialect, "mozilla") == 0) {
+                        backend.dialect = GCLUE_WEB_DIALECT_MOZILLA;
+                } else {
+                        g_warning ("Ignoring web backend '%s' with unknown "
+                                   "dialect '%s'",
+                                   names[i],
+                                   dialect);
+                        g_free (dialect);
+                        g_free (group);
+                        web_backend_clear (&backend);
+
+                        continue;
+                }
+                g_free (dialect);
+
+                backend.deadline =
+                        MAX (load_int_config (config,
+                                              group,
+                                              "deadline",
+                                              DEFAULT_WEB_BACKEND_DEADLINE),
+                             1);
+                g_array_append_val (priv->web_backends, backend);
+                g_free (group);
+        }
+        g_strfreev (names);
+}
+
 #define DEFAULT_WIFI_URL "https://location.services.mozilla.com/v1/geolocate?key=" MOZILLA_API_KEY
 #define DEFAULT_WIFI_SUBMIT_URL "https://location.services.mozilla.com/v1/submit?key=" MOZILLA_API_KEY
 #define DEFAULT_WIFI_SUBMIT_NICK "geoclue"
+#define DEFAULT_WIFI_CACHE_SIZE 256
+#define DEFAULT_WIFI_CACHE_THRESHOLD 0.75
+#define DEFAULT_WIFI_AP_STORE_SIZE 4096
+#define DEFAULT_WIFI_WEAK_SIGNAL -90
+#define DEFAULT_WIFI_MAX_BSS_AGE 0
+#define DEFAULT_WIFI_MAX_QUERY_APS 25
+#define DEFAULT_WIFI_REPLAY_SPEED 1.0
+#define DEFAULT_WIFI_CHANGE_METRIC GCLUE_WIFI_CHANGE_METRIC_WEIGHTED_JACCARD
+#define DEFAULT_WIFI_CHANGE_THRESHOLD 0.8
+
+static void
+load_wifi_change_config (GClueConfig *config)
+{
+        GClueConfigPrivate *priv = config->priv;
+        GError *error = NULL;
+        char *metric;
+
+        metric = g_key_file_get_string (priv->key_file,
+                                        "wifi",
+                                        "change-metric",
+                                        &error);
+        if (error != NULL) {
+                g_debug ("Failed to get config \"wifi/change-metric\": %s",
+                         error->message);
+                g_error_free (error);
+        } else if (g_strcmp0 (metric, "any") == 0) {
+                priv->wifi_change_metric = GCLUE_WIFI_CHANGE_METRIC_ANY;
+        } else if (g_strcmp0 (metric, "jaccard") == 0) {
+                priv->wifi_change_metric = GCLUE_WIFI_CHANGE_METRIC_JACCARD;
+        } else if (g_strcmp0 (metric, "weighted-jaccard") == 0) {
+                priv->wifi_change_metric =
+                        GCLUE_WIFI_CHANGE_METRIC_WEIGHTED_JACCARD;
+        } else {
+                g_warning ("Unknown WiFi change metric '%s', using default",
+                           metric);
+        }
+        g_free (metric);
+
+        priv->wifi_change_threshold =
+                CLAMP (load_double_config (config,
+                                           "wifi",
+                                           "change-threshold",
+                                           DEFAULT_WIFI_CHANGE_THRESHOLD),
+                       0.0, 1.0);
+}
 
 static void
 load_wifi_config (GClueConfig *config)
@@ -239,6 +468,88 @@ load_wifi_config (GClueConfig *config)
                 priv->wifi_url = g_strdup (DEFAULT_WIFI_URL);
         }
 
+        priv->wifi_cache_size = MAX (load_int_config (config,
+                                                      "wifi",
+                                                      "cache-size",
+                                                      DEFAULT_WIFI_CACHE_SIZE),
+                                     0);
+        priv->wifi_cache_threshold =
+                CLAMP (load_double_config (config,
+                                           "wifi",
+                                           "cache-threshold",
+                                           DEFAULT_WIFI_CACHE_THRESHOLD),
+                       0.0, 1.0);
+        priv->wifi_cache_persist = g_key_file_get_boolean (priv->key_file,
+                                                           "wifi",
+                                                           "cache-persist",
+                                                           &error);
+        if (error != NULL) {
+                g_debug ("Failed to get config \"wifi/cache-persist\": %s",
+                         error->message);
+                g_clear_error (&error);
+        }
+        priv->wifi_ap_store_size =
+                MAX (load_int_config (config,
+                                      "wifi",
+                                      "ap-store-size",
+                                      DEFAULT_WIFI_AP_STORE_SIZE),
+                     0);
+        priv->wifi_ap_store_persist =
+                g_key_file_get_boolean (priv->key_file,
+                                        "wifi",
+                                        "ap-store-persist",
+                                        &error);
+        if (error != NULL) {
+                g_debug ("Failed to get config \"wifi/ap-store-persist\": %s",
+                         error->message);
+                g_clear_error (&error);
+        }
+        priv->wifi_weak_signal = load_int_config (config,
+                                                  "wifi",
+                                                  "weak-signal",
+                                                  DEFAULT_WIFI_WEAK_SIGNAL);
+        priv->wifi_max_bss_age = MAX (load_int_config (config,
+                                                       "wifi",
+                                                       "max-bss-age",
+                                                       DEFAULT_WIFI_MAX_BSS_AGE),
+                                      0);
+        priv->wifi_max_query_aps =
+                MAX (load_int_config (config,
+                                      "wifi",
+                                      "max-query-aps",
+                                      DEFAULT_WIFI_MAX_QUERY_APS),
+                     0);
+        load_wifi_change_config (config);
+
+        /* Only for testing, so it's fine to not have it */
+        priv->wifi_replay_file = g_key_file_get_string (priv->key_file,
+                                                        "wifi",
+                                                        "replay-file",
+                                                        NULL);
+        if (g_strcmp0 (priv->wifi_replay_file, "") == 0)
+                g_clear_pointer (&priv->wifi_replay_file, g_free);
+        priv->wifi_replay_speed = load_double_config (config,
+                                                      "wifi",
+                                                      "replay-speed",
+                                                      DEFAULT_WIFI_REPLAY_SPEED);
+        if (priv->wifi_replay_speed <= 0.0) {
+                g_warning ("Invalid WiFi replay speed %f, using default",
+                           priv->wifi_replay_speed);
+                priv->wifi_replay_speed = DEFAULT_WIFI_REPLAY_SPEED;
+        }
+
+        priv->wifi_submit_persist =
+                g_key_file_get_boolean (priv->key_file,
+                                        "wifi",
+                                        "submission-persist",
+                                        &error);
+        if (error != NULL) {
+                g_debug ("Failed to get config "
+                         "\"wifi/submission-persist\": %s",
+                         error->message);
+                g_clear_error (&error);
+        }
+
         priv->wifi_submit = g_key_file_get_boolean (priv->key_file,
                                                     "wifi",
                                                     "submit-data",
@@ -306,19 +617,40 @@ static void
 gclue_config_init (GClueConfig *config)
 {
         GError *error = NULL;
+        const char *path;
 
         config->priv =
                 G_TYPE_INSTANCE_GET_PRIVATE (config,
                                             GCLUE_TYPE_CONFIG,
                                             GClueConfigPrivate);
         config->priv->key_file = g_key_file_new ();
-        g_key_file_load_from_file (config->priv->key_file,
-                                   CONFIG_FILE_PATH,
-                                   0,
-                                   &error);
+        config->priv->wifi_cache_size = DEFAULT_WIFI_CACHE_SIZE;
+        config->priv->wifi_cache_threshold = DEFAULT_WIFI_CACHE_THRESHOLD;
+        config->priv->wifi_ap_store_size = DEFAULT_WIFI_AP_STORE_SIZE;
+        config->priv->wifi_weak_signal = DEFAULT_WIFI_WEAK_SIGNAL;
+        config->priv->wifi_max_bss_age = DEFAULT_WIFI_MAX_BSS_AGE;
+        config->priv->wifi_max_query_aps = DEFAULT_WIFI_MAX_QUERY_APS;
+        config->priv->wifi_replay_speed = DEFAULT_WIFI_REPLAY_SPEED;
+        config->priv->wifi_change_metric = DEFAULT_WIFI_CHANGE_METRIC;
+        config->priv->wifi_change_threshold = DEFAULT_WIFI_CHANGE_THRESHOLD;
+        config->priv->web_cache_size = DEFAULT_WEB_CACHE_SIZE;
+        config->priv->web_cache_ttl = DEFAULT_WEB_CACHE_TTL;
+        config->priv->web_accept_accuracy = DEFAULT_WEB_ACCEPT_ACCURACY;
+        config->priv->web_backends = g_array_new (FALSE,
+                                                  FALSE,
+                                                  sizeof (GClueWebBackend));
+        g_array_set_clear_func (config->priv->web_backends,
+                                (GDestroyNotify) web_backend_clear);
+
+        /* Lets the tests and benchmarks run with a configuration of their own */
+        path = g_getenv ("GEOCLUE_CONFIG");
+        if (path == NULL)
+                path = CONFIG_FILE_PATH;
+
+        g_key_file_load_from_file (config->priv->key_file, path, 0, &error);
         if (error != NULL) {
                 g_critical ("Failed to load configuration file '%s': %s",
-                            CONFIG_FILE_PATH, error->message);
+                            path, error->message);
                 g_error_free (error);
 
                 return;
@@ -326,7 +658,9 @@ gclue_config_init (GClueConfig *config)
 
         load_agent_config (config);
         load_app_configs (config);
+        load_web_config (config);
         load_wifi_config (config);
+        load_web_backends_config (config);
         load_3g_config (config);
         load_cdma_config (config);
         load_modem_gps_config (config);
@@ -458,6 +792,118 @@ gclue_config_set_wifi_submit_nick (GClueConfig *config,
         config->priv->wifi_submit_nick = g_strdup (nick);
 }
 
+gboolean
+gclue_config_get_wifi_submit_persist (GClueConfig *config)
+{
+        return config->priv->wifi_submit_persist;
+}
+
+guint
+gclue_config_get_wifi_cache_size (GClueConfig *config)
+{
+        return config->priv->wifi_cache_size;
+}
+
+gdouble
+gclue_config_get_wifi_cache_threshold (GClueConfig *config)
+{
+        return config->priv->wifi_cache_threshold;
+}
+
+gboolean
+gclue_config_get_wifi_cache_persist (GClueConfig *config)
+{
+        return config->priv->wifi_cache_persist;
+}
+
+guint
+gclue_config_get_wifi_ap_store_size (GClueConfig *config)
+{
+        return config->priv->wifi_ap_store_size;
+}
+
+gboolean
+gclue_config_get_wifi_ap_store_persist (GClueConfig *config)
+{
+        return config->priv->wifi_ap_store_persist;
+}
+
+gint
+gclue_config_get_wifi_weak_signal (GClueConfig *config)
+{
+        return config->priv->wifi_weak_signal;
+}
+
+guint
+gclue_config_get_wifi_max_bss_age (GClueConfig *config)
+{
+        return config->priv->wifi_max_bss_age;
+}
+
+guint
+gclue_config_get_wifi_max_query_aps (GClueConfig *config)
+{
+        return config->priv->wifi_max_query_aps;
+}
+
+const char *
+gclue_config_get_wifi_replay_file (GClueConfig *config)
+{
+        return config->priv->wifi_replay_file;
+}
+
+gdouble
+gclue_config_get_wifi_replay_speed (GClueConfig *config)
+{
+        return config->priv->wifi_replay_speed;
+}
+
+GClueWifiChangeMetric
+gclue_config_get_wifi_change_metric (GClueConfig *config)
+{
+        return config->priv->wifi_change_metric;
+}
+
+gdouble
+gclue_config_get_wifi_change_threshold (GClueConfig *config)
+{
+        return config->priv->wifi_change_threshold;
+}
+
+guint
+gclue_config_get_web_cache_size (GClueConfig *config)
+{
+        return config->priv->web_cache_size;
+}
+
+guint
+gclue_config_get_web_cache_ttl (GClueConfig *config)
+{
+        return config->priv->web_cache_ttl;
+}
+
+gboolean
+gclue_config_get_web_cache_persist (GClueConfig *config)
+{
+        return config->priv->web_cache_persist;
+}
+
+/* In order of preference, for when their answers are equally accurate */
+const GClueWebBackend *
+gclue_config_get_web_backends (GClueConfig *config,
+                               guint       *num_backends)
+{
+        *num_backends = config->priv->web_backends->len;
+
+        return (const GClueWebBackend *) config->priv->web_backends->data;
+}
+
+guint
+gclue_config_get_web_accept_accuracy (GClueConfig *config)
+{
+        return config->priv->web_accept_accuracy;
+}
+
 gboolean
 gclue_config_get_wifi_submit_data (GClueConfig *config)
 {
@@ -44,6 +44,23 @@ typedef enum {
         GCLUE_APP_PERM_ASK_AGENT
 } GClueAppPerm;
 
+typedef enum {
+        GCLUE_WIFI_CHANGE_METRIC_ANY,
+        GCLUE_WIFI_CHANGE_METRIC_JACCARD,
+        GCLUE_WIFI_CHANGE_METRIC_WEIGHTED_JACCARD
+} GClueWifiChangeMetric;
+
+typedef enum {
+        GCLUE_WEB_DIALECT_MOZILLA
+} GClueWebDialect;
+
+typedef struct {
+        char *name;
+        char *url;
+        GClueWebDialect dialect;
+        guint deadline; /* seconds */
+} GClueWebBackend;
+
 typedef struct _GClueConfig        GClueConfig;
 typedef struct _GClueConfigClass   GClueConfigClass;
 typedef struct _GClueConfigPrivate GClueConfigPrivate;
@@ -73,12 +90,38 @@ GClueAppPerm        gclue_config_get_app_perm           (GClueConfig     *config
                                                          GClueClientInfo *app_info);
 gboolean            gclue_config_is_system_component    (GClueConfig     *config,
                                                          const char      *desktop_id);
+guint               gclue_config_get_web_cache_size     (GClueConfig     *config);
+guint               gclue_config_get_web_cache_ttl      (GClueConfig     *config);
+gboolean            gclue_config_get_web_cache_persist  (GClueConfig     *config);
+const GClueWebBackend *
+                    gclue_config_get_web_backends       (GClueConfig     *config,
+                                                         guint           *num_backends);
+guint               gclue_config_get_web_accept_accuracy
+                                                        (GClueConfig     *config);
 const char *        gclue_config_get_wifi_url           (GClueConfig     *config);
 const char *        gclue_config_get_wifi_submit_url    (GClueConfig     *config);
 const char *        gclue_config_get_wifi_submit_nick   (GClueConfig     *config);
 void                gclue_config_set_wifi_submit_nick   (GClueConfig     *config,
                                                          const char      *nick);
 gboolean            gclue_config_get_wifi_submit_data   (GClueConfig     *config);
+gboolean            gclue_config_get_wifi_submit_persist
+                                                        (GClueConfig     *config);
+guint               gclue_config_get_wifi_cache_size    (GClueConfig     *config);
+gdouble             gclue_config_get_wifi_cache_threshold
+                                                        (GClueConfig     *config);
+gboolean            gclue_config_get_wifi_cache_persist (GClueConfig     *config);
+guint               gclue_config_get_wifi_ap_store_size (GClueConfig     *config);
+gboolean            gclue_config_get_wifi_ap_store_persist
+                                                        (GClueConfig     *config);
+gint                gclue_config_get_wifi_weak_signal   (GClueConfig     *config);
+guint               gclue_config_get_wifi_max_bss_age   (GClueConfig     *config);
+guint               gclue_config_get_wifi_max_query_aps (GClueConfig     *config);
+const char *        gclue_config_get_wifi_replay_file   (GClueConfig     *config);
+gdouble             gclue_config_get_wifi_replay_speed  (GClueConfig     *config);
+GClueWifiChangeMetric
+                    gclue_config_get_wifi_change_metric (GClueConfig     *config);
+gdouble             gclue_config_get_wifi_change_threshold
+                                                        (GClueConfig     *config);
 gboolean            gclue_config_get_enable_wifi_source (GClueConfig     *config);
 gboolean            gclue_config_get_enable_3g_source   (GClueConfig     *config);
 gboolean            gclue_config_get_enable_cdma_source (GClueConfig     *config);
@@ -0,0 +1,186 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-json-writer.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <string.h>
+#include "gclue-json-writer.h"
+
+/**
+ * SECTION:gclue-json-writer
+ * @short_description: Writes JSON straight into a #GString
+ *
+ * Our payloads have a small fixed schema, so they're written straight into a
+ * buffer rather than built as a tree first. The caller is responsible for the
+ * structure: each gclue_json_begin() needs its gclue_json_end(), and each
+ * member of an object a gclue_json_append_name() before its value. Commas go
+ * in as needed.
+ **/
+
+static void
+append_separator (GString *json)
+{
+        if (json->len > 0 && strchr ("{[:", json->str[json->len - 1]) == NULL)
+                g_string_append_c (json, ',');
+}
+
+static void
+append_quoted (GString    *json,
+               const char *str)
+{
+        const char *p, *run;
+
+        g_string_append_c (json, '"');
+
+        for (p = run = str; *p != '\0'; p++) {
+                guchar c = *p;
+
+                if (c >= 0x20 && c != '"' && c != '\\')
+                        continue;
+
+                g_string_append_len (json, run, p - run);
+                run = p + 1;
+
+                switch (c) {
+                case '"':
+                        g_string_append (json, "\\\"");
+                        break;
+                case '\\':
+                        g_string_append (json, "\\\\");
+                        break;
+                case '\b':
+                        g_string_append (json, "\\b");
+                        break;
+                case '\f':
+                        g_string_append (json, "\\f");
+                        break;
+                case '\n':
+                        g_string_append (json, "\\n");
+                        break;
+                case '\r':
+                        g_string_append (json, "\\r");
+                        break;
+                case '\t':
+                        g_string_append (json, "\\t");
+                        break;
+                default:
+                        g_string_append_printf (json, "\\u%04x", c);
+                }
+        }
+        g_string_append_len (json, run, p - run);
+
+        g_string_append_c (json, '"');
+}
+
+/**
+ * gclue_json_begin:
+ * @json: The JSON written so far
+ * @bracket: '{' for an object, '[' for an array
+ *
+ * Starts an object or array.
+ **/
+void
+gclue_json_begin (GString *json,
+                  char     bracket)
+{
+        append_separator (json);
+        g_string_append_c (json, bracket);
+}
+
+/**
+ * gclue_json_end:
+ * @json: The JSON written so far
+ * @bracket: '}' for an object, ']' for an array
+ *
+ * Ends the object or array started last.
+ **/
+void
+gclue_json_end (GString *json,
+                char     bracket)
+{
+        g_string_append_c (json, bracket);
+}
+
+/**
+ * gclue_json_append_name:
+ * @json: The JSON written so far
+ * @name: Name of the member, in UTF-8
+ *
+ * Starts a member of the current object. Its value is to be appended next.
+ **/
+void
+gclue_json_append_name (GString    *json,
+                        const char *name)
+{
+        append_separator (json);
+        append_quoted (json, name);
+        g_string_append_c (json, ':');
+}
+
+/**
+ * gclue_json_append_string:
+ * @json: The JSON written so far
+ * @value: A string, in UTF-8
+ *
+ * Appends @value as a string, escaping the characters JSON requires to be.
+ **/
+void
+gclue_json_append_string (GString    *json,
+                          const char *value)
+{
+        append_separator (json);
+        append_quoted (json, value);
+}
+
+/**
+ * gclue_json_append_int:
+ * @json: The JSON written so far
+ * @value: An integer
+ *
+ * Appends @value as a number.
+ **/
+void
+gclue_json_append_int (GString *json,
+                       gint64   value)
+{
+        char buf[24];
+
+        append_separator (json);
+        g_snprintf (buf, sizeof (buf), "%" G_GINT64_FORMAT, value);
+        g_string_append (json, buf);
+}
+
+/**
+ * gclue_json_append_double:
+ * @json: The JSON written so far
+ * @value: A finite number
+ *
+ * Appends @value as a number, with as many digits as it takes to read it
+ * back exactly, and a '.' as the decimal point whatever the locale.
+ **/
+void
+gclue_json_append_double (GString *json,
+                          gdouble  value)
+{
+        char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+        append_separator (json);
+        g_string_append (json, g_ascii_dtostr (buf, sizeof (buf), value));
+}
@@ -0,0 +1,51 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-json-writer.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_JSON_WRITER_H
+#define GCLUE_JSON_WRITER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void
+gclue_json_begin (GString *json,
+                  char     bracket);
+void
+gclue_json_end (GString *json,
+                char     bracket);
+void
+gclue_json_append_name (GString    *json,
+                        const char *name);
+void
+gclue_json_append_string (GString    *json,
+                          const char *value);
+void
+gclue_json_append_int (GString *json,
+                       gint64   value);
+void
+gclue_json_append_double (GString *json,
+                          gdouble  value);
+
+G_END_DECLS
+
+#endif /* GCLUE_JSON_WRITER_H */
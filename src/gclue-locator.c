@@ -28,6 +28,7 @@
 
 #include "gclue-wifi.h"
 #include "gclue-config.h"
+#include "gclue-cell-registry.h"
 
 #if GCLUE_USE_3G_SOURCE
 #include "gclue-3g.h"
@@ -62,6 +63,9 @@ struct _GClueLocatorPrivate
         GClueAccuracyLevel accuracy_level;
 
         guint time_threshold;
+
+        GClueCellRegistry *cell_registry; /* If the 3G source is enabled */
+        gboolean standalone_3g;
 };
 
 G_DEFINE_TYPE_WITH_CODE (GClueLocator,
@@ -83,6 +87,8 @@ set_location (GClueLocator  *locator,
               GClueLocation *location)
 {
         GClueLocation *cur_location;
+        gdouble speed;
+        GList *node;
 
         cur_location = gclue_location_source_get_location
                         (GCLUE_LOCATION_SOURCE (locator));
@@ -112,6 +118,21 @@ set_location (GClueLocator  *locator,
 
         gclue_location_source_set_location (GCLUE_LOCATION_SOURCE (locator),
                                             location);
+
+        /* Let WiFi sources adapt their scanning to how fast we move */
+        speed = gclue_location_get_speed
+                (gclue_location_source_get_location
+                        (GCLUE_LOCATION_SOURCE (locator)));
+        if (speed == GCLUE_LOCATION_SPEED_UNKNOWN)
+                return;
+
+        for (node = locator->priv->active_sources;
+             node != NULL;
+             node = node->next) {
+                if (GCLUE_IS_WIFI (node->data))
+                        gclue_wifi_report_speed (GCLUE_WIFI (node->data),
+                                                 speed);
+        }
 }
 
 static gint
@@ -172,6 +193,43 @@ is_source_active (GClueLocator        *locator,
         return (g_list_find (locator->priv->active_sources, src) != NULL);
 }
 
+/* The 3G source leaves looking up the tower to the street-level WiFi source
+ * while that sends it along, but only the locators running both get the answer.
+ */
+static void
+refresh_standalone_3g (GClueLocator *locator)
+{
+#if GCLUE_USE_3G_SOURCE
+        GClueLocatorPrivate *priv = locator->priv;
+        gboolean has_3g = FALSE, has_street_wifi = FALSE, standalone;
+        GList *node;
+
+        if (priv->cell_registry == NULL)
+                return;
+
+        for (node = priv->active_sources; node != NULL; node = node->next) {
+                if (GCLUE_IS_3G (node->data))
+                        has_3g = TRUE;
+                else if (GCLUE_IS_WIFI (node->data) &&
+                         gclue_wifi_get_accuracy_level
+                                (GCLUE_WIFI (node->data)) >
+                         GCLUE_ACCURACY_LEVEL_CITY)
+                        has_street_wifi = TRUE;
+        }
+
+        standalone = has_3g && !has_street_wifi;
+        if (standalone == priv->standalone_3g)
+                return;
+
+        priv->standalone_3g = standalone;
+        if (standalone)
+                gclue_cell_registry_add_standalone_user (priv->cell_registry);
+        else
+                gclue_cell_registry_remove_standalone_user
+                        (priv->cell_registry);
+#endif
+}
+
 static void
 start_source (GClueLocator        *locator,
               GClueLocationSource *src)
@@ -226,6 +284,7 @@ on_avail_accuracy_level_changed (GObject    *gobject,
                 priv->active_sources = g_list_remove (priv->active_sources,
                                                       src);
         }
+        refresh_standalone_3g (locator);
 }
 
 static void
@@ -325,6 +384,11 @@ gclue_locator_finalize (GObject *gsource)
         priv->sources = NULL;
         priv->active_sources = NULL;
 
+        if (priv->standalone_3g)
+                gclue_cell_registry_remove_standalone_user
+                        (priv->cell_registry);
+        g_clear_object (&priv->cell_registry);
+
         G_OBJECT_CLASS (gclue_locator_parent_class)->finalize (gsource);
 }
 
@@ -345,6 +409,8 @@ gclue_locator_constructed (GObject *object)
                 GClue3G *source = gclue_3g_get_singleton ();
                 locator->priv->sources = g_list_append (locator->priv->sources,
                                                         source);
+                locator->priv->cell_registry =
+                        gclue_cell_registry_get_singleton ();
         }
 #endif
 #if GCLUE_USE_CDMA_SOURCE
@@ -466,6 +532,7 @@ gclue_locator_start (GClueLocationSource *source)
 
                 start_source (locator, src);
         }
+        refresh_standalone_3g (locator);
 
         return TRUE;
 }
@@ -496,6 +563,7 @@ gclue_locator_stop (GClueLocationSource *source)
 
         g_list_free (locator->priv->active_sources);
         locator->priv->active_sources = NULL;
+        refresh_standalone_3g (locator);
         return TRUE;
 }
 
@@ -27,6 +27,7 @@
 #include "gclue-mozilla.h"
 #include "gclue-config.h"
 #include "gclue-error.h"
+#include "gclue-json-writer.h"
 
 /**
  * SECTION:gclue-mozilla
@@ -40,157 +41,97 @@
  * its easy to switch to Google's API.
  **/
 
-#define BSSID_LEN 7
-#define BSSID_STR_LEN 18
-#define MAX_SSID_LEN 32
-
-static guint
-variant_to_string (GVariant *variant, guint max_len, char *ret)
+static const char *
+get_url (void)
 {
-        guint i;
-        guint len;
-
-        len = g_variant_n_children (variant);
-        if (len == 0)
-                return 0;
-        g_return_val_if_fail(len < max_len, 0);
-        ret[len] = '\0';
+        GClueConfig *config;
 
-        for (i = 0; i < len; i++)
-                g_variant_get_child (variant,
-                                     i,
-                                     "y",
-                                     &ret[i]);
+        config = gclue_config_get_singleton ();
 
-        return len;
+        return gclue_config_get_wifi_url (config);
 }
 
-static guint
-get_ssid_from_bss (WPABSS *bss, char *ssid)
-{
-        GVariant *variant = wpa_bss_get_ssid (bss);
-        if (variant == NULL)
-                return 0;
-
-        return variant_to_string (variant, MAX_SSID_LEN, ssid);
-}
+/* Sized so the payloads usually don't need to grow */
+#define JSON_BASE_SIZE 256 /* bytes */
+#define JSON_BSS_SIZE  64  /* bytes */
 
-static gboolean
-get_bssid_from_bss (WPABSS *bss, char *bssid)
+static GString *
+json_new (const GClueWifiScan *scan)
 {
-        GVariant *variant;
-        char raw_bssid[BSSID_LEN] = { 0 };
-        guint raw_len, i;
-
-        variant = wpa_bss_get_bssid (bss);
-        if (variant == NULL)
-                return FALSE;
+        gsize size = JSON_BASE_SIZE;
 
-        raw_len = variant_to_string (variant, BSSID_LEN, raw_bssid);
-        g_return_val_if_fail (raw_len == BSSID_LEN - 1, FALSE);
+        if (scan != NULL)
+                size += scan->n_bss * JSON_BSS_SIZE;
 
-        for (i = 0; i < BSSID_LEN - 1; i++) {
-                unsigned char c = (unsigned char) raw_bssid[i];
-
-                if (i == BSSID_LEN - 2) {
-                        g_snprintf (bssid + (i * 3), 3, "%02x", c);
-                } else {
-                        g_snprintf (bssid + (i * 3), 4, "%02x:", c);
-                }
-        }
-
-        return TRUE;
-}
-
-static const char *
-get_url (void)
-{
-        GClueConfig *config;
-
-        config = gclue_config_get_singleton ();
-
-        return gclue_config_get_wifi_url (config);
+        return g_string_sized_new (size);
 }
 
 SoupMessage *
-gclue_mozilla_create_query (GList        *bss_list, /* As in Access Points */
-                            GClue3GTower *tower,
-                            GError      **error)
+gclue_mozilla_create_query (const GClueWifiScan *scan,
+                            const GClue3GTower  *tower,
+                            GError             **error)
 {
         SoupMessage *ret = NULL;
-        JsonBuilder *builder;
-        JsonGenerator *generator;
-        JsonNode *root_node;
-        char *data;
+        GString *json;
         gsize data_len;
+        char *data;
         const char *uri;
 
-        builder = json_builder_new ();
-        json_builder_begin_object (builder);
+        json = json_new (scan);
+        gclue_json_begin (json, '{');
 
-        /* We send pure geoip query using empty object if both bss_list and
+        /* We send pure geoip query using empty object if both scan and
          * tower are NULL.
          */
 
         if (tower != NULL) {
-                json_builder_set_member_name (builder, "radioType");
-                json_builder_add_string_value (builder, "gsm");
+                gclue_json_append_name (json, "radioType");
+                gclue_json_append_string (json, "gsm");
 
-                json_builder_set_member_name (builder, "cellTowers");
-                json_builder_begin_array (builder);
+                gclue_json_append_name (json, "cellTowers");
+                gclue_json_begin (json, '[');
 
-                json_builder_begin_object (builder);
+                gclue_json_begin (json, '{');
 
-                json_builder_set_member_name (builder, "cellId");
-                json_builder_add_int_value (builder, tower->cell_id);
-                json_builder_set_member_name (builder, "mobileCountryCode");
-                json_builder_add_int_value (builder, tower->mcc);
-                json_builder_set_member_name (builder, "mobileNetworkCode");
-                json_builder_add_int_value (builder, tower->mnc);
-                json_builder_set_member_name (builder, "locationAreaCode");
-                json_builder_add_int_value (builder, tower->lac);
+                gclue_json_append_name (json, "cellId");
+                gclue_json_append_int (json, tower->cell_id);
+                gclue_json_append_name (json, "mobileCountryCode");
+                gclue_json_append_int (json, tower->mcc);
+                gclue_json_append_name (json, "mobileNetworkCode");
+                gclue_json_append_int (json, tower->mnc);
+                gclue_json_append_name (json, "locationAreaCode");
+                gclue_json_append_int (json, tower->lac);
 
-                json_builder_end_object (builder);
+                gclue_json_end (json, '}');
 
-                json_builder_end_array (builder);
+                gclue_json_end (json, ']');
         }
 
-        if (bss_list != NULL) {
-                GList *iter;
+        if (scan != NULL && scan->n_bss > 0) {
+                guint i;
 
-                json_builder_set_member_name (builder, "wifiAccessPoints");
-                json_builder_begin_array (builder);
+                gclue_json_append_name (json, "wifiAccessPoints");
+                gclue_json_begin (json, '[');
 
-                for (iter = bss_list; iter != NULL; iter = iter->next) {
-                        WPABSS *bss = WPA_BSS (iter->data);
-                        char mac[BSSID_STR_LEN] = { 0 };
+                for (i = 0; i < scan->n_bss; i++) {
+                        const GClueWifiBSS *bss = &scan->bss[i];
                         gint16 strength_dbm;
 
-                        if (gclue_mozilla_should_ignore_bss (bss))
-                                continue;
-
-                        json_builder_begin_object (builder);
-                        json_builder_set_member_name (builder, "macAddress");
-                        get_bssid_from_bss (bss, mac);
-                        json_builder_add_string_value (builder, mac);
+                        gclue_json_begin (json, '{');
+                        gclue_json_append_name (json, "macAddress");
+                        gclue_json_append_string (json, bss->mac);
 
-                        json_builder_set_member_name (builder, "signalStrength");
-                        strength_dbm = wpa_bss_get_signal (bss);
-                        json_builder_add_int_value (builder, strength_dbm);
-                        json_builder_end_object (builder);
+                        gclue_json_append_name (json, "signalStrength");
+                        strength_dbm = bss->signal;
+                        gclue_json_append_int (json, strength_dbm);
+                        gclue_json_end (json, '}');
                 }
-                json_builder_end_array (builder);
+                gclue_json_end (json, ']');
         }
-        json_builder_end_object (builder);
+        gclue_json_end (json, '}');
 
-        generator = json_generator_new ();
-        root_node = json_builder_get_root (builder);
-        json_generator_set_root (generator, root_node);
-        data = json_generator_to_data (generator, &data_len);
-
-        json_node_free (root_node);
-        g_object_unref (builder);
-        g_object_unref (generator);
+        data_len = json->len;
+        data = g_string_free (json, FALSE);
 
         uri = get_url ();
         ret = soup_message_new ("POST", uri);
@@ -204,59 +145,416 @@ gclue_mozilla_create_query (GList        *bss_list, /* As in Access Points */
         return ret;
 }
 
+static gboolean
+location_is_valid (gdouble latitude,
+                   gdouble longitude,
+                   gdouble accuracy)
+{
+        return latitude >= -90.0 && latitude <= 90.0 &&
+               longitude >= -180.0 && longitude <= 180.0 &&
+               accuracy >= 0.0;
+}
+
+/* Unlike json_object_get_*_member(), these don't assume the reply has the
+ * members we expect, with the types we expect.
+ */
+static JsonObject *
+get_object_member (JsonObject *object,
+                   const char *name)
+{
+        JsonNode *node;
+
+        node = json_object_get_member (object, name);
+        if (node == NULL || !JSON_NODE_HOLDS_OBJECT (node))
+                return NULL;
+
+        return json_node_get_object (node);
+}
+
+static gboolean
+get_number_member (JsonObject *object,
+                   const char *name,
+                   gdouble    *value)
+{
+        JsonNode *node;
+
+        node = json_object_get_member (object, name);
+        if (node == NULL || !JSON_NODE_HOLDS_VALUE (node))
+                return FALSE;
+
+        switch (json_node_get_value_type (node)) {
+        case G_TYPE_DOUBLE:
+        case G_TYPE_INT64:
+                *value = json_node_get_double (node);
+
+                return TRUE;
+
+        default:
+                return FALSE;
+        }
+}
+
+static const char *
+get_string_member (JsonObject *object,
+                   const char *name)
+{
+        JsonNode *node;
+
+        node = json_object_get_member (object, name);
+        if (node == NULL ||
+            !JSON_NODE_HOLDS_VALUE (node) ||
+            json_node_get_value_type (node) != G_TYPE_STRING)
+                return NULL;
+
+        return json_node_get_string (node);
+}
+
 static gboolean
 parse_server_error (JsonObject *object, GError **error)
 {
         JsonObject *error_obj;
-        int code;
-        const char *message;
+        gdouble code = 0;
+        const char *message = NULL;
 
         if (!json_object_has_member (object, "error"))
             return FALSE;
 
-        error_obj = json_object_get_object_member (object, "error");
-        code = json_object_get_int_member (error_obj, "code");
-        message = json_object_get_string_member (error_obj, "message");
+        error_obj = get_object_member (object, "error");
+        if (error_obj != NULL) {
+                get_number_member (error_obj, "code", &code);
+                message = get_string_member (error_obj, "message");
+        }
 
-        g_set_error_literal (error, G_IO_ERROR, code, message);
+        g_set_error_literal (error,
+                             G_IO_ERROR,
+                             (gint) code,
+                             (message != NULL) ? message : "Unknown error");
 
         return TRUE;
 }
 
-GClueLocation *
-gclue_mozilla_parse_response (const char *json,
-                              GError    **error)
+/* A minimal pull parser for the geolocate responses, picking out the fields we
+ * need straight from the text instead of building a tree of it. Anything it
+ * doesn't expect, e.g an error response, is left to the full parser.
+ */
+#define MAX_SCAN_DEPTH 32
+
+typedef gboolean (*ScanMemberFunc) (const char **json,
+                                    const char  *name,
+                                    gsize        name_len,
+                                    gpointer     user_data);
+
+static gboolean
+scan_char (const char **json,
+           char         c)
+{
+        while (g_ascii_isspace (**json))
+                (*json)++;
+
+        if (**json != c)
+                return FALSE;
+        if (c != '\0')
+                (*json)++;
+
+        return TRUE;
+}
+
+/* Escapes are skipped but not decoded */
+static gboolean
+scan_string (const char **json,
+             const char **str,
+             gsize       *len)
+{
+        const char *p;
+
+        if (!scan_char (json, '"'))
+                return FALSE;
+
+        for (p = *json; *p != '"'; p++) {
+                if (*p == '\0')
+                        return FALSE;
+                if (*p == '\\' && *++p == '\0')
+                        return FALSE;
+        }
+
+        *str = *json;
+        *len = p - *json;
+        *json = p + 1;
+
+        return TRUE;
+}
+
+/* Only takes JSON numbers, where g_ascii_strtod() alone would also take hex
+ * numbers, "inf" or "nan".
+ */
+static gboolean
+scan_number (const char **json,
+             gdouble     *value)
+{
+        const char *p;
+        char *end;
+
+        while (g_ascii_isspace (**json))
+                (*json)++;
+
+        p = *json;
+        if (*p == '-')
+                p++;
+        if (!g_ascii_isdigit (*p))
+                return FALSE;
+        while (*p != '\0' &&
+               (g_ascii_isdigit (*p) || strchr (".eE+-", *p) != NULL))
+                p++;
+
+        *value = g_ascii_strtod (*json, &end);
+        if (end != p)
+                return FALSE;
+        *json = end;
+
+        return TRUE;
+}
+
+static gboolean
+scan_object (const char   **json,
+             ScanMemberFunc func,
+             gpointer       user_data)
+{
+        const char *name;
+        gsize name_len;
+
+        if (!scan_char (json, '{'))
+                return FALSE;
+        if (scan_char (json, '}'))
+                return TRUE;
+
+        do {
+                if (!scan_string (json, &name, &name_len) ||
+                    !scan_char (json, ':') ||
+                    !func (json, name, name_len, user_data))
+                        return FALSE;
+        } while (scan_char (json, ','));
+
+        return scan_char (json, '}');
+}
+
+static gboolean
+skip_value (const char **json,
+            guint        depth);
+
+static gboolean
+skip_member (const char **json,
+             const char  *name,
+             gsize        name_len,
+             gpointer     user_data)
+{
+        return skip_value (json, GPOINTER_TO_UINT (user_data));
+}
+
+static gboolean
+skip_value (const char **json,
+            guint        depth)
+{
+        const char *str;
+        gsize len;
+
+        if (depth > MAX_SCAN_DEPTH)
+                return FALSE;
+
+        while (g_ascii_isspace (**json))
+                (*json)++;
+
+        switch (**json) {
+        case '"':
+                return scan_string (json, &str, &len);
+
+        case '{':
+                return scan_object (json,
+                                    skip_member,
+                                    GUINT_TO_POINTER (depth + 1));
+
+        case '[':
+                (*json)++;
+                if (scan_char (json, ']'))
+                        return TRUE;
+
+                do {
+                        if (!skip_value (json, depth + 1))
+                                return FALSE;
+                } while (scan_char (json, ','));
+
+                return scan_char (json, ']');
+
+        default:
+                /* Numbers, true, false and null */
+                str = *json;
+                while (**json != '\0' &&
+                       (g_ascii_isalnum (**json) ||
+                        strchr ("+-.", **json) != NULL))
+                        (*json)++;
+
+                return *json != str;
+        }
+}
+
+enum {
+        HAS_LATITUDE  = 1 << 0,
+        HAS_LONGITUDE = 1 << 1,
+        HAS_ACCURACY  = 1 << 2,
+        HAS_ALL       = HAS_LATITUDE | HAS_LONGITUDE | HAS_ACCURACY,
+};
+
+typedef struct {
+        gdouble latitude;
+        gdouble longitude;
+        gdouble accuracy;
+        guint found;
+} Response;
+
+static gboolean
+name_is (const char *name,
+         gsize       name_len,
+         const char *expected)
+{
+        return strlen (expected) == name_len &&
+               strncmp (name, expected, name_len) == 0;
+}
+
+static gboolean
+scan_location_member (const char **json,
+                      const char  *name,
+                      gsize        name_len,
+                      gpointer     user_data)
+{
+        Response *response = user_data;
+
+        if (name_is (name, name_len, "lat")) {
+                response->found |= HAS_LATITUDE;
+
+                return scan_number (json, &response->latitude);
+        }
+
+        if (name_is (name, name_len, "lng")) {
+                response->found |= HAS_LONGITUDE;
+
+                return scan_number (json, &response->longitude);
+        }
+
+        return skip_value (json, 2);
+}
+
+static gboolean
+scan_response_member (const char **json,
+                      const char  *name,
+                      gsize        name_len,
+                      gpointer     user_data)
+{
+        Response *response = user_data;
+
+        if (name_is (name, name_len, "location"))
+                return scan_object (json, scan_location_member, response);
+
+        if (name_is (name, name_len, "accuracy")) {
+                response->found |= HAS_ACCURACY;
+
+                return scan_number (json, &response->accuracy);
+        }
+
+        /* Leave error responses to parse_response_tree() */
+        if (name_is (name, name_len, "error"))
+                return FALSE;
+
+        return skip_value (json, 1);
+}
+
+static GClueLocation *
+scan_response (const char *json)
+{
+        Response response = { 0 };
+
+        if (!scan_object (&json, scan_response_member, &response) ||
+            !scan_char (&json, '\0') ||
+            response.found != HAS_ALL ||
+            !location_is_valid (response.latitude,
+                                response.longitude,
+                                response.accuracy))
+                return NULL;
+
+        return gclue_location_new (response.latitude,
+                                   response.longitude,
+                                   response.accuracy);
+}
+
+static GClueLocation *
+parse_response_tree (const char *json,
+                     GError    **error)
 {
         JsonParser *parser;
         JsonNode *node;
         JsonObject *object, *loc_object;
-        GClueLocation *location;
+        GClueLocation *location = NULL;
         gdouble latitude, longitude, accuracy;
 
         parser = json_parser_new ();
 
         if (!json_parser_load_from_data (parser, json, -1, error))
-                return NULL;
+                goto out;
 
         node = json_parser_get_root (parser);
+        if (node == NULL || !JSON_NODE_HOLDS_OBJECT (node)) {
+                g_set_error_literal (error,
+                                     GCLUE_ERROR,
+                                     GCLUE_ERROR_PARSE,
+                                     "Response is not a JSON object");
+                goto out;
+        }
         object = json_node_get_object (node);
 
         if (parse_server_error (object, error))
-                return NULL;
+                goto out;
 
-        loc_object = json_object_get_object_member (object, "location");
-        latitude = json_object_get_double_member (loc_object, "lat");
-        longitude = json_object_get_double_member (loc_object, "lng");
+        if (!json_object_has_member (object, "location") ||
+            !json_object_has_member (object, "accuracy")) {
+                g_set_error_literal (error,
+                                     GCLUE_ERROR,
+                                     GCLUE_ERROR_PARSE,
+                                     "Response has no location");
+                goto out;
+        }
 
-        accuracy = json_object_get_double_member (object, "accuracy");
+        loc_object = get_object_member (object, "location");
+        if (loc_object == NULL ||
+            !get_number_member (loc_object, "lat", &latitude) ||
+            !get_number_member (loc_object, "lng", &longitude) ||
+            !get_number_member (object, "accuracy", &accuracy) ||
+            !location_is_valid (latitude, longitude, accuracy)) {
+                g_set_error_literal (error,
+                                     GCLUE_ERROR,
+                                     GCLUE_ERROR_PARSE,
+                                     "Response has an invalid location");
+                goto out;
+        }
 
         location = gclue_location_new (latitude, longitude, accuracy);
 
+out:
         g_object_unref (parser);
 
         return location;
 }
 
+GClueLocation *
+gclue_mozilla_parse_response (const char *json,
+                              GError    **error)
+{
+        GClueLocation *location;
+
+        location = scan_response (json);
+        if (location != NULL)
+                return location;
+
+        return parse_response_tree (json, error);
+}
+
 static const char *
 get_submit_config (const char **nick)
 {
@@ -271,20 +569,57 @@ get_submit_config (const char **nick)
         return gclue_config_get_wifi_submit_url (config);
 }
 
-SoupMessage *
-gclue_mozilla_create_submit_query (GClueLocation   *location,
-                                   GList           *bss_list, /* As in Access Points */
-                                   GClue3GTower    *tower,
-                                   GError         **error)
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
 {
-        SoupMessage *ret = NULL;
-        JsonBuilder *builder;
-        JsonGenerator *generator;
-        JsonNode *root_node;
-        char *data, *timestamp;
+        return strcmp (*(const char **) a, *(const char **) b);
+}
+
+/* The sorted keys of the networks seen, as the submit queue tells duplicates
+ * by them.
+ */
+static char *
+get_networks (const GClueWifiScan *scan,
+              const GClue3GTower  *tower)
+{
+        GPtrArray *keys;
+        char *networks;
+        guint i;
+
+        keys = g_ptr_array_new_with_free_func (g_free);
+
+        if (scan != NULL)
+                for (i = 0; i < scan->n_bss; i++)
+                        g_ptr_array_add (keys, g_strdup (scan->bss[i].mac));
+
+        if (tower != NULL)
+                g_ptr_array_add (keys,
+                                 g_strdup_printf ("%u:%u:%lu:%lu",
+                                                  tower->mcc,
+                                                  tower->mnc,
+                                                  tower->lac,
+                                                  tower->cell_id));
+
+        g_ptr_array_sort (keys, compare_strings);
+        g_ptr_array_add (keys, NULL);
+        networks = g_strjoinv (",", (char **) keys->pdata);
+        g_ptr_array_unref (keys);
+
+        return networks;
+}
+
+GClueSubmission *
+gclue_mozilla_create_submission (GClueLocation       *location,
+                                 const GClueWifiScan *scan,
+                                 const GClue3GTower  *tower,
+                                 GError             **error)
+{
+        GClueSubmission *ret = NULL;
+        GString *json;
+        char *timestamp;
         const char *url, *nick;
-        gsize data_len;
-        GList *iter;
+        guint i;
         gdouble lat, lon, accuracy, altitude;
         GTimeVal tv;
 
@@ -292,143 +627,111 @@ gclue_mozilla_create_submit_query (GClueLocation   *location,
         if (url == NULL)
                 goto out;
 
-        builder = json_builder_new ();
-        json_builder_begin_object (builder);
-
-        json_builder_set_member_name (builder, "items");
-        json_builder_begin_array (builder);
-
-        json_builder_begin_object (builder);
+        json = json_new (scan);
+        gclue_json_begin (json, '{');
 
         lat = gclue_location_get_latitude (location);
-        json_builder_set_member_name (builder, "lat");
-        json_builder_add_double_value (builder, lat);
+        gclue_json_append_name (json, "lat");
+        gclue_json_append_double (json, lat);
 
         lon = gclue_location_get_longitude (location);
-        json_builder_set_member_name (builder, "lon");
-        json_builder_add_double_value (builder, lon);
+        gclue_json_append_name (json, "lon");
+        gclue_json_append_double (json, lon);
 
         accuracy = gclue_location_get_accuracy (location);
         if (accuracy != GCLUE_LOCATION_ACCURACY_UNKNOWN) {
-                json_builder_set_member_name (builder, "accuracy");
-                json_builder_add_double_value (builder, accuracy);
+                gclue_json_append_name (json, "accuracy");
+                gclue_json_append_double (json, accuracy);
         }
 
         altitude = gclue_location_get_altitude (location);
         if (altitude != GCLUE_LOCATION_ALTITUDE_UNKNOWN) {
-                json_builder_set_member_name (builder, "altitude");
-                json_builder_add_double_value (builder, altitude);
+                gclue_json_append_name (json, "altitude");
+                gclue_json_append_double (json, altitude);
         }
 
         tv.tv_sec = gclue_location_get_timestamp (location);
         tv.tv_usec = 0;
         timestamp = g_time_val_to_iso8601 (&tv);
-        json_builder_set_member_name (builder, "time");
-        json_builder_add_string_value (builder, timestamp);
+        gclue_json_append_name (json, "time");
+        gclue_json_append_string (json, timestamp);
         g_free (timestamp);
 
-        json_builder_set_member_name (builder, "radioType");
-        json_builder_add_string_value (builder, "gsm");
+        gclue_json_append_name (json, "radioType");
+        gclue_json_append_string (json, "gsm");
 
-        if (bss_list != NULL) {
-                json_builder_set_member_name (builder, "wifi");
-                json_builder_begin_array (builder);
+        if (scan != NULL && scan->n_bss > 0) {
+                gclue_json_append_name (json, "wifi");
+                gclue_json_begin (json, '[');
 
-                for (iter = bss_list; iter != NULL; iter = iter->next) {
-                        WPABSS *bss = WPA_BSS (iter->data);
-                        char mac[BSSID_STR_LEN] = { 0 };
+                for (i = 0; i < scan->n_bss; i++) {
+                        const GClueWifiBSS *bss = &scan->bss[i];
                         gint16 strength_dbm;
                         guint16 frequency;
 
-                        if (gclue_mozilla_should_ignore_bss (bss))
-                                continue;
-
-                        json_builder_begin_object (builder);
-                        json_builder_set_member_name (builder, "key");
-                        get_bssid_from_bss (bss, mac);
-                        json_builder_add_string_value (builder, mac);
+                        gclue_json_begin (json, '{');
+                        gclue_json_append_name (json, "key");
+                        gclue_json_append_string (json, bss->mac);
 
-                        json_builder_set_member_name (builder, "signal");
-                        strength_dbm = wpa_bss_get_signal (bss);
-                        json_builder_add_int_value (builder, strength_dbm);
+                        gclue_json_append_name (json, "signal");
+                        strength_dbm = bss->signal;
+                        gclue_json_append_int (json, strength_dbm);
 
-                        json_builder_set_member_name (builder, "frequency");
-                        frequency = wpa_bss_get_frequency (bss);
-                        json_builder_add_int_value (builder, frequency);
-                        json_builder_end_object (builder);
+                        gclue_json_append_name (json, "frequency");
+                        frequency = bss->frequency;
+                        gclue_json_append_int (json, frequency);
+                        gclue_json_end (json, '}');
                 }
 
-                json_builder_end_array (builder); /* wifi */
+                gclue_json_end (json, ']'); /* wifi */
         }
 
         if (tower != NULL) {
-                json_builder_set_member_name (builder, "cell");
-                json_builder_begin_array (builder);
+                gclue_json_append_name (json, "cell");
+                gclue_json_begin (json, '[');
 
-                json_builder_begin_object (builder);
+                gclue_json_begin (json, '{');
 
-                json_builder_set_member_name (builder, "radio");
-                json_builder_add_string_value (builder, "gsm");
-                json_builder_set_member_name (builder, "cid");
-                json_builder_add_int_value (builder, tower->cell_id);
-                json_builder_set_member_name (builder, "mcc");
-                json_builder_add_int_value (builder, tower->mcc);
-                json_builder_set_member_name (builder, "mnc");
-                json_builder_add_int_value (builder, tower->mnc);
-                json_builder_set_member_name (builder, "lac");
-                json_builder_add_int_value (builder, tower->lac);
+                gclue_json_append_name (json, "radio");
+                gclue_json_append_string (json, "gsm");
+                gclue_json_append_name (json, "cid");
+                gclue_json_append_int (json, tower->cell_id);
+                gclue_json_append_name (json, "mcc");
+                gclue_json_append_int (json, tower->mcc);
+                gclue_json_append_name (json, "mnc");
+                gclue_json_append_int (json, tower->mnc);
+                gclue_json_append_name (json, "lac");
+                gclue_json_append_int (json, tower->lac);
 
-                json_builder_end_object (builder);
+                gclue_json_end (json, '}');
 
-                json_builder_end_array (builder); /* cell */
+                gclue_json_end (json, ']'); /* cell */
         }
 
-        json_builder_end_object (builder);
-        json_builder_end_array (builder); /* items */
-        json_builder_end_object (builder);
+        gclue_json_end (json, '}');
 
-        generator = json_generator_new ();
-        root_node = json_builder_get_root (builder);
-        json_generator_set_root (generator, root_node);
-        data = json_generator_to_data (generator, &data_len);
-
-        json_node_free (root_node);
-        g_object_unref (builder);
-        g_object_unref (generator);
-
-        ret = soup_message_new ("POST", url);
-        if (nick != NULL && nick[0] != '\0')
-                soup_message_headers_append (ret->request_headers,
-                                             "X-Nickname",
-                                             nick);
-        soup_message_set_request (ret,
-                                  "application/json",
-                                  SOUP_MEMORY_TAKE,
-                                  data,
-                                  data_len);
-        g_debug ("Sending following request to '%s':\n%s", url, data);
+        ret = g_slice_new (GClueSubmission);
+        ret->url = g_strdup (url);
+        ret->nick = (nick != NULL && nick[0] != '\0') ? g_strdup (nick) : NULL;
+        ret->item = g_string_free (json, FALSE);
+        ret->latitude = lat;
+        ret->longitude = lon;
+        ret->networks = get_networks (scan, tower);
+        g_debug ("Queueing following submission to '%s':\n%s",
+                 url,
+                 ret->item);
 
 out:
         return ret;
 }
 
 gboolean
-gclue_mozilla_should_ignore_bss (WPABSS *bss)
+gclue_mozilla_should_ignore_bss (GClueWifiBSS *bss)
 {
-        char ssid[MAX_SSID_LEN] = { 0 };
-        char bssid[BSSID_STR_LEN] = { 0 };
-        guint len;
-
-        if (!get_bssid_from_bss (bss, bssid)) {
-                g_debug ("Ignoring WiFi AP with unknown BSSID..");
-                return TRUE;
-        }
-
-        len = get_ssid_from_bss (bss, ssid);
-        if (len == 0 || g_str_has_suffix (ssid, "_nomap")) {
+        if (bss->nomap) {
                 g_debug ("SSID for WiFi AP '%s' missing or has '_nomap' suffix."
                          ", Ignoring..",
-                         bssid);
+                         bss->mac);
                 return TRUE;
         }
 
@@ -24,26 +24,27 @@
 
 #include <glib.h>
 #include <libsoup/soup.h>
-#include "wpa_supplicant-interface.h"
 #include "gclue-location.h"
 #include "gclue-3g-tower.h"
+#include "gclue-wifi-scan.h"
+#include "gclue-submit-queue.h"
 
 G_BEGIN_DECLS
 
 SoupMessage *
-gclue_mozilla_create_query (GList        *bss_list, /* As in Access Points */
-                            GClue3GTower *tower,
-                            GError      **error);
+gclue_mozilla_create_query (const GClueWifiScan *scan,
+                            const GClue3GTower  *tower,
+                            GError             **error);
 GClueLocation *
 gclue_mozilla_parse_response (const char *json,
                               GError    **error);
-SoupMessage *
-gclue_mozilla_create_submit_query (GClueLocation   *location,
-                                   GList           *bss_list, /* As in Access Points */
-                                   GClue3GTower    *tower,
-                                   GError         **error);
+GClueSubmission *
+gclue_mozilla_create_submission (GClueLocation       *location,
+                                 const GClueWifiScan *scan,
+                                 const GClue3GTower  *tower,
+                                 GError             **error);
 gboolean
-gclue_mozilla_should_ignore_bss (WPABSS *bss);
+gclue_mozilla_should_ignore_bss (GClueWifiBSS *bss);
 
 G_END_DECLS
 
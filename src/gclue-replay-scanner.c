@@ -0,0 +1,595 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-replay-scanner.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+#include <string.h>
+#include "gclue-replay-scanner.h"
+#include "gclue-wifi-bss.h"
+#include "gclue-mozilla.h"
+
+/**
+ * SECTION:gclue-replay-scanner
+ * @short_description: WiFi scanner replaying a recorded trace
+ *
+ * Plays back the access points recorded in a file, at the recorded pace or
+ * faster, as if they came from a single WiFi device. This allows running and
+ * benchmarking the WiFi source deterministically, without any radio.
+ *
+ * Each line of the file holds a time in seconds since the start of the
+ * recording, a BSSID, a signal strength (dBm), a frequency (MHz) and
+ * optionally an SSID, separated by spaces. Consecutive lines with the same time
+ * make up one scan. Empty lines and lines starting with '#' are ignored.
+ *
+ * Each scan of the trace is reported as soon as its time comes, whether a scan
+ * was asked for or not, since that is what happened when it was recorded. So
+ * the trace sets the pace of the scans, and users take every scan of it, at
+ * whatever speed it is replayed. Once the trace is over, scans keep seeing the
+ * last set of access points.
+ **/
+
+static void
+gclue_wifi_scanner_interface_init (GClueWifiScannerInterface *iface);
+static void
+gclue_replay_scanner_initable_iface_init (GInitableIface *iface);
+
+typedef struct {
+        gdouble time;  /* Seconds since start of the recording */
+        GArray *bss;   /* GClueWifiBSS */
+} ReplayScan;
+
+struct _GClueReplayScannerPrivate {
+        char *path;
+        gdouble speed;
+
+        GArray *trace;           /* ReplayScan */
+        guint next_scan;         /* Index in trace */
+        GHashTable *bss_records; /* BSSID => GClueWifiBSS */
+
+        guint n_users;
+        gint64 started;
+        gint64 scan_started; /* Of the latest scan replayed */
+        guint scan_id;       /* Of the latest scan replayed */
+        guint replay_timeout;
+        guint scan_idle;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueReplayScanner,
+                         gclue_replay_scanner,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GCLUE_TYPE_WIFI_SCANNER,
+                                                gclue_wifi_scanner_interface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
+                                                gclue_replay_scanner_initable_iface_init)
+                         G_ADD_PRIVATE (GClueReplayScanner))
+
+enum
+{
+        PROP_0,
+        PROP_IS_READY,
+        PROP_PATH,
+        PROP_SPEED,
+        LAST_PROP
+};
+static GParamSpec *gParamSpecs[LAST_PROP];
+
+static void
+stop_replay (GClueReplayScanner *scanner);
+
+static void
+replay_scan_clear (ReplayScan *scan)
+{
+        g_array_unref (scan->bss);
+}
+
+static void
+gclue_replay_scanner_finalize (GObject *object)
+{
+        GClueReplayScannerPrivate *priv = GCLUE_REPLAY_SCANNER (object)->priv;
+
+        stop_replay (GCLUE_REPLAY_SCANNER (object));
+        g_clear_pointer (&priv->bss_records, g_hash_table_unref);
+        g_clear_pointer (&priv->trace, g_array_unref);
+        g_clear_pointer (&priv->path, g_free);
+
+        G_OBJECT_CLASS (gclue_replay_scanner_parent_class)->finalize (object);
+}
+
+static void
+gclue_replay_scanner_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+        GClueReplayScanner *scanner = GCLUE_REPLAY_SCANNER (object);
+
+        switch (prop_id) {
+        case PROP_IS_READY:
+                g_value_set_boolean (value, TRUE);
+                break;
+
+        case PROP_PATH:
+                g_value_set_string (value, scanner->priv->path);
+                break;
+
+        case PROP_SPEED:
+                g_value_set_double (value, scanner->priv->speed);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_replay_scanner_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+        GClueReplayScanner *scanner = GCLUE_REPLAY_SCANNER (object);
+
+        switch (prop_id) {
+        case PROP_PATH:
+                scanner->priv->path = g_value_dup_string (value);
+                break;
+
+        case PROP_SPEED:
+                scanner->priv->speed = g_value_get_double (value);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_replay_scanner_class_init (GClueReplayScannerClass *klass)
+{
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        object_class->finalize = gclue_replay_scanner_finalize;
+        object_class->get_property = gclue_replay_scanner_get_property;
+        object_class->set_property = gclue_replay_scanner_set_property;
+
+        g_object_class_override_property (object_class,
+                                          PROP_IS_READY,
+                                          "is-ready");
+        gParamSpecs[PROP_IS_READY] =
+                        g_object_class_find_property (object_class,
+                                                      "is-ready");
+
+        gParamSpecs[PROP_PATH] = g_param_spec_string ("path",
+                                                      "Path",
+                                                      "Path of the trace file",
+                                                      NULL,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_PATH,
+                                         gParamSpecs[PROP_PATH]);
+
+        gParamSpecs[PROP_SPEED] = g_param_spec_double ("speed",
+                                                       "Speed",
+                                                       "Replay speed",
+                                                       G_MINDOUBLE,
+                                                       G_MAXDOUBLE,
+                                                       1.0,
+                                                       G_PARAM_READWRITE |
+                                                       G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_SPEED,
+                                         gParamSpecs[PROP_SPEED]);
+}
+
+static void
+gclue_replay_scanner_init (GClueReplayScanner *scanner)
+{
+        scanner->priv = G_TYPE_INSTANCE_GET_PRIVATE (scanner,
+                                                     GCLUE_TYPE_REPLAY_SCANNER,
+                                                     GClueReplayScannerPrivate);
+
+        scanner->priv->trace = g_array_new (FALSE,
+                                            FALSE,
+                                            sizeof (ReplayScan));
+        g_array_set_clear_func (scanner->priv->trace,
+                                (GDestroyNotify) replay_scan_clear);
+        scanner->priv->bss_records = g_hash_table_new_full
+                (g_int64_hash,
+                 g_int64_equal,
+                 NULL,
+                 (GDestroyNotify) gclue_wifi_bss_free);
+}
+
+/* Parses "<time> <BSSID> <signal> <frequency> [SSID]" */
+static gboolean
+parse_line (const char   *line,
+            gdouble      *time,
+            GClueWifiBSS *bss)
+{
+        GClueWifiBSS *parsed;
+        char **fields;
+        char *end;
+        gint64 signal, frequency;
+        gboolean ret = FALSE;
+
+        fields = g_strsplit (line, " ", 5);
+        if (g_strv_length (fields) < 4)
+                goto out;
+
+        *time = g_ascii_strtod (fields[0], &end);
+        if (end == fields[0] || *end != '\0' || *time < 0)
+                goto out;
+
+        signal = g_ascii_strtoll (fields[2], &end, 10);
+        if (end == fields[2] || *end != '\0' ||
+            signal < G_MININT16 || signal > 0)
+                goto out;
+
+        frequency = g_ascii_strtoll (fields[3], &end, 10);
+        if (end == fields[3] || *end != '\0' ||
+            frequency < 0 || frequency > G_MAXUINT16)
+                goto out;
+
+        parsed = gclue_wifi_bss_new_for_mac (fields[1], fields[4], 0);
+        if (parsed == NULL)
+                goto out;
+
+        *bss = *parsed;
+        bss->signal = signal;
+        bss->frequency = frequency;
+        gclue_wifi_bss_free (parsed);
+        ret = TRUE;
+
+out:
+        g_strfreev (fields);
+
+        return ret;
+}
+
+static gboolean
+load_trace (GClueReplayScanner *scanner,
+            GError            **error)
+{
+        GClueReplayScannerPrivate *priv = scanner->priv;
+        char *contents;
+        char **lines;
+        guint i;
+        gboolean ret = FALSE;
+
+        if (!g_file_get_contents (priv->path, &contents, NULL, error))
+                return FALSE;
+
+        lines = g_strsplit (contents, "\n", -1);
+        g_free (contents);
+
+        for (i = 0; lines[i] != NULL; i++) {
+                char *line = g_strstrip (lines[i]);
+                ReplayScan *scan = NULL;
+                GClueWifiBSS bss;
+                gdouble time;
+
+                if (line[0] == '\0' || line[0] == '#')
+                        continue;
+
+                if (!parse_line (line, &time, &bss)) {
+                        g_set_error (error,
+                                     G_IO_ERROR,
+                                     G_IO_ERROR_INVALID_DATA,
+                                     "%s:%u: Invalid access point",
+                                     priv->path,
+                                     i + 1);
+                        goto out;
+                }
+
+                if (priv->trace->len > 0)
+                        scan = &g_array_index (priv->trace,
+                                               ReplayScan,
+                                               priv->trace->len - 1);
+                if (scan != NULL && time < scan->time) {
+                        g_set_error (error,
+                                     G_IO_ERROR,
+                                     G_IO_ERROR_INVALID_DATA,
+                                     "%s:%u: Time goes backwards",
+                                     priv->path,
+                                     i + 1);
+                        goto out;
+                }
+
+                if (scan == NULL || time > scan->time) {
+                        ReplayScan new_scan;
+
+                        new_scan.time = time;
+                        new_scan.bss = g_array_new (FALSE,
+                                                    FALSE,
+                                                    sizeof (GClueWifiBSS));
+                        g_array_append_val (priv->trace, new_scan);
+                        scan = &g_array_index (priv->trace,
+                                               ReplayScan,
+                                               priv->trace->len - 1);
+                }
+
+                if (!gclue_mozilla_should_ignore_bss (&bss))
+                        g_array_append_val (scan->bss, bss);
+        }
+
+        g_debug ("Loaded %u WiFi scans to replay from '%s'",
+                 priv->trace->len,
+                 priv->path);
+        ret = TRUE;
+
+out:
+        g_strfreev (lines);
+
+        return ret;
+}
+
+static gboolean
+gclue_replay_scanner_initable_init (GInitable    *initable,
+                                    GCancellable *cancellable,
+                                    GError      **error)
+{
+        return load_trace (GCLUE_REPLAY_SCANNER (initable), error);
+}
+
+static void
+gclue_replay_scanner_initable_iface_init (GInitableIface *iface)
+{
+        iface->init = gclue_replay_scanner_initable_init;
+}
+
+/* Replaces the visible APs with the ones of the next scan of the trace */
+static void
+replay_next_scan (GClueReplayScanner *scanner)
+{
+        GClueReplayScannerPrivate *priv = scanner->priv;
+        ReplayScan *scan;
+        GHashTable *records;
+        gboolean changed;
+        gint64 now;
+        guint i;
+
+        scan = &g_array_index (priv->trace, ReplayScan, priv->next_scan);
+        priv->next_scan++;
+
+        now = g_get_monotonic_time ();
+        priv->scan_started = now;
+        priv->scan_id++;
+        records = g_hash_table_new_full (g_int64_hash,
+                                         g_int64_equal,
+                                         NULL,
+                                         (GDestroyNotify) gclue_wifi_bss_free);
+        changed = (scan->bss->len != g_hash_table_size (priv->bss_records));
+        for (i = 0; i < scan->bss->len; i++) {
+                GClueWifiBSS *bss;
+
+                bss = g_slice_dup (GClueWifiBSS,
+                                   &g_array_index (scan->bss,
+                                                   GClueWifiBSS,
+                                                   i));
+                bss->path_id = i;
+                bss->last_seen = now;
+                if (!g_hash_table_contains (priv->bss_records, &bss->bssid))
+                        changed = TRUE;
+
+                g_hash_table_replace (records, &bss->bssid, bss);
+        }
+        g_hash_table_unref (priv->bss_records);
+        priv->bss_records = records;
+
+        g_debug ("Replaying WiFi scan %u of %u, at %.1f seconds",
+                 priv->next_scan,
+                 priv->trace->len,
+                 scan->time);
+        if (changed)
+                g_signal_emit_by_name (scanner, "bss-list-changed");
+        g_signal_emit_by_name (scanner, "scan-done", TRUE);
+}
+
+static void
+schedule_next_scan (GClueReplayScanner *scanner);
+
+static gboolean
+on_replay_timeout (gpointer user_data)
+{
+        GClueReplayScanner *scanner = GCLUE_REPLAY_SCANNER (user_data);
+
+        scanner->priv->replay_timeout = 0;
+        replay_next_scan (scanner);
+        schedule_next_scan (scanner);
+
+        return FALSE;
+}
+
+static void
+schedule_next_scan (GClueReplayScanner *scanner)
+{
+        GClueReplayScannerPrivate *priv = scanner->priv;
+        ReplayScan *scan;
+        gdouble elapsed, delay;
+
+        if (priv->next_scan >= priv->trace->len) {
+                g_debug ("Replay of '%s' finished", priv->path);
+
+                return;
+        }
+
+        /* Relative to the start, so timer slack doesn't add up */
+        scan = &g_array_index (priv->trace, ReplayScan, priv->next_scan);
+        elapsed = (gdouble) (g_get_monotonic_time () - priv->started) /
+                  G_USEC_PER_SEC;
+        delay = MAX (scan->time / priv->speed - elapsed, 0);
+        priv->replay_timeout = g_timeout_add ((guint) (delay * 1000),
+                                              on_replay_timeout,
+                                              scanner);
+}
+
+static gboolean
+on_scan_idle (gpointer user_data)
+{
+        GClueReplayScanner *scanner = GCLUE_REPLAY_SCANNER (user_data);
+
+        scanner->priv->scan_idle = 0;
+        scanner->priv->scan_started = g_get_monotonic_time ();
+        scanner->priv->scan_id++;
+        g_signal_emit_by_name (scanner, "scan-done", TRUE);
+
+        return FALSE;
+}
+
+static guint
+gclue_replay_scanner_scan (GClueWifiScanner    *wifi_scanner,
+                           const GClueWifiScan *last_scan,
+                           gboolean             active,
+                           gboolean             full)
+{
+        GClueReplayScanner *scanner = GCLUE_REPLAY_SCANNER (wifi_scanner);
+        GClueReplayScannerPrivate *priv = scanner->priv;
+
+        /* The next scan of the trace will answer, unless there is none */
+        if (priv->replay_timeout == 0 && priv->scan_idle == 0)
+                priv->scan_idle = g_idle_add (on_scan_idle, scanner);
+
+        return priv->scan_id + 1;
+}
+
+static void
+stop_replay (GClueReplayScanner *scanner)
+{
+        GClueReplayScannerPrivate *priv = scanner->priv;
+
+        if (priv->replay_timeout != 0) {
+                g_source_remove (priv->replay_timeout);
+                priv->replay_timeout = 0;
+        }
+        if (priv->scan_idle != 0) {
+                g_source_remove (priv->scan_idle);
+                priv->scan_idle = 0;
+        }
+        priv->started = 0;
+        priv->scan_started = 0;
+
+        if (priv->bss_records != NULL)
+                g_hash_table_remove_all (priv->bss_records);
+}
+
+static void
+gclue_replay_scanner_start (GClueWifiScanner *wifi_scanner)
+{
+        GClueReplayScanner *scanner = GCLUE_REPLAY_SCANNER (wifi_scanner);
+        GClueReplayScannerPrivate *priv = scanner->priv;
+
+        if (priv->n_users++ > 0)
+                return;
+
+        priv->started = g_get_monotonic_time ();
+        priv->next_scan = 0;
+        schedule_next_scan (scanner);
+}
+
+static void
+gclue_replay_scanner_stop (GClueWifiScanner *wifi_scanner)
+{
+        GClueReplayScanner *scanner = GCLUE_REPLAY_SCANNER (wifi_scanner);
+        GClueReplayScannerPrivate *priv = scanner->priv;
+
+        if (priv->n_users == 0 || --priv->n_users > 0)
+                return;
+
+        stop_replay (scanner);
+}
+
+/* The trace is loaded on construction already */
+static gboolean
+gclue_replay_scanner_get_is_ready (GClueWifiScanner *scanner)
+{
+        return TRUE;
+}
+
+static gboolean
+gclue_replay_scanner_get_has_devices (GClueWifiScanner *scanner)
+{
+        return GCLUE_REPLAY_SCANNER (scanner)->priv->trace->len > 0;
+}
+
+static GHashTable *
+gclue_replay_scanner_get_bss_records (GClueWifiScanner *scanner)
+{
+        return GCLUE_REPLAY_SCANNER (scanner)->priv->bss_records;
+}
+
+static gint64
+gclue_replay_scanner_get_scan_started (GClueWifiScanner *scanner)
+{
+        return GCLUE_REPLAY_SCANNER (scanner)->priv->scan_started;
+}
+
+static guint
+gclue_replay_scanner_get_scan_id (GClueWifiScanner *scanner)
+{
+        return GCLUE_REPLAY_SCANNER (scanner)->priv->scan_id;
+}
+
+/* The scans come when they came in the trace */
+static gboolean
+gclue_replay_scanner_get_sets_pace (GClueWifiScanner *scanner)
+{
+        return TRUE;
+}
+
+static void
+gclue_wifi_scanner_interface_init (GClueWifiScannerInterface *iface)
+{
+        iface->get_is_ready = gclue_replay_scanner_get_is_ready;
+        iface->get_has_devices = gclue_replay_scanner_get_has_devices;
+        iface->get_bss_records = gclue_replay_scanner_get_bss_records;
+        iface->get_scan_started = gclue_replay_scanner_get_scan_started;
+        iface->get_scan_id = gclue_replay_scanner_get_scan_id;
+        iface->get_sets_pace = gclue_replay_scanner_get_sets_pace;
+        iface->start = gclue_replay_scanner_start;
+        iface->stop = gclue_replay_scanner_stop;
+        iface->scan = gclue_replay_scanner_scan;
+}
+
+/**
+ * gclue_replay_scanner_new:
+ * @path: Path of the trace file
+ * @speed: How much faster than recorded to replay the trace
+ * @error: Return location for errors
+ *
+ * Creates a scanner replaying the access points recorded in @path.
+ *
+ * Returns: (transfer full): A new #GClueWifiScanner, or %NULL if @path could
+ * not be loaded. Use g_object_unref() when done.
+ **/
+GClueWifiScanner *
+gclue_replay_scanner_new (const char *path,
+                          gdouble     speed,
+                          GError    **error)
+{
+        return g_initable_new (GCLUE_TYPE_REPLAY_SCANNER,
+                               NULL,
+                               error,
+                               "path", path,
+                               "speed", speed,
+                               NULL);
+}
@@ -0,0 +1,71 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-replay-scanner.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_REPLAY_SCANNER_H
+#define GCLUE_REPLAY_SCANNER_H
+
+#include <gio/gio.h>
+#include "gclue-wifi-scanner.h"
+
+G_BEGIN_DECLS
+
+GType gclue_replay_scanner_get_type (void) G_GNUC_CONST;
+
+#define GCLUE_TYPE_REPLAY_SCANNER            (gclue_replay_scanner_get_type ())
+#define GCLUE_REPLAY_SCANNER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_REPLAY_SCANNER, GClueReplayScanner))
+#define GCLUE_IS_REPLAY_SCANNER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_REPLAY_SCANNER))
+#define GCLUE_REPLAY_SCANNER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GCLUE_TYPE_REPLAY_SCANNER, GClueReplayScannerClass))
+#define GCLUE_IS_REPLAY_SCANNER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GCLUE_TYPE_REPLAY_SCANNER))
+#define GCLUE_REPLAY_SCANNER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GCLUE_TYPE_REPLAY_SCANNER, GClueReplayScannerClass))
+
+/**
+ * GClueReplayScanner:
+ *
+ * All the fields in the #GClueReplayScanner structure are private and should never be accessed directly.
+**/
+typedef struct _GClueReplayScanner        GClueReplayScanner;
+typedef struct _GClueReplayScannerClass   GClueReplayScannerClass;
+typedef struct _GClueReplayScannerPrivate GClueReplayScannerPrivate;
+
+struct _GClueReplayScanner {
+        /* <private> */
+        GObject parent_instance;
+        GClueReplayScannerPrivate *priv;
+};
+
+/**
+ * GClueReplayScannerClass:
+ *
+ * All the fields in the #GClueReplayScannerClass structure are private and should never be accessed directly.
+**/
+struct _GClueReplayScannerClass {
+        /* <private> */
+        GObjectClass parent_class;
+};
+
+GClueWifiScanner * gclue_replay_scanner_new (const char *path,
+                                             gdouble     speed,
+                                             GError    **error);
+
+G_END_DECLS
+
+#endif /* GCLUE_REPLAY_SCANNER_H */
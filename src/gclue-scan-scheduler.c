@@ -0,0 +1,365 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-scan-scheduler.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <glib.h>
+#include "gclue-scan-scheduler.h"
+
+/**
+ * SECTION:gclue-scan-scheduler
+ * @short_description: Picks the delay between network scans
+ *
+ * Scanning is expensive, both in terms of power and CPU, and while the device
+ * doesn't move it only confirms that nothing changed. The scheduler keeps
+ * track of how much the scan results drifted recently and of the speed of the
+ * device, backs off exponentially while the device seems stationary and goes
+ * back to the minimum interval as soon as movement is detected. The interval
+ * is never shorter than the smallest time-threshold requested by clients,
+ * since they wouldn't want updates more often than that anyway.
+ *
+ * It also decides when a scan should sweep all channels. In between, scans can
+ * be restricted to the channels the access points around us were last seen
+ * on, which is a lot quicker.
+ **/
+
+/* Drift (0.0 - 1.0, as in 1 - similarity of consecutive scans) above which
+ * we consider the device to be moving.
+ */
+#define DRIFT_MOVING       0.3
+/* And below which we consider it stationary */
+#define DRIFT_STATIONARY   0.1
+/* Speed (m/s) from which we consider the device to be moving, i-e about
+ * walking pace.
+ */
+#define SPEED_MOVING       1.0
+/* Speed reports older than this (seconds) tell us nothing anymore */
+#define SPEED_MAX_AGE      120
+/* While stationary, every this many scans sweeps all channels */
+#define FULL_SCAN_EVERY    5
+
+struct _GClueScanSchedulerPrivate
+{
+        guint min_interval;
+        guint max_interval;
+        GClueMinUINT *time_threshold;
+
+        guint interval;
+        gdouble drift;
+        gdouble speed;
+        gint64 speed_time;
+
+        gboolean moving;
+        guint scans_since_full;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueScanScheduler,
+                         gclue_scan_scheduler,
+                         G_TYPE_OBJECT,
+                         G_ADD_PRIVATE (GClueScanScheduler))
+
+enum
+{
+        PROP_0,
+        PROP_MIN_INTERVAL,
+        PROP_MAX_INTERVAL,
+        PROP_TIME_THRESHOLD,
+        LAST_PROP
+};
+
+static GParamSpec *gParamSpecs[LAST_PROP];
+
+static void
+gclue_scan_scheduler_finalize (GObject *object)
+{
+        GClueScanSchedulerPrivate *priv = GCLUE_SCAN_SCHEDULER (object)->priv;
+
+        g_clear_object (&priv->time_threshold);
+
+        G_OBJECT_CLASS (gclue_scan_scheduler_parent_class)->finalize (object);
+}
+
+static void
+gclue_scan_scheduler_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+        GClueScanSchedulerPrivate *priv = GCLUE_SCAN_SCHEDULER (object)->priv;
+
+        switch (prop_id) {
+        case PROP_MIN_INTERVAL:
+                g_value_set_uint (value, priv->min_interval);
+                break;
+
+        case PROP_MAX_INTERVAL:
+                g_value_set_uint (value, priv->max_interval);
+                break;
+
+        case PROP_TIME_THRESHOLD:
+                g_value_set_object (value, priv->time_threshold);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_scan_scheduler_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+        GClueScanSchedulerPrivate *priv = GCLUE_SCAN_SCHEDULER (object)->priv;
+
+        switch (prop_id) {
+        case PROP_MIN_INTERVAL:
+                priv->min_interval = g_value_get_uint (value);
+                priv->interval = priv->min_interval;
+                break;
+
+        case PROP_MAX_INTERVAL:
+                priv->max_interval = g_value_get_uint (value);
+                break;
+
+        case PROP_TIME_THRESHOLD:
+                priv->time_threshold = g_value_dup_object (value);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_scan_scheduler_class_init (GClueScanSchedulerClass *klass)
+{
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        object_class->finalize = gclue_scan_scheduler_finalize;
+        object_class->get_property = gclue_scan_scheduler_get_property;
+        object_class->set_property = gclue_scan_scheduler_set_property;
+
+        gParamSpecs[PROP_MIN_INTERVAL] = g_param_spec_uint ("min-interval",
+                                                            "MinInterval",
+                                                            "Minimum interval "
+                                                            "between scans",
+                                                            1,
+                                                            G_MAXUINT,
+                                                            10,
+                                                            G_PARAM_READWRITE |
+                                                            G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_MIN_INTERVAL,
+                                         gParamSpecs[PROP_MIN_INTERVAL]);
+
+        gParamSpecs[PROP_MAX_INTERVAL] = g_param_spec_uint ("max-interval",
+                                                            "MaxInterval",
+                                                            "Maximum interval "
+                                                            "between scans",
+                                                            1,
+                                                            G_MAXUINT,
+                                                            300,
+                                                            G_PARAM_READWRITE |
+                                                            G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_MAX_INTERVAL,
+                                         gParamSpecs[PROP_MAX_INTERVAL]);
+
+        gParamSpecs[PROP_TIME_THRESHOLD] =
+                g_param_spec_object ("time-threshold",
+                                     "TimeThreshold",
+                                     "Time-threshold of location updates",
+                                     GCLUE_TYPE_MIN_UINT,
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_TIME_THRESHOLD,
+                                         gParamSpecs[PROP_TIME_THRESHOLD]);
+}
+
+static void
+gclue_scan_scheduler_init (GClueScanScheduler *scheduler)
+{
+        scheduler->priv = G_TYPE_INSTANCE_GET_PRIVATE (scheduler,
+                                                       GCLUE_TYPE_SCAN_SCHEDULER,
+                                                       GClueScanSchedulerPrivate);
+        scheduler->priv->scans_since_full = FULL_SCAN_EVERY;
+}
+
+/**
+ * gclue_scan_scheduler_new:
+ * @min_interval: Minimum interval between scans, in seconds
+ * @max_interval: Maximum interval between scans, in seconds
+ * @time_threshold: (allow-none): Time-threshold of the scanning source
+ *
+ * Returns: (transfer full): A new #GClueScanScheduler.
+ **/
+GClueScanScheduler *
+gclue_scan_scheduler_new (guint         min_interval,
+                          guint         max_interval,
+                          GClueMinUINT *time_threshold)
+{
+        return g_object_new (GCLUE_TYPE_SCAN_SCHEDULER,
+                             "min-interval", min_interval,
+                             "max-interval", MAX (min_interval, max_interval),
+                             "time-threshold", time_threshold,
+                             NULL);
+}
+
+/**
+ * gclue_scan_scheduler_reset:
+ * @scheduler: a #GClueScanScheduler
+ *
+ * Forgets about the past, e.g when scanning is (re)started. The next interval
+ * will be the minimum one and the next scan will sweep all channels.
+ **/
+void
+gclue_scan_scheduler_reset (GClueScanScheduler *scheduler)
+{
+        GClueScanSchedulerPrivate *priv;
+
+        g_return_if_fail (GCLUE_IS_SCAN_SCHEDULER (scheduler));
+        priv = scheduler->priv;
+
+        priv->interval = priv->min_interval;
+        priv->drift = 0.0;
+        priv->speed_time = 0;
+        priv->moving = FALSE;
+        priv->scans_since_full = FULL_SCAN_EVERY;
+}
+
+/**
+ * gclue_scan_scheduler_report_drift:
+ * @scheduler: a #GClueScanScheduler
+ * @drift: How much the last scan differed from the one before it, from 0.0
+ * (identical) to 1.0 (nothing in common).
+ **/
+void
+gclue_scan_scheduler_report_drift (GClueScanScheduler *scheduler,
+                                   gdouble             drift)
+{
+        g_return_if_fail (GCLUE_IS_SCAN_SCHEDULER (scheduler));
+
+        scheduler->priv->drift = CLAMP (drift, 0.0, 1.0);
+}
+
+/**
+ * gclue_scan_scheduler_report_speed:
+ * @scheduler: a #GClueScanScheduler
+ * @speed: Current speed estimate, in meters per second
+ **/
+void
+gclue_scan_scheduler_report_speed (GClueScanScheduler *scheduler,
+                                   gdouble             speed)
+{
+        g_return_if_fail (GCLUE_IS_SCAN_SCHEDULER (scheduler));
+
+        if (speed < 0)
+                return;
+
+        scheduler->priv->speed = speed;
+        scheduler->priv->speed_time = g_get_monotonic_time ();
+}
+
+/**
+ * gclue_scan_scheduler_next_interval:
+ * @scheduler: a #GClueScanScheduler
+ *
+ * Picks the delay until the next scan, based on what has been reported since
+ * the last call.
+ *
+ * Returns: The delay in seconds.
+ **/
+guint
+gclue_scan_scheduler_next_interval (GClueScanScheduler *scheduler)
+{
+        GClueScanSchedulerPrivate *priv;
+        gboolean speed_known, moving, stationary;
+        guint threshold = 0, floor, ceiling;
+
+        g_return_val_if_fail (GCLUE_IS_SCAN_SCHEDULER (scheduler), 0);
+        priv = scheduler->priv;
+
+        speed_known = priv->speed_time != 0 &&
+                      g_get_monotonic_time () - priv->speed_time <
+                      SPEED_MAX_AGE * G_USEC_PER_SEC;
+
+        moving = (speed_known && priv->speed >= SPEED_MOVING) ||
+                 priv->drift >= DRIFT_MOVING;
+        stationary = (!speed_known || priv->speed < SPEED_MOVING) &&
+                     priv->drift <= DRIFT_STATIONARY;
+
+        priv->moving = moving;
+        if (moving)
+                priv->interval = priv->min_interval;
+        else if (stationary)
+                priv->interval = MIN (priv->interval * 2, priv->max_interval);
+
+        /* No point in scanning more often than any client wants updates */
+        if (priv->time_threshold != NULL)
+                threshold = gclue_min_uint_get_value (priv->time_threshold);
+        floor = MAX (priv->min_interval, threshold);
+        ceiling = MAX (priv->max_interval, threshold);
+        priv->interval = CLAMP (priv->interval, floor, ceiling);
+
+        g_debug ("Scan drift %.2f, speed %s%.1f m/s, time-threshold %u: %s, "
+                 "next scan in %u seconds",
+                 priv->drift,
+                 speed_known ? "" : "(stale) ",
+                 priv->speed,
+                 threshold,
+                 moving ? "moving" : (stationary ? "stationary" : "unsure"),
+                 priv->interval);
+
+        /* Drift is per-scan */
+        priv->drift = 0.0;
+
+        return priv->interval;
+}
+
+/**
+ * gclue_scan_scheduler_next_scan_is_full:
+ * @scheduler: a #GClueScanScheduler
+ *
+ * Decides whether the scan about to be started should sweep all channels, or
+ * can be restricted to the known ones. All channels are swept periodically,
+ * and each time while we are moving since the neighbourhood keeps changing.
+ *
+ * Returns: %TRUE if the next scan should sweep all channels.
+ **/
+gboolean
+gclue_scan_scheduler_next_scan_is_full (GClueScanScheduler *scheduler)
+{
+        GClueScanSchedulerPrivate *priv;
+
+        g_return_val_if_fail (GCLUE_IS_SCAN_SCHEDULER (scheduler), TRUE);
+        priv = scheduler->priv;
+
+        if (priv->moving || priv->scans_since_full >= FULL_SCAN_EVERY) {
+                priv->scans_since_full = 0;
+
+                return TRUE;
+        }
+        priv->scans_since_full++;
+
+        return FALSE;
+}
@@ -0,0 +1,72 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-scan-scheduler.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_SCAN_SCHEDULER_H
+#define GCLUE_SCAN_SCHEDULER_H
+
+#include <glib-object.h>
+#include "gclue-min-uint.h"
+
+G_BEGIN_DECLS
+
+#define GCLUE_TYPE_SCAN_SCHEDULER            (gclue_scan_scheduler_get_type())
+#define GCLUE_SCAN_SCHEDULER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_SCAN_SCHEDULER, GClueScanScheduler))
+#define GCLUE_SCAN_SCHEDULER_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_SCAN_SCHEDULER, GClueScanScheduler const))
+#define GCLUE_SCAN_SCHEDULER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GCLUE_TYPE_SCAN_SCHEDULER, GClueScanSchedulerClass))
+#define GCLUE_IS_SCAN_SCHEDULER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_SCAN_SCHEDULER))
+#define GCLUE_IS_SCAN_SCHEDULER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_SCAN_SCHEDULER))
+#define GCLUE_SCAN_SCHEDULER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_SCAN_SCHEDULER, GClueScanSchedulerClass))
+
+typedef struct _GClueScanScheduler        GClueScanScheduler;
+typedef struct _GClueScanSchedulerClass   GClueScanSchedulerClass;
+typedef struct _GClueScanSchedulerPrivate GClueScanSchedulerPrivate;
+
+struct _GClueScanScheduler
+{
+        GObject parent;
+
+        /*< private >*/
+        GClueScanSchedulerPrivate *priv;
+};
+
+struct _GClueScanSchedulerClass
+{
+        GObjectClass parent_class;
+};
+
+GType                gclue_scan_scheduler_get_type      (void) G_GNUC_CONST;
+
+GClueScanScheduler * gclue_scan_scheduler_new           (guint               min_interval,
+                                                         guint               max_interval,
+                                                         GClueMinUINT       *time_threshold);
+void                 gclue_scan_scheduler_reset         (GClueScanScheduler *scheduler);
+void                 gclue_scan_scheduler_report_drift  (GClueScanScheduler *scheduler,
+                                                         gdouble             drift);
+void                 gclue_scan_scheduler_report_speed  (GClueScanScheduler *scheduler,
+                                                         gdouble             speed);
+guint                gclue_scan_scheduler_next_interval (GClueScanScheduler *scheduler);
+gboolean             gclue_scan_scheduler_next_scan_is_full
+                                                        (GClueScanScheduler *scheduler);
+
+G_END_DECLS
+
+#endif /* GCLUE_SCAN_SCHEDULER_H */
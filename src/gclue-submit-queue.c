@@ -0,0 +1,702 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-submit-queue.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "gclue-submit-queue.h"
+#include "gclue-web-session.h"
+#include "gclue-config.h"
+
+/**
+ * SECTION:gclue-submit-queue
+ * @short_description: Batched submission of location data
+ *
+ * Collects the submission items of the web sources, and sends them to the
+ * submission service in batches, rather than one request for each GPS fix.
+ * Items are batched by submission URL and nickname, and kept as the JSON text
+ * they are sent as, so a batch is just joined together. An item seeing the
+ * same access points and cell towers as one already queued, at about the same
+ * spot, adds nothing and is left out.
+ *
+ * A batch is sent once it is big enough, and otherwise periodically. Items
+ * that could not be sent, e.g because we are offline, are kept until they can,
+ * and on disk if the 'submission-persist' configuration says so.
+ **/
+
+#define SPOOL_FILE_NAME   "submit-queue"
+#define SAVE_TIMEOUT      30           /* seconds */
+#define FLUSH_INTERVAL    (10 * 60)    /* seconds */
+#define FLUSH_SIZE        50           /* items */
+#define MAX_REQUEST_ITEMS 100          /* items per request */
+#define MAX_QUEUED_ITEMS  1000         /* items per batch */
+#define DEDUP_DISTANCE    50           /* meters */
+#define EARTH_RADIUS      6372795      /* meters */
+
+typedef struct
+{
+        char *json;
+        gdouble latitude;
+        gdouble longitude;
+        char *networks;
+} Item;
+
+typedef struct
+{
+        GClueSubmitQueue *queue;
+
+        char *url;
+        char *nick;        /* NULL if none */
+        GPtrArray *items;  /* Item, oldest first */
+
+        SoupMessage *query;
+        guint n_sending;   /* Items at the start of @items @query is sending */
+} Batch;
+
+struct _GClueSubmitQueuePrivate
+{
+        SoupSession *soup_session;
+        GPtrArray *batches; /* Batch */
+
+        gboolean persist;
+        char *path;
+        guint save_timeout;
+        guint flush_timeout;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueSubmitQueue,
+                         gclue_submit_queue,
+                         G_TYPE_OBJECT,
+                         G_ADD_PRIVATE (GClueSubmitQueue))
+
+static void
+send_batch (Batch *batch);
+
+static void
+item_free (Item *item)
+{
+        g_free (item->json);
+        g_free (item->networks);
+        g_slice_free (Item, item);
+}
+
+static void
+batch_free (Batch *batch)
+{
+        g_free (batch->url);
+        g_free (batch->nick);
+        g_ptr_array_unref (batch->items);
+        g_slice_free (Batch, batch);
+}
+
+static Batch *
+get_batch (GClueSubmitQueue *queue,
+           const char       *url,
+           const char       *nick)
+{
+        GPtrArray *batches = queue->priv->batches;
+        Batch *batch;
+        guint i;
+
+        for (i = 0; i < batches->len; i++) {
+                batch = g_ptr_array_index (batches, i);
+
+                if (g_strcmp0 (batch->url, url) == 0 &&
+                    g_strcmp0 (batch->nick, nick) == 0)
+                        return batch;
+        }
+
+        batch = g_slice_new0 (Batch);
+        batch->queue = queue;
+        batch->url = g_strdup (url);
+        batch->nick = g_strdup (nick);
+        batch->items = g_ptr_array_new_with_free_func
+                        ((GDestroyNotify) item_free);
+        g_ptr_array_add (batches, batch);
+
+        return batch;
+}
+
+static guint
+get_n_queued (GClueSubmitQueue *queue)
+{
+        guint i, n = 0;
+
+        for (i = 0; i < queue->priv->batches->len; i++) {
+                Batch *batch = g_ptr_array_index (queue->priv->batches, i);
+
+                n += batch->items->len;
+        }
+
+        return n;
+}
+
+static gboolean
+get_internet_available (void)
+{
+        GNetworkMonitor *monitor = g_network_monitor_get_default ();
+
+        return g_network_monitor_get_connectivity (monitor) ==
+               G_NETWORK_CONNECTIVITY_FULL;
+}
+
+
+static gboolean
+save_queue (GClueSubmitQueue *queue)
+{
+        GClueSubmitQueuePrivate *priv = queue->priv;
+        GKeyFile *key_file;
+        GError *error = NULL;
+        char *dir;
+        guint i;
+
+        priv->save_timeout = 0;
+
+        if (get_n_queued (queue) == 0) {
+                g_unlink (priv->path);
+
+                return FALSE;
+        }
+
+        key_file = g_key_file_new ();
+        for (i = 0; i < priv->batches->len; i++) {
+                Batch *batch = g_ptr_array_index (priv->batches, i);
+                const char **items, **networks;
+                gdouble *positions;
+                char group[16];
+                guint j;
+
+                if (batch->items->len == 0)
+                        continue;
+
+                g_snprintf (group, sizeof (group), "batch%u", i);
+                g_key_file_set_string (key_file, group, "url", batch->url);
+                if (batch->nick != NULL)
+                        g_key_file_set_string (key_file,
+                                               group,
+                                               "nick",
+                                               batch->nick);
+
+                items = g_new (const char *, batch->items->len);
+                networks = g_new (const char *, batch->items->len);
+                positions = g_new (gdouble, batch->items->len * 2);
+                for (j = 0; j < batch->items->len; j++) {
+                        Item *item = g_ptr_array_index (batch->items, j);
+
+                        items[j] = item->json;
+                        networks[j] = item->networks;
+                        positions[j * 2] = item->latitude;
+                        positions[j * 2 + 1] = item->longitude;
+                }
+                g_key_file_set_string_list (key_file,
+                                            group,
+                                            "items",
+                                            items,
+                                            batch->items->len);
+                g_key_file_set_string_list (key_file,
+                                            group,
+                                            "networks",
+                                            networks,
+                                            batch->items->len);
+                g_key_file_set_double_list (key_file,
+                                            group,
+                                            "positions",
+                                            positions,
+                                            batch->items->len * 2);
+                g_free (items);
+                g_free (networks);
+                g_free (positions);
+        }
+
+        /* The items tell where we have been, so only for our eyes */
+        dir = g_path_get_dirname (priv->path);
+        g_mkdir_with_parents (dir, 0700);
+        g_chmod (dir, 0700);
+        g_free (dir);
+
+        if (!g_key_file_save_to_file (key_file, priv->path, &error)) {
+                g_warning ("Failed to save submission queue to '%s': %s",
+                           priv->path,
+                           error->message);
+                g_error_free (error);
+        } else {
+                g_chmod (priv->path, 0600);
+        }
+        g_key_file_unref (key_file);
+
+        return FALSE;
+}
+
+static void
+schedule_save (GClueSubmitQueue *queue)
+{
+        if (!queue->priv->persist || queue->priv->save_timeout != 0)
+                return;
+
+        queue->priv->save_timeout =
+                g_timeout_add_seconds (SAVE_TIMEOUT,
+                                       (GSourceFunc) save_queue,
+                                       queue);
+}
+
+static void
+flush (GClueSubmitQueue *queue)
+{
+        guint i;
+
+        for (i = 0; i < queue->priv->batches->len; i++)
+                send_batch (g_ptr_array_index (queue->priv->batches, i));
+}
+
+static void
+schedule_flush (GClueSubmitQueue *queue);
+
+static gboolean
+on_flush_timeout (gpointer user_data)
+{
+        GClueSubmitQueue *queue = GCLUE_SUBMIT_QUEUE (user_data);
+
+        queue->priv->flush_timeout = 0;
+        flush (queue);
+
+        return FALSE;
+}
+
+static void
+schedule_flush (GClueSubmitQueue *queue)
+{
+        if (queue->priv->flush_timeout != 0)
+                return;
+
+        queue->priv->flush_timeout =
+                g_timeout_add_seconds (FLUSH_INTERVAL,
+                                       on_flush_timeout,
+                                       queue);
+}
+
+static void
+on_batch_sent (SoupSession *session,
+               SoupMessage *query,
+               gpointer     user_data)
+{
+        Batch *batch;
+        guint i;
+
+        if (query->status_code == SOUP_STATUS_CANCELLED)
+                return;
+
+        batch = user_data;
+        batch->query = NULL;
+
+        if (query->status_code == SOUP_STATUS_OK ||
+            query->status_code == SOUP_STATUS_NO_CONTENT) {
+                g_debug ("Successfully submitted %u items to '%s'",
+                         batch->n_sending,
+                         batch->url);
+        } else if (SOUP_STATUS_IS_CLIENT_ERROR (query->status_code) &&
+                   query->status_code != 429) {
+                /* Sending it again won't help */
+                g_warning ("Failed to submit location data to '%s': %s, "
+                           "dropping %u items",
+                           batch->url,
+                           query->reason_phrase,
+                           batch->n_sending);
+        } else {
+                g_warning ("Failed to submit location data to '%s': %s",
+                           batch->url,
+                           query->reason_phrase);
+                batch->n_sending = 0;
+                schedule_flush (batch->queue);
+
+                return;
+        }
+
+        g_ptr_array_remove_range (batch->items, 0, batch->n_sending);
+        batch->n_sending = 0;
+        schedule_save (batch->queue);
+
+        if (batch->items->len >= FLUSH_SIZE)
+                send_batch (batch);
+        else if (batch->items->len > 0)
+                schedule_flush (batch->queue);
+}
+
+static void
+send_batch (Batch *batch)
+{
+        GClueSubmitQueuePrivate *priv = batch->queue->priv;
+        GString *body;
+        guint n_items, i;
+        gsize body_len;
+
+        n_items = batch->items->len;
+        if (batch->query != NULL || n_items == 0)
+                return;
+
+        if (!get_internet_available ()) {
+                g_debug ("Offline, keeping %u items to submit to '%s'",
+                         n_items,
+                         batch->url);
+                schedule_flush (batch->queue);
+
+                return;
+        }
+
+        batch->query = soup_message_new ("POST", batch->url);
+        if (batch->query == NULL) {
+                g_warning ("Invalid submission URL '%s'", batch->url);
+
+                return;
+        }
+        if (batch->nick != NULL && batch->nick[0] != '\0')
+                soup_message_headers_append (batch->query->request_headers,
+                                             "X-Nickname",
+                                             batch->nick);
+
+        batch->n_sending = MIN (n_items, MAX_REQUEST_ITEMS);
+        body = g_string_new ("{\"items\":[");
+        for (i = 0; i < batch->n_sending; i++) {
+                Item *item = g_ptr_array_index (batch->items, i);
+
+                if (i > 0)
+                        g_string_append_c (body, ',');
+                g_string_append (body, item->json);
+        }
+        g_string_append (body, "]}");
+        body_len = body->len;
+        soup_message_set_request (batch->query,
+                                  "application/json",
+                                  SOUP_MEMORY_TAKE,
+                                  g_string_free (body, FALSE),
+                                  body_len);
+
+        g_debug ("Submitting %u items to '%s'", batch->n_sending, batch->url);
+        soup_session_queue_message (priv->soup_session,
+                                    batch->query,
+                                    on_batch_sent,
+                                    batch);
+}
+
+/* Equirectangular approximation, more than good enough for telling if two
+ * fixes are at about the same spot.
+ */
+static gdouble
+get_distance (gdouble lat_a,
+              gdouble lon_a,
+              gdouble lat_b,
+              gdouble lon_b)
+{
+        gdouble x, y;
+
+        x = (lon_b - lon_a) * cos ((lat_a + lat_b) / 2 * G_PI / 180);
+        y = lat_b - lat_a;
+
+        return sqrt (x * x + y * y) * G_PI / 180 * EARTH_RADIUS;
+}
+
+static gboolean
+is_duplicate (Batch *batch,
+              Item  *item)
+{
+        guint i;
+
+        for (i = 0; i < batch->items->len; i++) {
+                Item *queued = g_ptr_array_index (batch->items, i);
+
+                if (strcmp (item->networks, queued->networks) == 0 &&
+                    get_distance (item->latitude,
+                                  item->longitude,
+                                  queued->latitude,
+                                  queued->longitude) <= DEDUP_DISTANCE)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+/* Takes @item, returns %FALSE if it was left out */
+static gboolean
+add_item (Batch *batch,
+          Item  *item)
+{
+        if (is_duplicate (batch, item)) {
+                item_free (item);
+
+                return FALSE;
+        }
+
+        g_ptr_array_add (batch->items, item);
+
+        /* Make room by dropping the oldest, unless they're being sent */
+        if (batch->items->len > MAX_QUEUED_ITEMS &&
+            batch->items->len > batch->n_sending)
+                g_ptr_array_remove_index (batch->items, batch->n_sending);
+
+        return TRUE;
+}
+
+static void
+load_queue (GClueSubmitQueue *queue)
+{
+        GClueSubmitQueuePrivate *priv = queue->priv;
+        GKeyFile *key_file;
+        GError *error = NULL;
+        char **groups;
+        gsize num_groups = 0, i;
+
+        key_file = g_key_file_new ();
+        if (!g_key_file_load_from_file (key_file,
+                                        priv->path,
+                                        G_KEY_FILE_NONE,
+                                        &error)) {
+                g_debug ("Failed to load submission queue from '%s': %s",
+                         priv->path,
+                         error->message);
+                g_error_free (error);
+                g_key_file_unref (key_file);
+
+                return;
+        }
+
+        groups = g_key_file_get_groups (key_file, &num_groups);
+        for (i = 0; i < num_groups; i++) {
+                char *url, *nick, **items, **networks;
+                gdouble *positions;
+                gsize n_items = 0, n_networks = 0, n_positions = 0, j;
+
+                url = g_key_file_get_string (key_file, groups[i], "url", NULL);
+                nick = g_key_file_get_string (key_file,
+                                              groups[i],
+                                              "nick",
+                                              NULL);
+                items = g_key_file_get_string_list (key_file,
+                                                    groups[i],
+                                                    "items",
+                                                    &n_items,
+                                                    NULL);
+                networks = g_key_file_get_string_list (key_file,
+                                                       groups[i],
+                                                       "networks",
+                                                       &n_networks,
+                                                       NULL);
+                positions = g_key_file_get_double_list (key_file,
+                                                        groups[i],
+                                                        "positions",
+                                                        &n_positions,
+                                                        NULL);
+
+                if (url != NULL && items != NULL && networks != NULL &&
+                    positions != NULL && n_networks == n_items &&
+                    n_positions == n_items * 2) {
+                        Batch *batch = get_batch (queue, url, nick);
+
+                        for (j = 0; j < n_items; j++) {
+                                Item *item = g_slice_new (Item);
+
+                                item->json = g_strdup (items[j]);
+                                item->networks = g_strdup (networks[j]);
+                                item->latitude = positions[j * 2];
+                                item->longitude = positions[j * 2 + 1];
+                                add_item (batch, item);
+                        }
+                } else {
+                        g_debug ("Ignoring invalid submission queue entry '%s'",
+                                 groups[i]);
+                }
+
+                g_free (url);
+                g_free (nick);
+                g_strfreev (items);
+                g_strfreev (networks);
+                g_free (positions);
+        }
+
+        g_debug ("Loaded %u items to submit from '%s'",
+                 get_n_queued (queue),
+                 priv->path);
+
+        g_strfreev (groups);
+        g_key_file_unref (key_file);
+}
+
+static void
+gclue_submit_queue_finalize (GObject *object)
+{
+        GClueSubmitQueuePrivate *priv = GCLUE_SUBMIT_QUEUE (object)->priv;
+        guint i;
+
+        /* Including the items being sent, as we don't know if they made it */
+        if (priv->save_timeout != 0) {
+                g_source_remove (priv->save_timeout);
+                save_queue (GCLUE_SUBMIT_QUEUE (object));
+        }
+        if (priv->flush_timeout != 0) {
+                g_source_remove (priv->flush_timeout);
+                priv->flush_timeout = 0;
+        }
+
+        for (i = 0; i < priv->batches->len; i++) {
+                Batch *batch = g_ptr_array_index (priv->batches, i);
+
+                if (batch->query != NULL)
+                        soup_session_cancel_message (priv->soup_session,
+                                                     batch->query,
+                                                     SOUP_STATUS_CANCELLED);
+        }
+        g_clear_object (&priv->soup_session);
+        g_clear_pointer (&priv->batches, g_ptr_array_unref);
+        g_clear_pointer (&priv->path, g_free);
+
+        G_OBJECT_CLASS (gclue_submit_queue_parent_class)->finalize (object);
+}
+
+static void
+gclue_submit_queue_class_init (GClueSubmitQueueClass *klass)
+{
+        GObjectClass *object_class;
+
+        object_class = G_OBJECT_CLASS (klass);
+        object_class->finalize = gclue_submit_queue_finalize;
+}
+
+static void
+gclue_submit_queue_init (GClueSubmitQueue *queue)
+{
+        GClueConfig *config = gclue_config_get_singleton ();
+        GClueSubmitQueuePrivate *priv;
+
+        queue->priv = G_TYPE_INSTANCE_GET_PRIVATE (queue,
+                                                   GCLUE_TYPE_SUBMIT_QUEUE,
+                                                   GClueSubmitQueuePrivate);
+        priv = queue->priv;
+
+        priv->soup_session = gclue_web_session_get_default ();
+        priv->batches = g_ptr_array_new_with_free_func
+                        ((GDestroyNotify) batch_free);
+        priv->persist = gclue_config_get_wifi_submit_persist (config);
+        priv->path = g_build_filename (g_get_user_cache_dir (),
+                                       "geoclue",
+                                       SPOOL_FILE_NAME,
+                                       NULL);
+
+        if (!priv->persist)
+                return;
+
+        load_queue (queue);
+        if (get_n_queued (queue) > 0)
+                schedule_flush (queue);
+}
+
+static void
+on_queue_destroyed (gpointer data,
+                    GObject *where_the_object_was)
+{
+        GClueSubmitQueue **queue = (GClueSubmitQueue **) data;
+
+        *queue = NULL;
+}
+
+/**
+ * gclue_submit_queue_get_singleton:
+ *
+ * Get the #GClueSubmitQueue singleton.
+ *
+ * Returns: (transfer full): a new ref to #GClueSubmitQueue. Use
+ * g_object_unref() when done.
+ **/
+GClueSubmitQueue *
+gclue_submit_queue_get_singleton (void)
+{
+        static GClueSubmitQueue *queue = NULL;
+
+        if (queue == NULL) {
+                queue = g_object_new (GCLUE_TYPE_SUBMIT_QUEUE, NULL);
+                g_object_weak_ref (G_OBJECT (queue),
+                                   on_queue_destroyed,
+                                   &queue);
+        } else
+                g_object_ref (queue);
+
+        return queue;
+}
+
+/**
+ * gclue_submission_free:
+ * @submission: a #GClueSubmission
+ *
+ * Frees @submission and the data it holds.
+ **/
+void
+gclue_submission_free (GClueSubmission *submission)
+{
+        g_free (submission->url);
+        g_free (submission->nick);
+        g_free (submission->item);
+        g_free (submission->networks);
+        g_slice_free (GClueSubmission, submission);
+}
+
+/**
+ * gclue_submit_queue_add:
+ * @queue: a #GClueSubmitQueue
+ * @submission: (transfer full): The location data to submit
+ *
+ * Queues the item of @submission, to be sent along with others to the URL of
+ * @submission later.
+ **/
+void
+gclue_submit_queue_add (GClueSubmitQueue *queue,
+                        GClueSubmission  *submission)
+{
+        Batch *batch;
+        Item *item;
+
+        g_return_if_fail (GCLUE_IS_SUBMIT_QUEUE (queue));
+        g_return_if_fail (submission != NULL);
+
+        batch = get_batch (queue, submission->url, submission->nick);
+
+        item = g_slice_new (Item);
+        item->json = submission->item;
+        item->networks = submission->networks;
+        item->latitude = submission->latitude;
+        item->longitude = submission->longitude;
+        submission->item = NULL;
+        submission->networks = NULL;
+        gclue_submission_free (submission);
+
+        if (!add_item (batch, item)) {
+                g_debug ("Not submitting data for the same spot and networks "
+                         "again");
+
+                return;
+        }
+        schedule_save (queue);
+
+        if (batch->items->len - batch->n_sending >= FLUSH_SIZE)
+                send_batch (batch);
+        else
+                schedule_flush (queue);
+}
@@ -0,0 +1,77 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-submit-queue.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_SUBMIT_QUEUE_H
+#define GCLUE_SUBMIT_QUEUE_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Location data for a submission service, to be queued */
+typedef struct _GClueSubmission GClueSubmission;
+
+struct _GClueSubmission {
+        char    *url;
+        char    *nick;      /* NULL if none */
+        char    *item;      /* JSON object, as it goes in the 'items' array */
+        gdouble  latitude;  /* Where @item was observed */
+        gdouble  longitude;
+        char    *networks;  /* Sorted keys of the networks seen */
+};
+
+void               gclue_submission_free            (GClueSubmission  *submission);
+
+#define GCLUE_TYPE_SUBMIT_QUEUE            (gclue_submit_queue_get_type())
+#define GCLUE_SUBMIT_QUEUE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_SUBMIT_QUEUE, GClueSubmitQueue))
+#define GCLUE_SUBMIT_QUEUE_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_SUBMIT_QUEUE, GClueSubmitQueue const))
+#define GCLUE_SUBMIT_QUEUE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GCLUE_TYPE_SUBMIT_QUEUE, GClueSubmitQueueClass))
+#define GCLUE_IS_SUBMIT_QUEUE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_SUBMIT_QUEUE))
+#define GCLUE_IS_SUBMIT_QUEUE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_SUBMIT_QUEUE))
+#define GCLUE_SUBMIT_QUEUE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_SUBMIT_QUEUE, GClueSubmitQueueClass))
+
+typedef struct _GClueSubmitQueue        GClueSubmitQueue;
+typedef struct _GClueSubmitQueueClass   GClueSubmitQueueClass;
+typedef struct _GClueSubmitQueuePrivate GClueSubmitQueuePrivate;
+
+struct _GClueSubmitQueue
+{
+        GObject parent;
+
+        /*< private >*/
+        GClueSubmitQueuePrivate *priv;
+};
+
+struct _GClueSubmitQueueClass
+{
+        GObjectClass parent_class;
+};
+
+GType              gclue_submit_queue_get_type      (void) G_GNUC_CONST;
+
+GClueSubmitQueue * gclue_submit_queue_get_singleton (void);
+void               gclue_submit_queue_add           (GClueSubmitQueue *queue,
+                                                     GClueSubmission  *submission);
+
+G_END_DECLS
+
+#endif /* GCLUE_SUBMIT_QUEUE_H */
@@ -0,0 +1,489 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-web-cache.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gclue-web-cache.h"
+#include "gclue-config.h"
+
+/**
+ * SECTION:gclue-web-cache
+ * @short_description: Cache of geolocation service responses
+ *
+ * Remembers the responses of the geolocation services for a while, so that a
+ * query identical to a recent one, e.g because the network came back after a
+ * short outage, is answered locally. Queries are identified by a hash of
+ * their method, URL and body. Our query writers emit object members in a fixed
+ * order, so the body is hashed as is. The cache is shared by all web sources
+ * and can be kept on disk so it survives restarts.
+ *
+ * Queries without any observations in their body, i.e GeoIP ones, are never
+ * cached: the service locates them from the address they come from, so the
+ * same query gets a different answer once the network changed.
+ **/
+
+#define CACHE_FILE_NAME    "web-cache"
+#define CACHE_SAVE_TIMEOUT 30 /* seconds */
+
+typedef struct
+{
+        char *key;
+        char *response;
+
+        guint64 timestamp; /* When we got the response */
+        guint64 last_used;
+} CacheEntry;
+
+struct _GClueWebCachePrivate
+{
+        GHashTable *entries; /* key => CacheEntry */
+
+        guint max_entries;
+        guint ttl;
+        gboolean persist;
+
+        char *path;
+        guint save_timeout;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueWebCache,
+                         gclue_web_cache,
+                         G_TYPE_OBJECT,
+                         G_ADD_PRIVATE (GClueWebCache))
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+        g_free (entry->key);
+        g_free (entry->response);
+        g_slice_free (CacheEntry, entry);
+}
+
+static guint64
+get_now (void)
+{
+        return g_get_real_time () / G_USEC_PER_SEC;
+}
+
+static gboolean
+is_expired (GClueWebCache *cache,
+            CacheEntry    *entry,
+            guint64        now)
+{
+        /* Also if the clock went backwards */
+        return entry->timestamp > now ||
+               entry->timestamp + cache->priv->ttl < now;
+}
+
+static void
+evict_least_recently_used (GClueWebCache *cache)
+{
+        GHashTableIter iter;
+        CacheEntry *entry, *oldest = NULL;
+
+        g_hash_table_iter_init (&iter, cache->priv->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+                if (oldest == NULL || entry->last_used < oldest->last_used)
+                        oldest = entry;
+        }
+
+        if (oldest != NULL)
+                g_hash_table_remove (cache->priv->entries, oldest->key);
+}
+
+static void
+insert_entry (GClueWebCache *cache,
+              CacheEntry    *entry)
+{
+        GClueWebCachePrivate *priv = cache->priv;
+
+        g_hash_table_remove (priv->entries, entry->key);
+        while (g_hash_table_size (priv->entries) > 0 &&
+               g_hash_table_size (priv->entries) >= priv->max_entries)
+                evict_least_recently_used (cache);
+
+        g_hash_table_insert (priv->entries, entry->key, entry);
+}
+
+static gboolean
+save_cache (GClueWebCache *cache)
+{
+        GClueWebCachePrivate *priv = cache->priv;
+        GKeyFile *key_file;
+        GHashTableIter iter;
+        CacheEntry *entry;
+        GError *error = NULL;
+        guint64 now = get_now ();
+        char *dir;
+
+        priv->save_timeout = 0;
+
+        key_file = g_key_file_new ();
+        g_hash_table_iter_init (&iter, priv->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+                if (is_expired (cache, entry, now))
+                        continue;
+
+                g_key_file_set_string (key_file,
+                                       entry->key,
+                                       "response",
+                                       entry->response);
+                g_key_file_set_uint64 (key_file,
+                                       entry->key,
+                                       "timestamp",
+                                       entry->timestamp);
+                g_key_file_set_uint64 (key_file,
+                                       entry->key,
+                                       "last-used",
+                                       entry->last_used);
+        }
+
+        /* The responses tell where we have been, so only for our eyes */
+        dir = g_path_get_dirname (priv->path);
+        g_mkdir_with_parents (dir, 0700);
+        g_chmod (dir, 0700);
+        g_free (dir);
+
+        if (!g_key_file_save_to_file (key_file, priv->path, &error)) {
+                g_warning ("Failed to save web cache to '%s': %s",
+                           priv->path,
+                           error->message);
+                g_error_free (error);
+        } else {
+                g_chmod (priv->path, 0600);
+        }
+        g_key_file_unref (key_file);
+
+        return FALSE;
+}
+
+static void
+schedule_save (GClueWebCache *cache)
+{
+        if (!cache->priv->persist || cache->priv->save_timeout != 0)
+                return;
+
+        cache->priv->save_timeout =
+                g_timeout_add_seconds (CACHE_SAVE_TIMEOUT,
+                                       (GSourceFunc) save_cache,
+                                       cache);
+}
+
+static void
+load_cache (GClueWebCache *cache)
+{
+        GClueWebCachePrivate *priv = cache->priv;
+        GKeyFile *key_file;
+        GError *error = NULL;
+        char **groups;
+        gsize num_groups = 0, i;
+        guint64 now = get_now ();
+
+        key_file = g_key_file_new ();
+        if (!g_key_file_load_from_file (key_file,
+                                        priv->path,
+                                        G_KEY_FILE_NONE,
+                                        &error)) {
+                g_debug ("Failed to load web cache from '%s': %s",
+                         priv->path,
+                         error->message);
+                g_error_free (error);
+                g_key_file_unref (key_file);
+
+                return;
+        }
+
+        groups = g_key_file_get_groups (key_file, &num_groups);
+        for (i = 0; i < num_groups; i++) {
+                CacheEntry *entry;
+
+                entry = g_slice_new0 (CacheEntry);
+                entry->key = g_strdup (groups[i]);
+                entry->response = g_key_file_get_string (key_file,
+                                                         groups[i],
+                                                         "response",
+                                                         &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->timestamp = g_key_file_get_uint64 (key_file,
+                                                          groups[i],
+                                                          "timestamp",
+                                                          &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->last_used = g_key_file_get_uint64 (key_file,
+                                                          groups[i],
+                                                          "last-used",
+                                                          NULL);
+
+                if (is_expired (cache, entry, now)) {
+                        cache_entry_free (entry);
+
+                        continue;
+                }
+
+                insert_entry (cache, entry);
+
+                continue;
+invalid_entry:
+                g_debug ("Ignoring invalid web cache entry '%s': %s",
+                         groups[i],
+                         error->message);
+                g_clear_error (&error);
+                cache_entry_free (entry);
+        }
+
+        g_debug ("Loaded %u entries from web cache",
+                 g_hash_table_size (priv->entries));
+
+        g_strfreev (groups);
+        g_key_file_unref (key_file);
+}
+
+static void
+gclue_web_cache_finalize (GObject *object)
+{
+        GClueWebCachePrivate *priv = GCLUE_WEB_CACHE (object)->priv;
+
+        if (priv->save_timeout != 0) {
+                g_source_remove (priv->save_timeout);
+                save_cache (GCLUE_WEB_CACHE (object));
+        }
+
+        g_clear_pointer (&priv->entries, g_hash_table_unref);
+        g_clear_pointer (&priv->path, g_free);
+
+        G_OBJECT_CLASS (gclue_web_cache_parent_class)->finalize (object);
+}
+
+static void
+gclue_web_cache_class_init (GClueWebCacheClass *klass)
+{
+        GObjectClass *object_class;
+
+        object_class = G_OBJECT_CLASS (klass);
+        object_class->finalize = gclue_web_cache_finalize;
+}
+
+static void
+gclue_web_cache_init (GClueWebCache *cache)
+{
+        GClueConfig *config = gclue_config_get_singleton ();
+        GClueWebCachePrivate *priv;
+
+        cache->priv = G_TYPE_INSTANCE_GET_PRIVATE (cache,
+                                                   GCLUE_TYPE_WEB_CACHE,
+                                                   GClueWebCachePrivate);
+        priv = cache->priv;
+
+        priv->entries = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               NULL,
+                                               (GDestroyNotify) cache_entry_free);
+        priv->max_entries = gclue_config_get_web_cache_size (config);
+        priv->ttl = gclue_config_get_web_cache_ttl (config);
+        priv->persist = gclue_config_get_web_cache_persist (config);
+        priv->path = g_build_filename (g_get_user_cache_dir (),
+                                       "geoclue",
+                                       CACHE_FILE_NAME,
+                                       NULL);
+
+        if (priv->max_entries == 0 || priv->ttl == 0)
+                priv->persist = FALSE;
+        if (priv->persist)
+                load_cache (cache);
+}
+
+static void
+on_cache_destroyed (gpointer data,
+                    GObject *where_the_object_was)
+{
+        GClueWebCache **cache = (GClueWebCache **) data;
+
+        *cache = NULL;
+}
+
+/**
+ * gclue_web_cache_get_singleton:
+ *
+ * Get the #GClueWebCache singleton.
+ *
+ * Returns: (transfer full): a new ref to #GClueWebCache. Use g_object_unref()
+ * when done.
+ **/
+GClueWebCache *
+gclue_web_cache_get_singleton (void)
+{
+        static GClueWebCache *cache = NULL;
+
+        if (cache == NULL) {
+                cache = g_object_new (GCLUE_TYPE_WEB_CACHE, NULL);
+                g_object_weak_ref (G_OBJECT (cache),
+                                   on_cache_destroyed,
+                                   &cache);
+        } else
+                g_object_ref (cache);
+
+        return cache;
+}
+
+/* No body at all or an empty JSON object, so it's located by address */
+static gboolean
+is_geoip_query (SoupBuffer *body)
+{
+        gsize i;
+
+        for (i = 0; i < body->length; i++) {
+                char c = body->data[i];
+
+                if (c != '{' && c != '}' && !g_ascii_isspace (c))
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+/**
+ * gclue_web_cache_get_key:
+ * @cache: a #GClueWebCache
+ * @query: A query about to be sent
+ *
+ * Computes the key identifying @query in @cache.
+ *
+ * Returns: (transfer full): The key, or %NULL if the cache is disabled or
+ * @query is a GeoIP one. Free with g_free().
+ **/
+char *
+gclue_web_cache_get_key (GClueWebCache *cache,
+                         SoupMessage   *query)
+{
+        GChecksum *checksum;
+        SoupBuffer *body;
+        char *uri;
+        char *key;
+
+        g_return_val_if_fail (GCLUE_IS_WEB_CACHE (cache), NULL);
+
+        if (cache->priv->max_entries == 0 || cache->priv->ttl == 0)
+                return NULL;
+
+        /* Flattened once, the message sends that very buffer */
+        body = soup_message_body_flatten (query->request_body);
+        if (is_geoip_query (body)) {
+                soup_buffer_free (body);
+
+                return NULL;
+        }
+
+        checksum = g_checksum_new (G_CHECKSUM_SHA256);
+        g_checksum_update (checksum, (const guchar *) query->method, -1);
+        g_checksum_update (checksum, (const guchar *) "\n", 1);
+        uri = soup_uri_to_string (soup_message_get_uri (query), FALSE);
+        g_checksum_update (checksum, (const guchar *) uri, -1);
+        g_checksum_update (checksum, (const guchar *) "\n", 1);
+        g_free (uri);
+
+        g_checksum_update (checksum,
+                           (const guchar *) body->data,
+                           body->length);
+        soup_buffer_free (body);
+
+        key = g_strdup (g_checksum_get_string (checksum));
+        g_checksum_free (checksum);
+
+        return key;
+}
+
+/**
+ * gclue_web_cache_lookup:
+ * @cache: a #GClueWebCache
+ * @key: (nullable): Key of a query, from gclue_web_cache_get_key()
+ *
+ * Looks for a response to the query identified by @key that is not older than
+ * the 'response-cache-ttl' configuration.
+ *
+ * Returns: (transfer full): The response, or %NULL if there was none. Free
+ * with g_free().
+ **/
+char *
+gclue_web_cache_lookup (GClueWebCache *cache,
+                        const char    *key)
+{
+        CacheEntry *entry;
+        guint64 now = get_now ();
+
+        g_return_val_if_fail (GCLUE_IS_WEB_CACHE (cache), NULL);
+
+        if (key == NULL)
+                return NULL;
+
+        entry = g_hash_table_lookup (cache->priv->entries, key);
+        if (entry == NULL)
+                return NULL;
+
+        if (is_expired (cache, entry, now)) {
+                g_hash_table_remove (cache->priv->entries, key);
+                schedule_save (cache);
+
+                return NULL;
+        }
+
+        g_debug ("Web cache hit, response is %" G_GUINT64_FORMAT " seconds old",
+                 now - entry->timestamp);
+        entry->last_used = now;
+        schedule_save (cache);
+
+        return g_strdup (entry->response);
+}
+
+/**
+ * gclue_web_cache_add:
+ * @cache: a #GClueWebCache
+ * @key: (nullable): Key of a query, from gclue_web_cache_get_key()
+ * @response: The response of the service to the query
+ *
+ * Remembers @response as the answer to the query identified by @key, evicting
+ * the least recently used response if the cache is full.
+ **/
+void
+gclue_web_cache_add (GClueWebCache *cache,
+                     const char    *key,
+                     const char    *response)
+{
+        CacheEntry *entry;
+
+        g_return_if_fail (GCLUE_IS_WEB_CACHE (cache));
+        g_return_if_fail (response != NULL);
+
+        if (key == NULL)
+                return;
+
+        entry = g_slice_new0 (CacheEntry);
+        entry->key = g_strdup (key);
+        entry->response = g_strdup (response);
+        entry->timestamp = get_now ();
+        entry->last_used = entry->timestamp;
+        insert_entry (cache, entry);
+
+        schedule_save (cache);
+}
@@ -0,0 +1,69 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-web-cache.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_WEB_CACHE_H
+#define GCLUE_WEB_CACHE_H
+
+#include <glib-object.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+#define GCLUE_TYPE_WEB_CACHE            (gclue_web_cache_get_type())
+#define GCLUE_WEB_CACHE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WEB_CACHE, GClueWebCache))
+#define GCLUE_WEB_CACHE_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WEB_CACHE, GClueWebCache const))
+#define GCLUE_WEB_CACHE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GCLUE_TYPE_WEB_CACHE, GClueWebCacheClass))
+#define GCLUE_IS_WEB_CACHE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_WEB_CACHE))
+#define GCLUE_IS_WEB_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_WEB_CACHE))
+#define GCLUE_WEB_CACHE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_WEB_CACHE, GClueWebCacheClass))
+
+typedef struct _GClueWebCache        GClueWebCache;
+typedef struct _GClueWebCacheClass   GClueWebCacheClass;
+typedef struct _GClueWebCachePrivate GClueWebCachePrivate;
+
+struct _GClueWebCache
+{
+        GObject parent;
+
+        /*< private >*/
+        GClueWebCachePrivate *priv;
+};
+
+struct _GClueWebCacheClass
+{
+        GObjectClass parent_class;
+};
+
+GType           gclue_web_cache_get_type      (void) G_GNUC_CONST;
+
+GClueWebCache * gclue_web_cache_get_singleton (void);
+char *          gclue_web_cache_get_key       (GClueWebCache *cache,
+                                               SoupMessage   *query);
+char *          gclue_web_cache_lookup        (GClueWebCache *cache,
+                                               const char    *key);
+void            gclue_web_cache_add           (GClueWebCache *cache,
+                                               const char    *key,
+                                               const char    *response);
+
+G_END_DECLS
+
+#endif /* GCLUE_WEB_CACHE_H */
@@ -0,0 +1,144 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-web-session.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "gclue-web-session.h"
+
+/**
+ * SECTION:gclue-web-session
+ * @short_description: HTTP session shared by all web requests
+ *
+ * All web sources and the submission queue send their requests through the
+ * same #SoupSession, so they share its pool of persistent connections. Our
+ * requests are small and mostly go to the same few hosts, so setting up a
+ * connection, and the TLS handshake in particular, is most of their latency.
+ *
+ * The number of new connections and TLS handshakes, and how many requests
+ * reused a connection instead, is logged as debug output.
+ **/
+
+#define MAX_CONNS          8
+#define MAX_CONNS_PER_HOST 2
+#define IDLE_TIMEOUT       120 /* seconds */
+
+static SoupSession *session = NULL;
+
+static guint n_requests = 0;
+static guint n_connections = 0;
+static guint n_handshakes = 0;
+
+static void
+log_stats (SoupMessage *query,
+           const char  *event)
+{
+        SoupURI *uri = soup_message_get_uri (query);
+
+        g_debug ("%s to %s:%u: %u connections and %u TLS handshakes for "
+                 "%u requests, %.0f%% of requests reused a connection",
+                 event,
+                 soup_uri_get_host (uri),
+                 soup_uri_get_port (uri),
+                 n_connections,
+                 n_handshakes,
+                 n_requests,
+                 100.0 * (n_requests - MIN (n_connections, n_requests)) /
+                 MAX (n_requests, 1));
+}
+
+static void
+on_network_event (SoupMessage       *query,
+                  GSocketClientEvent event,
+                  GIOStream         *connection,
+                  gpointer           user_data)
+{
+        switch (event) {
+        case G_SOCKET_CLIENT_CONNECTED:
+                n_connections++;
+                log_stats (query, "New connection");
+                break;
+
+        case G_SOCKET_CLIENT_TLS_HANDSHAKED:
+                n_handshakes++;
+                log_stats (query, "TLS handshake");
+                break;
+
+        default:
+                break;
+        }
+}
+
+static void
+on_request_queued (SoupSession *soup_session,
+                   SoupMessage *query,
+                   gpointer     user_data)
+{
+        n_requests++;
+
+        /* Only emitted for the request that made a new connection */
+        g_signal_connect (query,
+                          "network-event",
+                          G_CALLBACK (on_network_event),
+                          NULL);
+}
+
+static void
+on_session_destroyed (gpointer data,
+                      GObject *where_the_object_was)
+{
+        session = NULL;
+}
+
+/**
+ * gclue_web_session_get_default:
+ *
+ * Get the #SoupSession to send all web requests through.
+ *
+ * Returns: (transfer full): a new ref to the shared #SoupSession. Use
+ * g_object_unref() when done. Cancel pending requests with
+ * soup_session_cancel_message() rather than aborting the session, as that
+ * would cancel those of the other users too.
+ **/
+SoupSession *
+gclue_web_session_get_default (void)
+{
+        if (session != NULL)
+                return g_object_ref (session);
+
+        session = soup_session_new_with_options
+                        (SOUP_SESSION_REMOVE_FEATURE_BY_TYPE,
+                         SOUP_TYPE_PROXY_RESOLVER_DEFAULT,
+                         SOUP_SESSION_MAX_CONNS,
+                         MAX_CONNS,
+                         SOUP_SESSION_MAX_CONNS_PER_HOST,
+                         MAX_CONNS_PER_HOST,
+                         SOUP_SESSION_IDLE_TIMEOUT,
+                         IDLE_TIMEOUT,
+                         NULL);
+        g_signal_connect (session,
+                          "request-queued",
+                          G_CALLBACK (on_request_queued),
+                          NULL);
+        g_object_weak_ref (G_OBJECT (session), on_session_destroyed, NULL);
+
+        return session;
+}
@@ -25,6 +25,10 @@
 #include <json-glib/json-glib.h>
 #include <string.h>
 #include "gclue-web-source.h"
+#include "gclue-web-cache.h"
+#include "gclue-submit-queue.h"
+#include "gclue-web-session.h"
+#include "gclue-config.h"
 #include "gclue-error.h"
 #include "gclue-location.h"
 
@@ -34,21 +38,60 @@
  * @include: gclue-glib/gclue-web-source.h
  *
  * Baseclass for all sources that solely use a web resource for geolocation.
+ *
+ * Failed queries are retried with jittered exponential backoff. Each service
+ * endpoint also has a circuit breaker, shared by all sources using it: after
+ * a few failures in a row it opens and no queries are sent to the endpoint
+ * for a while, after which a single query probes whether it is back.
+ *
+ * Each query is sent to all the configured backends at once. The first answer
+ * accurate enough wins, or else the most accurate one once the others answered
+ * or missed their deadline.
+ *
+ * A refresh while a query is in flight is not dropped: a query for the newer
+ * state follows as soon as the one in flight is done.
+ *
+ * Location data for the submission service is not sent right away, but added
+ * to the #GClueSubmitQueue, which sends it in batches.
  **/
 
+/* Per source, between retries of a failed query */
+#define RETRY_MIN_DELAY        5    /* seconds */
+#define RETRY_MAX_DELAY        300  /* seconds */
+/* Per endpoint, shared by all sources */
+#define BREAKER_THRESHOLD      5    /* consecutive failures */
+#define BREAKER_MIN_COOLDOWN   30   /* seconds */
+#define BREAKER_MAX_COOLDOWN   1800 /* seconds */
+#define BREAKER_PROBE_TIMEOUT  60   /* seconds */
+
 static gboolean
 gclue_web_source_start (GClueLocationSource *source);
 
 struct _GClueWebSourcePrivate {
         SoupSession *soup_session;
 
-        SoupMessage *query;
+        GPtrArray *attempts; /* Attempt, the queries in flight */
+        char *query_key; /* Of the query in @cache */
+        GClueWebCache *cache;
+
+        /* Best answer so far, not accurate enough to win right away */
+        SoupMessage *best_answer;
+        GClueLocation *best_location;
+        struct _Endpoint *best_endpoint;
+        gboolean retriable_failure;
+
+        guint generation;         /* Of the latest query */
+        gboolean refresh_pending; /* Refreshed while the query was in flight */
+        GClueSubmitQueue *submit_queue;
 
         gulong network_changed_id;
         gulong connectivity_changed_id;
 
         guint64 last_submitted;
 
+        guint retry_timeout;
+        guint n_retries;
+
         gboolean internet_available;
 };
 
@@ -57,50 +100,582 @@ G_DEFINE_ABSTRACT_TYPE_WITH_CODE (GClueWebSource,
                                   GCLUE_TYPE_LOCATION_SOURCE,
                                   G_ADD_PRIVATE (GClueWebSource))
 
+typedef enum {
+        BREAKER_CLOSED,
+        BREAKER_OPEN,
+        BREAKER_HALF_OPEN,
+} BreakerState;
+
+typedef struct _Endpoint {
+        char *name;
+        BreakerState state;
+        guint n_failures; /* In a row */
+        guint n_trips;    /* Times opened without closing in between */
+        gint64 open_until;
+        gint64 probe_until;
+
+        /* For tuning the list of backends */
+        guint n_queries;
+        guint n_answers;
+        guint n_wins;
+        gint64 total_latency; /* Of the answers, in microseconds */
+} Endpoint;
+
+typedef struct {
+        GClueWebSource *web;
+        const GClueWebBackend *backend; /* NULL if none are configured */
+        SoupMessage *query;
+        guint generation;
+        Endpoint *endpoint;
+        gint64 sent_at;
+        guint deadline_timeout;
+} Attempt;
+
+static const char *breaker_states[] = { "closed", "open", "half-open" };
+
+/* Between sources and across their lifetimes, so this lives as long as we do */
+static GHashTable *endpoints = NULL;
+
+static Endpoint *
+get_endpoint (SoupMessage *query)
+{
+        SoupURI *uri = soup_message_get_uri (query);
+        Endpoint *endpoint;
+        char *name;
+
+        if (endpoints == NULL)
+                endpoints = g_hash_table_new (g_str_hash, g_str_equal);
+
+        /* Leave out the query, it's mostly the API key */
+        name = g_strdup_printf ("%s://%s:%u%s",
+                                soup_uri_get_scheme (uri),
+                                soup_uri_get_host (uri),
+                                soup_uri_get_port (uri),
+                                soup_uri_get_path (uri));
+        endpoint = g_hash_table_lookup (endpoints, name);
+        if (endpoint != NULL) {
+                g_free (name);
+
+                return endpoint;
+        }
+
+        endpoint = g_slice_new0 (Endpoint);
+        endpoint->name = name;
+        g_hash_table_insert (endpoints, endpoint->name, endpoint);
+
+        return endpoint;
+}
+
 static void
-query_callback (SoupSession *session,
-                SoupMessage *query,
-                gpointer     user_data)
+set_breaker_state (Endpoint    *endpoint,
+                   BreakerState state)
 {
-        GClueWebSource *web;
-        GError *error = NULL;
-        char *contents;
-        char *str;
-        GClueLocation *location;
-        SoupURI *uri;
+        if (endpoint->state == state)
+                return;
 
-        if (query->status_code == SOUP_STATUS_CANCELLED)
+        g_debug ("Circuit breaker of '%s' %s -> %s",
+                 endpoint->name,
+                 breaker_states[endpoint->state],
+                 breaker_states[state]);
+        endpoint->state = state;
+}
+
+/* Spreads retries of all devices out, so they don't come back in a burst */
+static guint
+add_jitter (guint delay)
+{
+        return g_random_int_range (delay / 2, delay + 1);
+}
+
+/* Returns 0 if a query may be sent to @endpoint, or else the number of
+ * seconds to wait before asking again.
+ */
+static guint
+check_breaker (Endpoint *endpoint)
+{
+        gint64 now = g_get_monotonic_time ();
+
+        switch (endpoint->state) {
+        case BREAKER_CLOSED:
+                return 0;
+
+        case BREAKER_OPEN:
+                if (now < endpoint->open_until)
+                        return (endpoint->open_until - now) /
+                               G_USEC_PER_SEC + 1;
+
+                set_breaker_state (endpoint, BREAKER_HALF_OPEN);
+                break;
+
+        case BREAKER_HALF_OPEN:
+                /* Only a single query finds out if it's back */
+                if (now < endpoint->probe_until)
+                        return (endpoint->probe_until - now) /
+                               G_USEC_PER_SEC + 1;
+                break;
+        }
+
+        endpoint->probe_until = now + BREAKER_PROBE_TIMEOUT * G_USEC_PER_SEC;
+
+        return 0;
+}
+
+static void
+report_to_breaker (Endpoint *endpoint,
+                   gboolean  success)
+{
+        guint cooldown;
+
+        if (success) {
+                endpoint->n_failures = 0;
+                endpoint->n_trips = 0;
+                endpoint->probe_until = 0;
+                set_breaker_state (endpoint, BREAKER_CLOSED);
+
+                return;
+        }
+
+        endpoint->n_failures++;
+        endpoint->probe_until = 0;
+        if (endpoint->state != BREAKER_HALF_OPEN &&
+            endpoint->n_failures < BREAKER_THRESHOLD)
                 return;
 
-        web = GCLUE_WEB_SOURCE (user_data);
-        web->priv->query = NULL;
+        /* Longer each time the probe fails */
+        cooldown = BREAKER_MIN_COOLDOWN << MIN (endpoint->n_trips, 10);
+        cooldown = add_jitter (MIN (cooldown, BREAKER_MAX_COOLDOWN));
+        endpoint->n_trips++;
+        endpoint->open_until = g_get_monotonic_time () +
+                               (gint64) cooldown * G_USEC_PER_SEC;
+        set_breaker_state (endpoint, BREAKER_OPEN);
+        g_debug ("Not querying '%s' for %u seconds, after %u failures",
+                 endpoint->name,
+                 cooldown,
+                 endpoint->n_failures);
+}
 
-        if (query->status_code != SOUP_STATUS_OK) {
-                g_warning ("Failed to query location: %s", query->reason_phrase);
-		return;
-	}
+/* Network trouble or an overloaded service, rather than a bad query */
+static gboolean
+is_retriable (guint status_code)
+{
+        return SOUP_STATUS_IS_TRANSPORT_ERROR (status_code) ||
+               SOUP_STATUS_IS_SERVER_ERROR (status_code) ||
+               status_code == 429; /* Too Many Requests */
+}
+
+static gboolean
+on_retry_timeout (gpointer user_data)
+{
+        GClueWebSource *web = GCLUE_WEB_SOURCE (user_data);
+
+        web->priv->retry_timeout = 0;
+        if (gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (web)))
+                gclue_web_source_refresh (web);
+
+        return FALSE;
+}
+
+static void
+schedule_retry (GClueWebSource *web,
+                guint           min_delay)
+{
+        GClueWebSourcePrivate *priv = web->priv;
+        guint delay;
+
+        delay = RETRY_MIN_DELAY << MIN (priv->n_retries, 10);
+        delay = add_jitter (MIN (delay, RETRY_MAX_DELAY));
+        delay = MAX (delay, min_delay);
+        priv->n_retries++;
+
+        if (priv->retry_timeout != 0)
+                g_source_remove (priv->retry_timeout);
+        priv->retry_timeout = g_timeout_add_seconds (delay,
+                                                     on_retry_timeout,
+                                                     web);
+        g_debug ("Retrying %s query in %u seconds",
+                 G_OBJECT_TYPE_NAME (web),
+                 delay);
+}
+
+static GClueLocation *
+parse_response (GClueWebSource *web,
+                const char     *contents)
+{
+        GError *error = NULL;
+        GClueLocation *location;
 
-        contents = g_strndup (query->response_body->data, query->response_body->length);
-        uri = soup_message_get_uri (query);
-        str = soup_uri_to_string (uri, FALSE);
-        g_debug ("Got following response from '%s':\n%s",
-                 str,
-                 contents);
-        g_free (str);
         location = GCLUE_WEB_SOURCE_GET_CLASS (web)->parse_response (web,
                                                                      contents,
                                                                      &error);
-        g_free (contents);
         if (error != NULL) {
                 g_warning ("Failed to parse following response: %s\n%s",
                            error->message,
                            contents);
-                return;
+                g_error_free (error);
+
+                return NULL;
         }
 
+        return location;
+}
+
+/* Of the answer that won, or the one from the cache */
+static void
+use_location (GClueWebSource *web,
+              GClueLocation  *location)
+{
+        GClueWebSourceClass *klass = GCLUE_WEB_SOURCE_GET_CLASS (web);
+
+        if (klass->accept_location != NULL)
+                klass->accept_location (web, location);
+
         gclue_location_source_set_location (GCLUE_LOCATION_SOURCE (web),
                                             location);
-        g_object_unref (location);
+}
+
+static const char *
+get_attempt_name (Attempt *attempt)
+{
+        if (attempt->backend != NULL)
+                return attempt->backend->name;
+
+        return attempt->endpoint->name;
+}
+
+static void
+attempt_free (Attempt *attempt)
+{
+        if (attempt->deadline_timeout != 0)
+                g_source_remove (attempt->deadline_timeout);
+
+        /* Still in flight */
+        if (attempt->query != NULL)
+                soup_session_cancel_message (attempt->web->priv->soup_session,
+                                             attempt->query,
+                                             SOUP_STATUS_CANCELLED);
+
+        g_slice_free (Attempt, attempt);
+}
+
+static void
+log_endpoint_stats (Endpoint *endpoint)
+{
+        g_debug ("'%s' won %u of %u queries, answered %u in %" G_GINT64_FORMAT
+                 " ms on average",
+                 endpoint->name,
+                 endpoint->n_wins,
+                 endpoint->n_queries,
+                 endpoint->n_answers,
+                 endpoint->total_latency / MAX (endpoint->n_answers, 1) / 1000);
+}
+
+static void
+follow_up (GClueWebSource *web)
+{
+        if (!web->priv->refresh_pending)
+                return;
+
+        web->priv->refresh_pending = FALSE;
+        g_debug ("Following up with a newer %s query",
+                 G_OBJECT_TYPE_NAME (web));
+        gclue_web_source_refresh (web);
+}
+
+static void
+finish_round (GClueWebSource *web,
+              Endpoint       *winner,
+              SoupMessage    *answer,
+              GClueLocation  *location)
+{
+        GClueWebSourcePrivate *priv = web->priv;
+        char *key;
+
+        key = priv->query_key;
+        priv->query_key = NULL;
+
+        /* Stops the queries still in flight, their answers are too late */
+        g_ptr_array_set_size (priv->attempts, 0);
+        priv->retriable_failure = FALSE;
+        priv->n_retries = 0;
+
+        winner->n_wins++;
+        log_endpoint_stats (winner);
+
+        use_location (web, location);
+        gclue_web_cache_add (priv->cache, key, answer->response_body->data);
+        g_free (key);
+
+        g_clear_object (&priv->best_answer);
+        g_clear_object (&priv->best_location);
+        priv->best_endpoint = NULL;
+
+        follow_up (web);
+}
+
+/* Once all queries answered, failed or missed their deadline */
+static void
+end_round (GClueWebSource *web)
+{
+        GClueWebSourcePrivate *priv = web->priv;
+
+        if (priv->best_answer != NULL) {
+                finish_round (web,
+                              priv->best_endpoint,
+                              priv->best_answer,
+                              priv->best_location);
+
+                return;
+        }
+
+        g_clear_pointer (&priv->query_key, g_free);
+        if (priv->retriable_failure) {
+                priv->retriable_failure = FALSE;
+                schedule_retry (web, 0);
+        }
+
+        follow_up (web);
+}
+
+static void
+remove_attempt (Attempt *attempt)
+{
+        GClueWebSource *web = attempt->web;
+
+        g_ptr_array_remove (web->priv->attempts, attempt);
+        if (web->priv->attempts->len == 0)
+                end_round (web);
+}
+
+static void
+query_callback (SoupSession *session,
+                SoupMessage *query,
+                gpointer     user_data)
+{
+        Attempt *attempt = user_data;
+        GClueWebSourcePrivate *priv;
+        Endpoint *endpoint;
+        GClueLocation *location;
+        const char *contents;
+        gdouble accuracy;
+        gint64 latency;
+
+        if (query->status_code == SOUP_STATUS_CANCELLED)
+                return;
+
+        priv = attempt->web->priv;
+        endpoint = attempt->endpoint;
+        attempt->query = NULL;
+
+        /* Never let a late answer overwrite the one to a newer query */
+        if (attempt->generation != priv->generation) {
+                g_debug ("Ignoring answer from '%s' to an outdated query",
+                         get_attempt_name (attempt));
+                remove_attempt (attempt);
+
+                return;
+        }
+
+        /* A service refusing the query is still up */
+        report_to_breaker (endpoint, !is_retriable (query->status_code));
+
+        if (query->status_code != SOUP_STATUS_OK) {
+                g_warning ("Failed to query location from '%s': %s",
+                           get_attempt_name (attempt),
+                           query->reason_phrase);
+                if (is_retriable (query->status_code))
+                        priv->retriable_failure = TRUE;
+
+                remove_attempt (attempt);
+
+                return;
+        }
+
+        /* The body is flattened, and so NUL-terminated, once complete */
+        contents = query->response_body->data;
+        g_debug ("Got following response from '%s':\n%s",
+                 get_attempt_name (attempt),
+                 contents);
+
+        /* All backends speak the dialect of the subclass so far */
+        location = parse_response (attempt->web, contents);
+        if (location == NULL) {
+                remove_attempt (attempt);
+
+                return;
+        }
+        accuracy = gclue_location_get_accuracy (location);
+
+        latency = g_get_monotonic_time () - attempt->sent_at;
+        endpoint->n_answers++;
+        endpoint->total_latency += latency;
+        g_debug ("'%s' answered in %" G_GINT64_FORMAT " ms, accurate to "
+                 "%.0f meters",
+                 get_attempt_name (attempt),
+                 latency / 1000,
+                 accuracy);
+
+        if (accuracy <= gclue_config_get_web_accept_accuracy
+                                (gclue_config_get_singleton ())) {
+                finish_round (attempt->web, endpoint, query, location);
+                g_object_unref (location);
+
+                return;
+        }
+
+        /* Keeping the message keeps its body, no need to copy it */
+        if (priv->best_location == NULL ||
+            accuracy < gclue_location_get_accuracy (priv->best_location)) {
+                g_clear_object (&priv->best_answer);
+                g_clear_object (&priv->best_location);
+                priv->best_answer = g_object_ref (query);
+                priv->best_location = location;
+                priv->best_endpoint = endpoint;
+        } else {
+                g_object_unref (location);
+        }
+        remove_attempt (attempt);
+}
+
+static gboolean
+on_deadline (gpointer user_data)
+{
+        Attempt *attempt = user_data;
+
+        attempt->deadline_timeout = 0;
+        g_debug ("'%s' missed its deadline of %u seconds",
+                 get_attempt_name (attempt),
+                 attempt->backend->deadline);
+
+        /* Too slow to be of use is as good as down */
+        report_to_breaker (attempt->endpoint, FALSE);
+        attempt->web->priv->retriable_failure = TRUE;
+        remove_attempt (attempt);
+
+        return FALSE;
+}
+
+static void
+copy_header (const char *name,
+             const char *value,
+             gpointer    user_data)
+{
+        soup_message_headers_append (user_data, name, value);
+}
+
+/* Same request, to the URL of @backend */
+static SoupMessage *
+create_backend_query (SoupMessage           *query,
+                      const GClueWebBackend *backend)
+{
+        SoupMessage *ret;
+        SoupBuffer *body;
+
+        /* All subclasses speak this one so far */
+        if (backend->dialect != GCLUE_WEB_DIALECT_MOZILLA)
+                return NULL;
+
+        ret = soup_message_new (query->method, backend->url);
+        if (ret == NULL)
+                return NULL;
+
+        soup_message_headers_foreach (query->request_headers,
+                                      copy_header,
+                                      ret->request_headers);
+        body = soup_message_body_flatten (query->request_body);
+        soup_message_body_append_buffer (ret->request_body, body);
+        soup_buffer_free (body);
+
+        return ret;
+}
+
+static void
+add_attempt (GClueWebSource        *web,
+             const GClueWebBackend *backend,
+             SoupMessage           *query)
+{
+        Attempt *attempt;
+
+        attempt = g_slice_new0 (Attempt);
+        attempt->web = web;
+        attempt->backend = backend;
+        attempt->query = query;
+        attempt->generation = web->priv->generation;
+        attempt->endpoint = get_endpoint (query);
+        attempt->sent_at = g_get_monotonic_time ();
+        attempt->endpoint->n_queries++;
+        if (backend != NULL)
+                attempt->deadline_timeout =
+                        g_timeout_add_seconds (backend->deadline,
+                                               on_deadline,
+                                               attempt);
+        g_ptr_array_add (web->priv->attempts, attempt);
+
+        soup_session_queue_message (web->priv->soup_session,
+                                    query,
+                                    query_callback,
+                                    attempt);
+}
+
+/* Sends @query to all backends, or as is if there are none */
+static void
+send_query (GClueWebSource *web,
+            SoupMessage    *query)
+{
+        const GClueWebBackend *backends;
+        guint num_backends, i;
+        guint wait, min_wait = 0;
+
+        backends = gclue_config_get_web_backends (gclue_config_get_singleton (),
+                                                  &num_backends);
+        web->priv->generation++;
+
+        for (i = 0; i < MAX (num_backends, 1); i++) {
+                const GClueWebBackend *backend = NULL;
+                SoupMessage *backend_query;
+
+                if (num_backends > 0) {
+                        backend = &backends[i];
+                        backend_query = create_backend_query (query, backend);
+                        if (backend_query == NULL) {
+                                g_warning ("Failed to create query for '%s'",
+                                           backend->name);
+                                continue;
+                        }
+                } else {
+                        backend_query = g_object_ref (query);
+                }
+
+                /* Don't add to the load of a service that is struggling
+                 * already.
+                 */
+                wait = check_breaker (get_endpoint (backend_query));
+                if (wait > 0) {
+                        g_debug ("Circuit breaker of '%s' is open, not "
+                                 "querying it",
+                                 get_endpoint (backend_query)->name);
+                        min_wait = (min_wait == 0) ? wait : MIN (min_wait,
+                                                                 wait);
+                        g_object_unref (backend_query);
+
+                        continue;
+                }
+
+                add_attempt (web, backend, backend_query);
+        }
+
+        if (web->priv->attempts->len == 0) {
+                g_clear_pointer (&web->priv->query_key, g_free);
+                if (min_wait > 0)
+                        schedule_retry (web, min_wait);
+
+                return;
+        }
+
+        /* This one supersedes any pending retry */
+        if (web->priv->retry_timeout != 0) {
+                g_source_remove (web->priv->retry_timeout);
+                web->priv->retry_timeout = 0;
+        }
 }
 
 static gboolean
@@ -140,13 +715,19 @@ on_network_changed (GNetworkMonitor *monitor G_GNUC_UNUSED,
 {
         GClueWebSource *web = GCLUE_WEB_SOURCE (user_data);
         GError *error = NULL;
+        SoupMessage *query;
+        GClueLocation *location;
+        char *response;
         gboolean last_available = web->priv->internet_available;
 
         web->priv->internet_available = get_internet_available ();
-        if (last_available == web->priv->internet_available)
-                return; /* We already reacted to network change */
 
+        /* Sources might be able to offer some accuracy without network too,
+         * so this needs refreshing on each call, not just on actual changes.
+         */
         refresh_accuracy_level (web);
+        if (last_available == web->priv->internet_available)
+                return; /* We already reacted to network change */
 
         if (!gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (user_data)))
                 return;
@@ -157,23 +738,46 @@ on_network_changed (GNetworkMonitor *monitor G_GNUC_UNUSED,
         }
         g_debug ("Network available");
 
-        if (web->priv->query != NULL)
-                return;
+        if (web->priv->attempts->len > 0) {
+                g_debug ("%s query in flight, following up once it's done",
+                         G_OBJECT_TYPE_NAME (web));
+                web->priv->refresh_pending = TRUE;
 
-        web->priv->query = GCLUE_WEB_SOURCE_GET_CLASS (web)->create_query
-                                        (web,
-                                         &error);
+                return;
+        }
 
-        if (web->priv->query == NULL) {
-                g_warning ("Failed to create query: %s", error->message);
-                g_error_free (error);
+        /* Without an error, there is just no need for a query right now */
+        query = GCLUE_WEB_SOURCE_GET_CLASS (web)->create_query (web, &error);
+        if (query == NULL) {
+                if (error != NULL) {
+                        g_warning ("Failed to create query: %s",
+                                   error->message);
+                        g_error_free (error);
+                }
                 return;
         }
 
-        soup_session_queue_message (web->priv->soup_session,
-                                    web->priv->query,
-                                    query_callback,
-                                    web);
+        /* Answer a repeated query, e.g after a network flap, from cache */
+        g_free (web->priv->query_key);
+        web->priv->query_key = gclue_web_cache_get_key (web->priv->cache,
+                                                        query);
+        response = gclue_web_cache_lookup (web->priv->cache,
+                                           web->priv->query_key);
+        if (response != NULL) {
+                g_debug ("Using cached response for %s",
+                         G_OBJECT_TYPE_NAME (web));
+                g_clear_pointer (&web->priv->query_key, g_free);
+                web->priv->generation++;
+                location = parse_response (web, response);
+                if (location != NULL) {
+                        use_location (web, location);
+                        g_object_unref (location);
+                }
+                g_free (response);
+        } else {
+                send_query (web, query);
+        }
+        g_object_unref (query);
 }
 
 static void
@@ -201,15 +805,19 @@ gclue_web_source_finalize (GObject *gsource)
                 priv->connectivity_changed_id = 0;
         }
 
-        if (priv->query != NULL) {
-                g_debug ("Cancelling query");
-                soup_session_cancel_message (priv->soup_session,
-                                             priv->query,
-                                             SOUP_STATUS_CANCELLED);
-                priv->query = NULL;
+        if (priv->retry_timeout != 0) {
+                g_source_remove (priv->retry_timeout);
+                priv->retry_timeout = 0;
         }
 
+        g_clear_pointer (&priv->attempts, g_ptr_array_unref);
+        g_clear_pointer (&priv->query_key, g_free);
+        g_clear_object (&priv->best_answer);
+        g_clear_object (&priv->best_location);
+
         g_clear_object (&priv->soup_session);
+        g_clear_object (&priv->cache);
+        g_clear_object (&priv->submit_queue);
 
         G_OBJECT_CLASS (gclue_web_source_parent_class)->finalize (gsource);
 }
@@ -222,10 +830,10 @@ gclue_web_source_constructed (GObject *object)
 
         G_OBJECT_CLASS (gclue_web_source_parent_class)->constructed (object);
 
-        priv->soup_session = soup_session_new_with_options
-                        (SOUP_SESSION_REMOVE_FEATURE_BY_TYPE,
-                         SOUP_TYPE_PROXY_RESOLVER_DEFAULT,
-                         NULL);
+        priv->soup_session = gclue_web_session_get_default ();
+        priv->attempts = g_ptr_array_new_with_free_func
+                        ((GDestroyNotify) attempt_free);
+        priv->cache = gclue_web_cache_get_singleton ();
 
         monitor = g_network_monitor_get_default ();
         priv->network_changed_id =
@@ -292,26 +900,6 @@ gclue_web_source_start (GClueLocationSource *source)
         return TRUE;
 }
 
-static void
-submit_query_callback (SoupSession *session,
-                       SoupMessage *query,
-                       gpointer     user_data)
-{
-        SoupURI *uri;
-
-        uri = soup_message_get_uri (query);
-        if (query->status_code != SOUP_STATUS_OK &&
-            query->status_code != SOUP_STATUS_NO_CONTENT) {
-                g_warning ("Failed to submit location data to '%s': %s",
-                           soup_uri_to_string (uri, FALSE),
-                           query->reason_phrase);
-		return;
-	}
-
-        g_debug ("Successfully submitted location data to '%s'",
-                 soup_uri_to_string (uri, FALSE));
-}
-
 #define SUBMISSION_ACCURACY_THRESHOLD 100
 #define SUBMISSION_TIME_THRESHOLD     60  /* seconds */
 
@@ -323,7 +911,7 @@ on_submit_source_location_notify (GObject    *source_object,
         GClueLocationSource *source = GCLUE_LOCATION_SOURCE (source_object);
         GClueWebSource *web = GCLUE_WEB_SOURCE (user_data);
         GClueLocation *location;
-        SoupMessage *query;
+        GClueSubmission *submission;
         GError *error = NULL;
 
         location = gclue_location_source_get_location (source);
@@ -336,16 +924,22 @@ on_submit_source_location_notify (GObject    *source_object,
 
         web->priv->last_submitted = gclue_location_get_timestamp (location);
 
-        if (!get_internet_available ())
+        /* Learning doesn't need the network */
+        if (GCLUE_WEB_SOURCE_GET_CLASS (web)->learn_location != NULL)
+                GCLUE_WEB_SOURCE_GET_CLASS (web)->learn_location (web,
+                                                                  location);
+
+        /* Neither does queueing the submission */
+        if (GCLUE_WEB_SOURCE_GET_CLASS (web)->create_submission == NULL)
                 return;
 
-        query = GCLUE_WEB_SOURCE_GET_CLASS (web)->create_submit_query
+        submission = GCLUE_WEB_SOURCE_GET_CLASS (web)->create_submission
                                         (web,
                                          location,
                                          &error);
-        if (query == NULL) {
+        if (submission == NULL) {
                 if (error != NULL) {
-                        g_warning ("Failed to create submission query: %s",
+                        g_warning ("Failed to create submission: %s",
                                    error->message);
                         g_error_free (error);
                 }
@@ -353,10 +947,9 @@ on_submit_source_location_notify (GObject    *source_object,
                 return;
         }
 
-        soup_session_queue_message (web->priv->soup_session,
-                                    query,
-                                    submit_query_callback,
-                                    web);
+        if (web->priv->submit_queue == NULL)
+                web->priv->submit_queue = gclue_submit_queue_get_singleton ();
+        gclue_submit_queue_add (web->priv->submit_queue, submission);
 }
 
 /**
@@ -364,7 +957,8 @@ on_submit_source_location_notify (GObject    *source_object,
  * @source: a #GClueWebSource
  *
  * Use this function to provide a location source to @source that is used
- * for submitting location data to resource being used by @source. This will be
+ * for submitting location data to resource being used by @source, and for
+ * learning from it if @source supports that. This will be
  * a #GClueModemGPS but we don't assume that here, in case we later add a
  * non-modem GPS source and would like to pass that instead.
  **/
@@ -373,7 +967,8 @@ gclue_web_source_set_submit_source (GClueWebSource      *web,
                                     GClueLocationSource *submit_source)
 {
         /* Not implemented by subclass */
-        if (GCLUE_WEB_SOURCE_GET_CLASS (web)->create_submit_query == NULL)
+        if (GCLUE_WEB_SOURCE_GET_CLASS (web)->create_submission == NULL &&
+            GCLUE_WEB_SOURCE_GET_CLASS (web)->learn_location == NULL)
                 return;
 
         g_signal_connect_object (G_OBJECT (submit_source),
@@ -26,6 +26,7 @@
 #include <gio/gio.h>
 #include "gclue-location-source.h"
 #include <libsoup/soup.h>
+#include "gclue-submit-queue.h"
 
 G_BEGIN_DECLS
 
@@ -64,7 +65,7 @@ struct _GClueWebSourceClass {
 
         SoupMessage *     (*create_query)        (GClueWebSource *source,
                                                   GError        **error);
-        SoupMessage *     (*create_submit_query) (GClueWebSource  *source,
+        GClueSubmission * (*create_submission)   (GClueWebSource  *source,
                                                   GClueLocation   *location,
                                                   GError         **error);
         GClueLocation * (*parse_response)        (GClueWebSource *source,
@@ -73,6 +74,10 @@ struct _GClueWebSourceClass {
         GClueAccuracyLevel (*get_available_accuracy_level)
                                                  (GClueWebSource *source,
                                                   gboolean        network_available);
+        void              (*learn_location)      (GClueWebSource  *source,
+                                                  GClueLocation   *location);
+        void              (*accept_location)     (GClueWebSource  *source,
+                                                  GClueLocation   *location);
 };
 
 void gclue_web_source_refresh           (GClueWebSource      *source);
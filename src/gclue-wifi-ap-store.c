@@ -0,0 +1,606 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-ap-store.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <math.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gclue-wifi-ap-store.h"
+#include "gclue-config.h"
+
+/**
+ * SECTION:gclue-wifi-ap-store
+ * @short_description: Locally learned WiFi access point positions
+ *
+ * Each time we get an accurate (GPS) location, the access points visible at
+ * that moment are added to the store as observations: every access point keeps
+ * a running, signal-weighted mean of the positions it was seen from and an
+ * estimate of its range. A set of visible access points can then be located
+ * entirely on-device, by a weighted centroid of the positions of the known
+ * ones. The store can be kept on disk so it survives restarts.
+ **/
+
+#define STORE_FILE_NAME    "wifi-aps"
+#define STORE_SAVE_TIMEOUT 60                     /* seconds */
+/* Forget about access points we haven't seen in a long time */
+#define STORE_MAX_AGE      (90 * 24 * 60 * 60)   /* seconds */
+
+/* Range of an access point is never assumed to be smaller than this */
+#define MIN_AP_RANGE       30.0   /* meters */
+/* Seen further away than this from its estimated position, an access point
+ * must have been moved, so we start over with it.
+ */
+#define MAX_AP_RANGE       1000.0 /* meters */
+/* Cap on accumulated observation weight, so the estimate can still follow
+ * new observations after a while.
+ */
+#define MAX_AP_WEIGHT      1000.0
+/* Number of known access points needed for a fix */
+#define MIN_KNOWN_APS      2
+
+#define EARTH_RADIUS       6372795.0 /* meters */
+
+typedef struct
+{
+        guint64 bssid;
+
+        gdouble latitude;
+        gdouble longitude;
+        gdouble range;  /* meters */
+        gdouble weight; /* Sum of observation weights */
+
+        guint64 last_seen;
+} APEntry;
+
+struct _GClueWifiAPStorePrivate
+{
+        GHashTable *entries; /* BSSID => APEntry */
+
+        guint max_entries;
+        gboolean persist;
+
+        char *path;
+        guint save_timeout;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueWifiAPStore,
+                         gclue_wifi_ap_store,
+                         G_TYPE_OBJECT,
+                         G_ADD_PRIVATE (GClueWifiAPStore))
+
+static void
+ap_entry_free (APEntry *entry)
+{
+        g_slice_free (APEntry, entry);
+}
+
+static guint64
+get_now (void)
+{
+        return g_get_real_time () / G_USEC_PER_SEC;
+}
+
+/* Same weighting as for the change detection in GClueWifi */
+static gdouble
+get_signal_weight (const GClueWifiBSS *bss)
+{
+        return CLAMP (bss->signal + 100, 1, 70);
+}
+
+/* Equirectangular approximation, more than good enough at the scale of WiFi
+ * ranges.
+ */
+static gdouble
+get_distance (gdouble lat_a,
+              gdouble lon_a,
+              gdouble lat_b,
+              gdouble lon_b)
+{
+        gdouble x, y;
+
+        x = (lon_b - lon_a) * cos ((lat_a + lat_b) / 2 * G_PI / 180);
+        y = lat_b - lat_a;
+
+        return sqrt (x * x + y * y) * G_PI / 180 * EARTH_RADIUS;
+}
+
+static void
+evict_least_recently_seen (GClueWifiAPStore *store)
+{
+        GHashTableIter iter;
+        APEntry *entry, *oldest = NULL;
+
+        g_hash_table_iter_init (&iter, store->priv->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+                if (oldest == NULL || entry->last_seen < oldest->last_seen)
+                        oldest = entry;
+        }
+
+        if (oldest != NULL)
+                g_hash_table_remove (store->priv->entries, &oldest->bssid);
+}
+
+static void
+insert_entry (GClueWifiAPStore *store,
+              APEntry          *entry)
+{
+        GClueWifiAPStorePrivate *priv = store->priv;
+
+        while (g_hash_table_size (priv->entries) > 0 &&
+               g_hash_table_size (priv->entries) >= priv->max_entries)
+                evict_least_recently_seen (store);
+
+        g_hash_table_insert (priv->entries, &entry->bssid, entry);
+}
+
+static gboolean
+save_store (GClueWifiAPStore *store)
+{
+        GClueWifiAPStorePrivate *priv = store->priv;
+        GKeyFile *key_file;
+        GHashTableIter iter;
+        APEntry *entry;
+        GError *error = NULL;
+        char *dir;
+
+        priv->save_timeout = 0;
+
+        key_file = g_key_file_new ();
+        g_hash_table_iter_init (&iter, priv->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+                char group[13];
+
+                g_snprintf (group,
+                            sizeof (group),
+                            "%012" G_GINT64_MODIFIER "x",
+                            entry->bssid);
+
+                g_key_file_set_double (key_file,
+                                       group,
+                                       "latitude",
+                                       entry->latitude);
+                g_key_file_set_double (key_file,
+                                       group,
+                                       "longitude",
+                                       entry->longitude);
+                g_key_file_set_double (key_file,
+                                       group,
+                                       "range",
+                                       entry->range);
+                g_key_file_set_double (key_file,
+                                       group,
+                                       "weight",
+                                       entry->weight);
+                g_key_file_set_uint64 (key_file,
+                                       group,
+                                       "last-seen",
+                                       entry->last_seen);
+        }
+
+        /* It tells where we have been, so only for our eyes */
+        dir = g_path_get_dirname (priv->path);
+        g_mkdir_with_parents (dir, 0700);
+        g_chmod (dir, 0700);
+        g_free (dir);
+
+        if (!g_key_file_save_to_file (key_file, priv->path, &error)) {
+                g_warning ("Failed to save WiFi AP store to '%s': %s",
+                           priv->path,
+                           error->message);
+                g_error_free (error);
+        } else {
+                g_chmod (priv->path, 0600);
+        }
+        g_key_file_unref (key_file);
+
+        return FALSE;
+}
+
+static void
+schedule_save (GClueWifiAPStore *store)
+{
+        if (!store->priv->persist || store->priv->save_timeout != 0)
+                return;
+
+        store->priv->save_timeout =
+                g_timeout_add_seconds (STORE_SAVE_TIMEOUT,
+                                       (GSourceFunc) save_store,
+                                       store);
+}
+
+static void
+load_store (GClueWifiAPStore *store)
+{
+        GClueWifiAPStorePrivate *priv = store->priv;
+        GKeyFile *key_file;
+        GError *error = NULL;
+        char **groups;
+        gsize num_groups = 0, i;
+        guint64 now = get_now ();
+
+        key_file = g_key_file_new ();
+        if (!g_key_file_load_from_file (key_file,
+                                        priv->path,
+                                        G_KEY_FILE_NONE,
+                                        &error)) {
+                g_debug ("Failed to load WiFi AP store from '%s': %s",
+                         priv->path,
+                         error->message);
+                g_error_free (error);
+                g_key_file_unref (key_file);
+
+                return;
+        }
+
+        groups = g_key_file_get_groups (key_file, &num_groups);
+        for (i = 0; i < num_groups; i++) {
+                APEntry *entry;
+
+                entry = g_slice_new0 (APEntry);
+                entry->bssid = g_ascii_strtoull (groups[i], NULL, 16);
+
+                entry->latitude = g_key_file_get_double (key_file,
+                                                         groups[i],
+                                                         "latitude",
+                                                         &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->longitude = g_key_file_get_double (key_file,
+                                                          groups[i],
+                                                          "longitude",
+                                                          &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->range = g_key_file_get_double (key_file,
+                                                      groups[i],
+                                                      "range",
+                                                      &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->weight = g_key_file_get_double (key_file,
+                                                       groups[i],
+                                                       "weight",
+                                                       &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->last_seen = g_key_file_get_uint64 (key_file,
+                                                          groups[i],
+                                                          "last-seen",
+                                                          NULL);
+
+                if (entry->last_seen + STORE_MAX_AGE < now) {
+                        ap_entry_free (entry);
+
+                        continue;
+                }
+
+                entry->range = MAX (entry->range, MIN_AP_RANGE);
+                entry->weight = CLAMP (entry->weight, 1.0, MAX_AP_WEIGHT);
+                insert_entry (store, entry);
+
+                continue;
+invalid_entry:
+                g_debug ("Ignoring invalid WiFi AP store entry '%s': %s",
+                         groups[i],
+                         error->message);
+                g_clear_error (&error);
+                ap_entry_free (entry);
+        }
+
+        g_debug ("Loaded %u access points from WiFi AP store",
+                 g_hash_table_size (priv->entries));
+
+        g_strfreev (groups);
+        g_key_file_unref (key_file);
+}
+
+static void
+gclue_wifi_ap_store_finalize (GObject *object)
+{
+        GClueWifiAPStorePrivate *priv = GCLUE_WIFI_AP_STORE (object)->priv;
+
+        if (priv->save_timeout != 0) {
+                g_source_remove (priv->save_timeout);
+                save_store (GCLUE_WIFI_AP_STORE (object));
+        }
+
+        g_clear_pointer (&priv->entries, g_hash_table_unref);
+        g_clear_pointer (&priv->path, g_free);
+
+        G_OBJECT_CLASS (gclue_wifi_ap_store_parent_class)->finalize (object);
+}
+
+static void
+gclue_wifi_ap_store_class_init (GClueWifiAPStoreClass *klass)
+{
+        GObjectClass *object_class;
+
+        object_class = G_OBJECT_CLASS (klass);
+        object_class->finalize = gclue_wifi_ap_store_finalize;
+}
+
+static void
+gclue_wifi_ap_store_init (GClueWifiAPStore *store)
+{
+        GClueConfig *config = gclue_config_get_singleton ();
+        GClueWifiAPStorePrivate *priv;
+
+        store->priv = G_TYPE_INSTANCE_GET_PRIVATE (store,
+                                                   GCLUE_TYPE_WIFI_AP_STORE,
+                                                   GClueWifiAPStorePrivate);
+        priv = store->priv;
+
+        priv->entries = g_hash_table_new_full (g_int64_hash,
+                                               g_int64_equal,
+                                               NULL,
+                                               (GDestroyNotify) ap_entry_free);
+        priv->max_entries = gclue_config_get_wifi_ap_store_size (config);
+        priv->persist = gclue_config_get_wifi_ap_store_persist (config);
+        priv->path = g_build_filename (g_get_user_cache_dir (),
+                                       "geoclue",
+                                       STORE_FILE_NAME,
+                                       NULL);
+
+        if (priv->max_entries == 0)
+                priv->persist = FALSE;
+        if (priv->persist)
+                load_store (store);
+}
+
+static void
+on_store_destroyed (gpointer data,
+                    GObject *where_the_object_was)
+{
+        GClueWifiAPStore **store = (GClueWifiAPStore **) data;
+
+        *store = NULL;
+}
+
+/**
+ * gclue_wifi_ap_store_get_singleton:
+ *
+ * Get the #GClueWifiAPStore singleton.
+ *
+ * Returns: (transfer full): a new ref to #GClueWifiAPStore. Use
+ * g_object_unref() when done.
+ **/
+GClueWifiAPStore *
+gclue_wifi_ap_store_get_singleton (void)
+{
+        static GClueWifiAPStore *store = NULL;
+
+        if (store == NULL) {
+                store = g_object_new (GCLUE_TYPE_WIFI_AP_STORE, NULL);
+                g_object_weak_ref (G_OBJECT (store),
+                                   on_store_destroyed,
+                                   &store);
+        } else
+                g_object_ref (store);
+
+        return store;
+}
+
+/**
+ * gclue_wifi_ap_store_learn:
+ * @store: a #GClueWifiAPStore
+ * @scan: Snapshot of the access points visible at @location
+ * @location: An accurate location of the device, e.g from GPS
+ *
+ * Updates the position estimates of the access points in @scan with the
+ * observation that they were visible from @location.
+ **/
+void
+gclue_wifi_ap_store_learn (GClueWifiAPStore    *store,
+                           const GClueWifiScan *scan,
+                           GClueLocation       *location)
+{
+        GClueWifiAPStorePrivate *priv;
+        gdouble latitude, longitude, accuracy;
+        guint64 now;
+        guint n_new = 0, n_updated = 0, i;
+
+        g_return_if_fail (GCLUE_IS_WIFI_AP_STORE (store));
+        g_return_if_fail (GCLUE_IS_LOCATION (location));
+        priv = store->priv;
+
+        if (scan->n_bss == 0 || priv->max_entries == 0)
+                return;
+
+        latitude = gclue_location_get_latitude (location);
+        longitude = gclue_location_get_longitude (location);
+        accuracy = gclue_location_get_accuracy (location);
+        now = get_now ();
+
+        for (i = 0; i < scan->n_bss; i++) {
+                const GClueWifiBSS *bss = &scan->bss[i];
+                APEntry *entry;
+                gdouble weight, total, distance;
+
+                weight = get_signal_weight (bss);
+                entry = g_hash_table_lookup (priv->entries, &bss->bssid);
+                if (entry != NULL) {
+                        distance = get_distance (entry->latitude,
+                                                 entry->longitude,
+                                                 latitude,
+                                                 longitude);
+                        if (distance > MAX_AP_RANGE) {
+                                g_debug ("WiFi AP '%s' seems to have moved "
+                                         "%.0f meters, relearning it",
+                                         bss->mac,
+                                         distance);
+                                g_hash_table_remove (priv->entries,
+                                                     &bss->bssid);
+                                entry = NULL;
+                        }
+                }
+
+                if (entry == NULL) {
+                        entry = g_slice_new0 (APEntry);
+                        entry->bssid = bss->bssid;
+                        entry->latitude = latitude;
+                        entry->longitude = longitude;
+                        entry->range = MAX (accuracy, MIN_AP_RANGE);
+                        entry->weight = weight;
+                        entry->last_seen = now;
+                        insert_entry (store, entry);
+                        n_new++;
+
+                        continue;
+                }
+
+                /* Running weighted mean of the position, and of the squared
+                 * distance for the range.
+                 */
+                total = entry->weight + weight;
+                entry->latitude += (latitude - entry->latitude) *
+                                   weight / total;
+                entry->longitude += (longitude - entry->longitude) *
+                                    weight / total;
+                entry->range = sqrt ((entry->weight * entry->range *
+                                      entry->range +
+                                      weight * (distance * distance +
+                                                accuracy * accuracy)) /
+                                     total);
+                entry->range = MAX (entry->range, MIN_AP_RANGE);
+                entry->weight = MIN (total, MAX_AP_WEIGHT);
+                entry->last_seen = now;
+                n_updated++;
+        }
+
+        g_debug ("Learned %u new and updated %u WiFi AP positions, "
+                 "%u known in total",
+                 n_new,
+                 n_updated,
+                 g_hash_table_size (priv->entries));
+        schedule_save (store);
+}
+
+/**
+ * gclue_wifi_ap_store_locate:
+ * @store: a #GClueWifiAPStore
+ * @scan: Snapshot of the visible access points
+ *
+ * Computes a location from the learned positions of the access points in
+ * @scan, as the centroid of the known ones, weighted by their signal
+ * strength and the precision of their position.
+ *
+ * Returns: (transfer full): A new #GClueLocation, or %NULL if not enough of
+ * the access points are known.
+ **/
+GClueLocation *
+gclue_wifi_ap_store_locate (GClueWifiAPStore    *store,
+                            const GClueWifiScan *scan)
+{
+        GClueWifiAPStorePrivate *priv;
+        APEntry *entries[64];
+        gdouble weights[64];
+        gdouble latitude = 0, longitude = 0, accuracy = 0, total = 0;
+        gdouble ref_longitude = 0;
+        guint n_known = 0, i;
+        gint64 start;
+
+        g_return_val_if_fail (GCLUE_IS_WIFI_AP_STORE (store), NULL);
+        priv = store->priv;
+
+        if (g_hash_table_size (priv->entries) == 0)
+                return NULL;
+
+        start = g_get_monotonic_time ();
+        for (i = 0; i < scan->n_bss && n_known < G_N_ELEMENTS (entries); i++) {
+                const GClueWifiBSS *bss = &scan->bss[i];
+                APEntry *entry;
+
+                entry = g_hash_table_lookup (priv->entries, &bss->bssid);
+                if (entry == NULL)
+                        continue;
+
+                entries[n_known] = entry;
+                weights[n_known] = get_signal_weight (bss) / entry->range;
+                n_known++;
+        }
+
+        if (n_known < MIN_KNOWN_APS) {
+                g_debug ("Only %u of %u visible WiFi APs known locally",
+                         n_known,
+                         scan->n_bss);
+                return NULL;
+        }
+
+        /* Longitudes are averaged relative to the first AP, so we don't get
+         * it wrong around the antimeridian.
+         */
+        ref_longitude = entries[0]->longitude;
+        for (i = 0; i < n_known; i++) {
+                gdouble delta = entries[i]->longitude - ref_longitude;
+
+                if (delta > 180)
+                        delta -= 360;
+                else if (delta < -180)
+                        delta += 360;
+
+                latitude += entries[i]->latitude * weights[i];
+                longitude += delta * weights[i];
+                total += weights[i];
+        }
+        latitude /= total;
+        longitude = ref_longitude + longitude / total;
+        if (longitude > 180)
+                longitude -= 360;
+        else if (longitude < -180)
+                longitude += 360;
+
+        /* We are somewhere within range of each AP, so the accuracy is how
+         * far off the centroid is from the APs, plus their range.
+         */
+        for (i = 0; i < n_known; i++) {
+                gdouble distance;
+
+                distance = get_distance (latitude,
+                                         longitude,
+                                         entries[i]->latitude,
+                                         entries[i]->longitude);
+                accuracy += (distance + entries[i]->range) * weights[i];
+        }
+        accuracy /= total;
+
+        g_debug ("Located %u of %u visible WiFi APs locally in %"
+                 G_GINT64_FORMAT " us, accuracy %.0f meters",
+                 n_known,
+                 scan->n_bss,
+                 g_get_monotonic_time () - start,
+                 accuracy);
+
+        return gclue_location_new (latitude, longitude, accuracy);
+}
+
+/**
+ * gclue_wifi_ap_store_is_empty:
+ * @store: a #GClueWifiAPStore
+ *
+ * Returns: %TRUE if @store doesn't know any access points, %FALSE otherwise.
+ **/
+gboolean
+gclue_wifi_ap_store_is_empty (GClueWifiAPStore *store)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_AP_STORE (store), TRUE);
+
+        return g_hash_table_size (store->priv->entries) < MIN_KNOWN_APS;
+}
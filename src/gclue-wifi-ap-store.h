@@ -0,0 +1,69 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-ap-store.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_WIFI_AP_STORE_H
+#define GCLUE_WIFI_AP_STORE_H
+
+#include <glib-object.h>
+#include "gclue-location.h"
+#include "gclue-wifi-scan.h"
+
+G_BEGIN_DECLS
+
+#define GCLUE_TYPE_WIFI_AP_STORE            (gclue_wifi_ap_store_get_type())
+#define GCLUE_WIFI_AP_STORE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WIFI_AP_STORE, GClueWifiAPStore))
+#define GCLUE_WIFI_AP_STORE_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WIFI_AP_STORE, GClueWifiAPStore const))
+#define GCLUE_WIFI_AP_STORE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GCLUE_TYPE_WIFI_AP_STORE, GClueWifiAPStoreClass))
+#define GCLUE_IS_WIFI_AP_STORE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_WIFI_AP_STORE))
+#define GCLUE_IS_WIFI_AP_STORE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_WIFI_AP_STORE))
+#define GCLUE_WIFI_AP_STORE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_WIFI_AP_STORE, GClueWifiAPStoreClass))
+
+typedef struct _GClueWifiAPStore        GClueWifiAPStore;
+typedef struct _GClueWifiAPStoreClass   GClueWifiAPStoreClass;
+typedef struct _GClueWifiAPStorePrivate GClueWifiAPStorePrivate;
+
+struct _GClueWifiAPStore
+{
+        GObject parent;
+
+        /*< private >*/
+        GClueWifiAPStorePrivate *priv;
+};
+
+struct _GClueWifiAPStoreClass
+{
+        GObjectClass parent_class;
+};
+
+GType              gclue_wifi_ap_store_get_type      (void) G_GNUC_CONST;
+
+GClueWifiAPStore * gclue_wifi_ap_store_get_singleton (void);
+void               gclue_wifi_ap_store_learn         (GClueWifiAPStore    *store,
+                                                      const GClueWifiScan *scan,
+                                                      GClueLocation       *location);
+GClueLocation *    gclue_wifi_ap_store_locate        (GClueWifiAPStore    *store,
+                                                      const GClueWifiScan *scan);
+gboolean           gclue_wifi_ap_store_is_empty      (GClueWifiAPStore *store);
+
+G_END_DECLS
+
+#endif /* GCLUE_WIFI_AP_STORE_H */
@@ -0,0 +1,248 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-bss.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "gclue-wifi-bss.h"
+
+/**
+ * SECTION:gclue-wifi-bss
+ * @short_description: WiFi access point record
+ *
+ * Everything we need to know about a WiFi access point is extracted once from
+ * the properties wpa_supplicant sends us, and kept up to date from its
+ * PropertiesChanged signals, so the rest of the code doesn't need to go
+ * through GVariant and string formatting every time it looks at the access
+ * point, nor keep a D-Bus proxy around for each of them.
+ **/
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * gclue_wifi_bss_path_to_id:
+ * @path: D-Bus object path of a BSS, as exported by wpa_supplicant
+ * @id: (out): Return location for the ID
+ *
+ * Packs the interface and BSS indices from @path (of the form
+ * "/fi/w1/wpa_supplicant1/Interfaces/N/BSSs/M") into a single integer that
+ * can be used as a hash table key.
+ *
+ * Returns: %TRUE on success, %FALSE if @path is not a BSS path.
+ **/
+gboolean
+gclue_wifi_bss_path_to_id (const char *path,
+                           guint64    *id)
+{
+        const char *p;
+        char *end;
+        guint64 iface, index;
+
+        p = strstr (path, "/Interfaces/");
+        if (p == NULL)
+                return FALSE;
+        p += strlen ("/Interfaces/");
+
+        iface = g_ascii_strtoull (p, &end, 10);
+        if (end == p || !g_str_has_prefix (end, "/BSSs/"))
+                return FALSE;
+        p = end + strlen ("/BSSs/");
+
+        index = g_ascii_strtoull (p, &end, 10);
+        if (end == p || *end != '\0')
+                return FALSE;
+
+        *id = (iface << 32) | (index & G_MAXUINT32);
+
+        return TRUE;
+}
+
+static GClueWifiBSS *
+bss_new (guint64       path_id,
+         const guchar *raw_bssid,
+         const guchar *raw_ssid,
+         gsize         ssid_len)
+{
+        GClueWifiBSS *bss;
+        gsize i;
+
+        bss = g_slice_new0 (GClueWifiBSS);
+        bss->path_id = path_id;
+
+        for (i = 0; i < GCLUE_WIFI_BSSID_LEN; i++) {
+                bss->bssid = (bss->bssid << 8) | raw_bssid[i];
+
+                bss->mac[i * 3] = hex_digits[raw_bssid[i] >> 4];
+                bss->mac[i * 3 + 1] = hex_digits[raw_bssid[i] & 0xf];
+                bss->mac[i * 3 + 2] =
+                        (i == GCLUE_WIFI_BSSID_LEN - 1) ? '\0' : ':';
+        }
+
+        ssid_len = MIN (ssid_len, GCLUE_WIFI_MAX_SSID_LEN);
+        if (ssid_len > 0)
+                memcpy (bss->ssid, raw_ssid, ssid_len);
+        bss->nomap = (ssid_len == 0 ||
+                      g_str_has_suffix (bss->ssid, "_nomap"));
+
+        return bss;
+}
+
+/**
+ * gclue_wifi_bss_new:
+ * @path: D-Bus object path of the BSS
+ * @properties: All properties of the BSS, as a vardict
+ *
+ * Creates a new record for the access point at @path, as announced by the
+ * BSSAdded signal or returned by GetAll.
+ *
+ * Returns: (transfer full): A new #GClueWifiBSS, or %NULL if @path is not a
+ * BSS path or @properties don't contain a valid BSSID. Free with
+ * gclue_wifi_bss_free().
+ **/
+GClueWifiBSS *
+gclue_wifi_bss_new (const char *path,
+                    GVariant   *properties)
+{
+        GClueWifiBSS *bss;
+        GVariant *bssid, *ssid;
+        const guchar *raw_bssid, *raw_ssid = NULL;
+        gsize len, ssid_len = 0;
+        guint64 path_id;
+
+        if (!gclue_wifi_bss_path_to_id (path, &path_id))
+                return NULL;
+
+        bssid = g_variant_lookup_value (properties,
+                                        "BSSID",
+                                        G_VARIANT_TYPE_BYTESTRING);
+        if (bssid == NULL)
+                return NULL;
+
+        raw_bssid = g_variant_get_fixed_array (bssid, &len, sizeof (guchar));
+        if (len != GCLUE_WIFI_BSSID_LEN) {
+                g_variant_unref (bssid);
+
+                return NULL;
+        }
+
+        ssid = g_variant_lookup_value (properties,
+                                       "SSID",
+                                       G_VARIANT_TYPE_BYTESTRING);
+        if (ssid != NULL)
+                raw_ssid = g_variant_get_fixed_array (ssid,
+                                                      &ssid_len,
+                                                      sizeof (guchar));
+
+        bss = bss_new (path_id, raw_bssid, raw_ssid, ssid_len);
+        g_variant_unref (bssid);
+        if (ssid != NULL)
+                g_variant_unref (ssid);
+
+        gclue_wifi_bss_update (bss, properties);
+
+        return bss;
+}
+
+/**
+ * gclue_wifi_bss_new_for_mac:
+ * @mac: BSSID, in the "aa:bb:cc:dd:ee:ff" form
+ * @ssid: (nullable): SSID of the network
+ * @path_id: Device and BSS index, see gclue_wifi_bss_path_to_id()
+ *
+ * Creates a new record for an access point that wpa_supplicant didn't tell us
+ * about, e.g one from a recorded trace.
+ *
+ * Returns: (transfer full): A new #GClueWifiBSS, or %NULL if @mac is not a
+ * valid BSSID. Free with gclue_wifi_bss_free().
+ **/
+GClueWifiBSS *
+gclue_wifi_bss_new_for_mac (const char *mac,
+                            const char *ssid,
+                            guint64     path_id)
+{
+        guchar raw_bssid[GCLUE_WIFI_BSSID_LEN];
+        gsize i;
+
+        if (strlen (mac) != GCLUE_WIFI_BSSID_STR_LEN - 1)
+                return NULL;
+
+        for (i = 0; i < GCLUE_WIFI_BSSID_LEN; i++) {
+                gint high, low;
+
+                high = g_ascii_xdigit_value (mac[i * 3]);
+                low = g_ascii_xdigit_value (mac[i * 3 + 1]);
+                if (high < 0 || low < 0 ||
+                    (i < GCLUE_WIFI_BSSID_LEN - 1 && mac[i * 3 + 2] != ':'))
+                        return NULL;
+
+                raw_bssid[i] = (high << 4) | low;
+        }
+
+        return bss_new (path_id,
+                        raw_bssid,
+                        (const guchar *) ssid,
+                        (ssid != NULL) ? strlen (ssid) : 0);
+}
+
+/**
+ * gclue_wifi_bss_update:
+ * @bss: A #GClueWifiBSS
+ * @properties: Changed properties of the BSS, as a vardict
+ *
+ * Updates the properties of @bss that can change over time.
+ *
+ * Returns: %TRUE if the signal strength changed, %FALSE otherwise.
+ **/
+gboolean
+gclue_wifi_bss_update (GClueWifiBSS *bss,
+                       GVariant     *properties)
+{
+        gint16 signal;
+        guint32 age;
+
+        g_variant_lookup (properties, "Frequency", "q", &bss->frequency);
+
+        /* wpa_supplicant updates the age each time it sees the AP */
+        if (g_variant_lookup (properties, "Age", "u", &age))
+                bss->last_seen = g_get_monotonic_time () -
+                                 (gint64) age * G_USEC_PER_SEC;
+        else if (bss->last_seen == 0)
+                bss->last_seen = g_get_monotonic_time ();
+
+        if (!g_variant_lookup (properties, "Signal", "n", &signal) ||
+            signal == bss->signal)
+                return FALSE;
+        bss->signal = signal;
+
+        return TRUE;
+}
+
+/**
+ * gclue_wifi_bss_free:
+ * @bss: A #GClueWifiBSS
+ *
+ * Frees @bss.
+ **/
+void
+gclue_wifi_bss_free (GClueWifiBSS *bss)
+{
+        g_slice_free (GClueWifiBSS, bss);
+}
@@ -0,0 +1,66 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-bss.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_WIFI_BSS_H
+#define GCLUE_WIFI_BSS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GCLUE_WIFI_BSSID_LEN     6
+#define GCLUE_WIFI_BSSID_STR_LEN 18
+#define GCLUE_WIFI_MAX_SSID_LEN  32
+
+typedef struct _GClueWifiBSS GClueWifiBSS;
+
+struct _GClueWifiBSS {
+        guint64  bssid;   /* Packed into the lower 48 bits */
+        guint64  path_id; /* Interface and BSS index of the D-Bus object */
+        char     mac[GCLUE_WIFI_BSSID_STR_LEN];
+        char     ssid[GCLUE_WIFI_MAX_SSID_LEN + 1];
+        gboolean nomap;   /* SSID missing or has '_nomap' suffix */
+        gint16   signal;  /* dBm */
+        guint16  frequency;
+        guint32  age;     /* Seconds since it was last seen, as of snapshot */
+        gint64   last_seen; /* Monotonic time */
+};
+
+GClueWifiBSS *
+gclue_wifi_bss_new (const char *path,
+                    GVariant   *properties);
+GClueWifiBSS *
+gclue_wifi_bss_new_for_mac (const char *mac,
+                            const char *ssid,
+                            guint64     path_id);
+gboolean
+gclue_wifi_bss_update (GClueWifiBSS *bss,
+                       GVariant     *properties);
+void
+gclue_wifi_bss_free (GClueWifiBSS *bss);
+gboolean
+gclue_wifi_bss_path_to_id (const char *path,
+                           guint64    *id);
+
+G_END_DECLS
+
+#endif /* GCLUE_WIFI_BSS_H */
@@ -0,0 +1,641 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-cache.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gclue-wifi-cache.h"
+#include "gclue-config.h"
+
+/**
+ * SECTION:gclue-wifi-cache
+ * @short_description: Cache of WiFi-based geolocation results
+ *
+ * Remembers the locations returned by the geolocation service for sets of
+ * WiFi access points, so that a scan seeing (mostly) the same access points
+ * again can be answered locally. Each set is normalized into a sorted array of
+ * BSSIDs and a new set is matched against the cached ones by their Jaccard
+ * similarity. The cache can be kept on disk so it survives restarts.
+ **/
+
+#define CACHE_FILE_NAME    "wifi-cache"
+#define CACHE_SAVE_TIMEOUT 30                    /* seconds */
+/* Access points rarely move but they do get replaced every now and then */
+#define CACHE_MAX_AGE      (7 * 24 * 60 * 60)   /* seconds */
+
+typedef struct
+{
+        guint64 fingerprint;
+
+        guint64 *bssids;
+        guint n_bssids;
+
+        gdouble latitude;
+        gdouble longitude;
+        gdouble accuracy;
+
+        guint64 timestamp; /* When we got the location from the service */
+        guint64 last_used;
+} CacheEntry;
+
+struct _GClueWifiCachePrivate
+{
+        GHashTable *entries;
+
+        guint max_entries;
+        gdouble threshold;
+        gboolean persist;
+
+        char *path;
+        guint save_timeout;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueWifiCache,
+                         gclue_wifi_cache,
+                         G_TYPE_OBJECT,
+                         G_ADD_PRIVATE (GClueWifiCache))
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+        g_free (entry->bssids);
+        g_slice_free (CacheEntry, entry);
+}
+
+static guint64
+get_now (void)
+{
+        return g_get_real_time () / G_USEC_PER_SEC;
+}
+
+static gint
+compare_bssids (gconstpointer a,
+                gconstpointer b)
+{
+        guint64 bssid_a = *((const guint64 *) a);
+        guint64 bssid_b = *((const guint64 *) b);
+
+        return (bssid_a > bssid_b) - (bssid_a < bssid_b);
+}
+
+/* Sorts @bssids and drops duplicates. Returns the new length. */
+static guint
+normalize_bssids (guint64 *bssids,
+                  guint    n_bssids)
+{
+        guint i, j;
+
+        if (n_bssids == 0)
+                return 0;
+
+        qsort (bssids, n_bssids, sizeof (guint64), compare_bssids);
+
+        for (i = 1, j = 0; i < n_bssids; i++) {
+                if (bssids[i] != bssids[j])
+                        bssids[++j] = bssids[i];
+        }
+
+        return j + 1;
+}
+
+/* FNV-1a hash over the 6 bytes of each BSSID in the normalized set */
+static guint64
+get_fingerprint (const guint64 *bssids,
+                 guint          n_bssids)
+{
+        guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+        guint i, j;
+
+        for (i = 0; i < n_bssids; i++) {
+                for (j = 0; j < 6; j++) {
+                        hash ^= (bssids[i] >> (j * 8)) & 0xff;
+                        hash *= G_GUINT64_CONSTANT (0x100000001b3);
+                }
+        }
+
+        return hash;
+}
+
+/* Snapshots are sorted by BSSID already and have no duplicates, so this
+ * gives a normalized set.
+ */
+static guint64 *
+get_scan_bssids (const GClueWifiScan *scan)
+{
+        guint64 *bssids;
+        guint i;
+
+        bssids = g_new (guint64, scan->n_bss);
+        for (i = 0; i < scan->n_bss; i++)
+                bssids[i] = scan->bss[i].bssid;
+
+        return bssids;
+}
+
+/* Whether two normalized sets are the same */
+static gboolean
+same_bssids (const guint64 *a,
+             guint          n_a,
+             const guint64 *b,
+             guint          n_b)
+{
+        return n_a == n_b && memcmp (a, b, n_a * sizeof (guint64)) == 0;
+}
+
+/* Jaccard similarity of two normalized sets */
+static gdouble
+get_similarity (const guint64 *a,
+                guint          n_a,
+                const guint64 *b,
+                guint          n_b)
+{
+        guint i = 0, j = 0, common = 0;
+
+        if (n_a == 0 || n_b == 0)
+                return 0.0;
+
+        while (i < n_a && j < n_b) {
+                if (a[i] == b[j]) {
+                        common++;
+                        i++;
+                        j++;
+                } else if (a[i] < b[j]) {
+                        i++;
+                } else {
+                        j++;
+                }
+        }
+
+        return (gdouble) common / (n_a + n_b - common);
+}
+
+static void
+evict_least_recently_used (GClueWifiCache *cache)
+{
+        GHashTableIter iter;
+        CacheEntry *entry, *oldest = NULL;
+
+        g_hash_table_iter_init (&iter, cache->priv->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+                if (oldest == NULL || entry->last_used < oldest->last_used)
+                        oldest = entry;
+        }
+
+        if (oldest != NULL)
+                g_hash_table_remove (cache->priv->entries, &oldest->fingerprint);
+}
+
+static void
+insert_entry (GClueWifiCache *cache,
+              CacheEntry     *entry)
+{
+        GClueWifiCachePrivate *priv = cache->priv;
+
+        g_hash_table_remove (priv->entries, &entry->fingerprint);
+        while (g_hash_table_size (priv->entries) > 0 &&
+               g_hash_table_size (priv->entries) >= priv->max_entries)
+                evict_least_recently_used (cache);
+
+        g_hash_table_insert (priv->entries, &entry->fingerprint, entry);
+}
+
+static gboolean
+save_cache (GClueWifiCache *cache)
+{
+        GClueWifiCachePrivate *priv = cache->priv;
+        GKeyFile *key_file;
+        GHashTableIter iter;
+        CacheEntry *entry;
+        GError *error = NULL;
+        char *dir;
+
+        priv->save_timeout = 0;
+
+        key_file = g_key_file_new ();
+        g_hash_table_iter_init (&iter, priv->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+                char group[17];
+                char **bssids;
+                guint i;
+
+                g_snprintf (group,
+                            sizeof (group),
+                            "%016" G_GINT64_MODIFIER "x",
+                            entry->fingerprint);
+
+                bssids = g_new0 (char *, entry->n_bssids + 1);
+                for (i = 0; i < entry->n_bssids; i++)
+                        bssids[i] = g_strdup_printf ("%012" G_GINT64_MODIFIER "x",
+                                                     entry->bssids[i]);
+                g_key_file_set_string_list (key_file,
+                                            group,
+                                            "bssids",
+                                            (const char * const *) bssids,
+                                            entry->n_bssids);
+                g_strfreev (bssids);
+
+                g_key_file_set_double (key_file,
+                                       group,
+                                       "latitude",
+                                       entry->latitude);
+                g_key_file_set_double (key_file,
+                                       group,
+                                       "longitude",
+                                       entry->longitude);
+                g_key_file_set_double (key_file,
+                                       group,
+                                       "accuracy",
+                                       entry->accuracy);
+                g_key_file_set_uint64 (key_file,
+                                       group,
+                                       "timestamp",
+                                       entry->timestamp);
+                g_key_file_set_uint64 (key_file,
+                                       group,
+                                       "last-used",
+                                       entry->last_used);
+        }
+
+        /* It's a history of where we have been, so only for our eyes */
+        dir = g_path_get_dirname (priv->path);
+        g_mkdir_with_parents (dir, 0700);
+        g_chmod (dir, 0700);
+        g_free (dir);
+
+        if (!g_key_file_save_to_file (key_file, priv->path, &error)) {
+                g_warning ("Failed to save WiFi cache to '%s': %s",
+                           priv->path,
+                           error->message);
+                g_error_free (error);
+        } else {
+                g_chmod (priv->path, 0600);
+        }
+        g_key_file_unref (key_file);
+
+        return FALSE;
+}
+
+static void
+schedule_save (GClueWifiCache *cache)
+{
+        if (!cache->priv->persist || cache->priv->save_timeout != 0)
+                return;
+
+        cache->priv->save_timeout =
+                g_timeout_add_seconds (CACHE_SAVE_TIMEOUT,
+                                       (GSourceFunc) save_cache,
+                                       cache);
+}
+
+static void
+load_cache (GClueWifiCache *cache)
+{
+        GClueWifiCachePrivate *priv = cache->priv;
+        GKeyFile *key_file;
+        GError *error = NULL;
+        char **groups;
+        gsize num_groups = 0, i;
+        guint64 now = get_now ();
+
+        key_file = g_key_file_new ();
+        if (!g_key_file_load_from_file (key_file,
+                                        priv->path,
+                                        G_KEY_FILE_NONE,
+                                        &error)) {
+                g_debug ("Failed to load WiFi cache from '%s': %s",
+                         priv->path,
+                         error->message);
+                g_error_free (error);
+                g_key_file_unref (key_file);
+
+                return;
+        }
+
+        groups = g_key_file_get_groups (key_file, &num_groups);
+        for (i = 0; i < num_groups; i++) {
+                CacheEntry *entry;
+                char **bssids;
+                gsize n_bssids = 0, j;
+
+                bssids = g_key_file_get_string_list (key_file,
+                                                     groups[i],
+                                                     "bssids",
+                                                     &n_bssids,
+                                                     NULL);
+                if (bssids == NULL || n_bssids == 0) {
+                        g_strfreev (bssids);
+
+                        continue;
+                }
+
+                entry = g_slice_new0 (CacheEntry);
+                entry->bssids = g_new (guint64, n_bssids);
+                for (j = 0; j < n_bssids; j++)
+                        entry->bssids[j] = g_ascii_strtoull (bssids[j],
+                                                             NULL,
+                                                             16);
+                g_strfreev (bssids);
+                entry->n_bssids = normalize_bssids (entry->bssids, n_bssids);
+                entry->fingerprint = get_fingerprint (entry->bssids,
+                                                      entry->n_bssids);
+
+                entry->latitude = g_key_file_get_double (key_file,
+                                                         groups[i],
+                                                         "latitude",
+                                                         &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->longitude = g_key_file_get_double (key_file,
+                                                          groups[i],
+                                                          "longitude",
+                                                          &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->accuracy = g_key_file_get_double (key_file,
+                                                         groups[i],
+                                                         "accuracy",
+                                                         &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->timestamp = g_key_file_get_uint64 (key_file,
+                                                          groups[i],
+                                                          "timestamp",
+                                                          &error);
+                if (error != NULL)
+                        goto invalid_entry;
+                entry->last_used = g_key_file_get_uint64 (key_file,
+                                                          groups[i],
+                                                          "last-used",
+                                                          NULL);
+
+                if (entry->timestamp + CACHE_MAX_AGE < now) {
+                        cache_entry_free (entry);
+
+                        continue;
+                }
+
+                insert_entry (cache, entry);
+
+                continue;
+invalid_entry:
+                g_debug ("Ignoring invalid WiFi cache entry '%s': %s",
+                         groups[i],
+                         error->message);
+                g_clear_error (&error);
+                cache_entry_free (entry);
+        }
+
+        g_debug ("Loaded %u entries from WiFi cache",
+                 g_hash_table_size (priv->entries));
+
+        g_strfreev (groups);
+        g_key_file_unref (key_file);
+}
+
+static void
+gclue_wifi_cache_finalize (GObject *object)
+{
+        GClueWifiCachePrivate *priv = GCLUE_WIFI_CACHE (object)->priv;
+
+        if (priv->save_timeout != 0) {
+                g_source_remove (priv->save_timeout);
+                save_cache (GCLUE_WIFI_CACHE (object));
+        }
+
+        g_clear_pointer (&priv->entries, g_hash_table_unref);
+        g_clear_pointer (&priv->path, g_free);
+
+        G_OBJECT_CLASS (gclue_wifi_cache_parent_class)->finalize (object);
+}
+
+static void
+gclue_wifi_cache_class_init (GClueWifiCacheClass *klass)
+{
+        GObjectClass *object_class;
+
+        object_class = G_OBJECT_CLASS (klass);
+        object_class->finalize = gclue_wifi_cache_finalize;
+}
+
+static void
+gclue_wifi_cache_init (GClueWifiCache *cache)
+{
+        GClueConfig *config = gclue_config_get_singleton ();
+        GClueWifiCachePrivate *priv;
+
+        cache->priv = G_TYPE_INSTANCE_GET_PRIVATE (cache,
+                                                   GCLUE_TYPE_WIFI_CACHE,
+                                                   GClueWifiCachePrivate);
+        priv = cache->priv;
+
+        priv->entries = g_hash_table_new_full (g_int64_hash,
+                                               g_int64_equal,
+                                               NULL,
+                                               (GDestroyNotify) cache_entry_free);
+        priv->max_entries = gclue_config_get_wifi_cache_size (config);
+        priv->threshold = gclue_config_get_wifi_cache_threshold (config);
+        priv->persist = gclue_config_get_wifi_cache_persist (config);
+        priv->path = g_build_filename (g_get_user_cache_dir (),
+                                       "geoclue",
+                                       CACHE_FILE_NAME,
+                                       NULL);
+
+        if (priv->max_entries == 0)
+                priv->persist = FALSE;
+        if (priv->persist)
+                load_cache (cache);
+}
+
+static void
+on_cache_destroyed (gpointer data,
+                    GObject *where_the_object_was)
+{
+        GClueWifiCache **cache = (GClueWifiCache **) data;
+
+        *cache = NULL;
+}
+
+/**
+ * gclue_wifi_cache_get_singleton:
+ *
+ * Get the #GClueWifiCache singleton.
+ *
+ * Returns: (transfer full): a new ref to #GClueWifiCache. Use g_object_unref()
+ * when done.
+ **/
+GClueWifiCache *
+gclue_wifi_cache_get_singleton (void)
+{
+        static GClueWifiCache *cache = NULL;
+
+        if (cache == NULL) {
+                cache = g_object_new (GCLUE_TYPE_WIFI_CACHE, NULL);
+                g_object_weak_ref (G_OBJECT (cache),
+                                   on_cache_destroyed,
+                                   &cache);
+        } else
+                g_object_ref (cache);
+
+        return cache;
+}
+
+/**
+ * gclue_wifi_cache_lookup:
+ * @cache: a #GClueWifiCache
+ * @scan: Snapshot of the visible access points
+ *
+ * Looks for a cached location for the access point set of @scan. An entry
+ * matches if its access point set is similar enough to that of @scan, as
+ * specified by the 'cache-threshold' configuration.
+ *
+ * Returns: (transfer full): A new #GClueLocation, or %NULL if there was no
+ * match.
+ **/
+GClueLocation *
+gclue_wifi_cache_lookup (GClueWifiCache      *cache,
+                         const GClueWifiScan *scan)
+{
+        GClueWifiCachePrivate *priv;
+        GHashTableIter iter;
+        CacheEntry *entry, *best;
+        gdouble best_similarity = 0.0;
+        guint64 *normalized, fingerprint, now;
+        guint n_normalized;
+
+        g_return_val_if_fail (GCLUE_IS_WIFI_CACHE (cache), NULL);
+        priv = cache->priv;
+
+        if (scan->n_bss == 0 || g_hash_table_size (priv->entries) == 0)
+                return NULL;
+
+        normalized = get_scan_bssids (scan);
+        n_normalized = scan->n_bss;
+        fingerprint = get_fingerprint (normalized, n_normalized);
+        now = get_now ();
+
+        /* Different sets can have the same fingerprint, however unlikely */
+        best = g_hash_table_lookup (priv->entries, &fingerprint);
+        if (best != NULL &&
+            same_bssids (normalized,
+                         n_normalized,
+                         best->bssids,
+                         best->n_bssids)) {
+                best_similarity = 1.0;
+        } else {
+                best = NULL;
+                g_hash_table_iter_init (&iter, priv->entries);
+                while (g_hash_table_iter_next (&iter,
+                                               NULL,
+                                               (gpointer *) &entry)) {
+                        gdouble similarity;
+
+                        similarity = get_similarity (normalized,
+                                                     n_normalized,
+                                                     entry->bssids,
+                                                     entry->n_bssids);
+                        if (similarity > best_similarity) {
+                                best = entry;
+                                best_similarity = similarity;
+                        }
+                }
+        }
+        g_free (normalized);
+
+        if (best == NULL || best_similarity < priv->threshold) {
+                g_debug ("No cached location for %u WiFi APs "
+                         "(best similarity %.2f)",
+                         scan->n_bss,
+                         best_similarity);
+                return NULL;
+        }
+
+        if (best->timestamp + CACHE_MAX_AGE < now) {
+                g_debug ("Cached location for %u WiFi APs expired",
+                         scan->n_bss);
+                g_hash_table_remove (priv->entries, &best->fingerprint);
+                schedule_save (cache);
+
+                return NULL;
+        }
+
+        g_debug ("Found cached location for %u WiFi APs (similarity %.2f)",
+                 scan->n_bss,
+                 best_similarity);
+        best->last_used = now;
+        schedule_save (cache);
+
+        return gclue_location_new (best->latitude,
+                                   best->longitude,
+                                   best->accuracy);
+}
+
+/**
+ * gclue_wifi_cache_add:
+ * @cache: a #GClueWifiCache
+ * @scan: Snapshot of the access points that @location was found for
+ * @location: the location to remember
+ *
+ * Adds @location to @cache, replacing any existing entry for the exact same
+ * access point set.
+ **/
+void
+gclue_wifi_cache_add (GClueWifiCache      *cache,
+                      const GClueWifiScan *scan,
+                      GClueLocation       *location)
+{
+        CacheEntry *entry;
+
+        g_return_if_fail (GCLUE_IS_WIFI_CACHE (cache));
+        g_return_if_fail (GCLUE_IS_LOCATION (location));
+
+        if (scan->n_bss == 0 || cache->priv->max_entries == 0)
+                return;
+
+        entry = g_slice_new0 (CacheEntry);
+        entry->bssids = get_scan_bssids (scan);
+        entry->n_bssids = scan->n_bss;
+        entry->fingerprint = get_fingerprint (entry->bssids,
+                                              entry->n_bssids);
+        entry->latitude = gclue_location_get_latitude (location);
+        entry->longitude = gclue_location_get_longitude (location);
+        entry->accuracy = gclue_location_get_accuracy (location);
+        entry->timestamp = get_now ();
+        entry->last_used = entry->timestamp;
+
+        insert_entry (cache, entry);
+        schedule_save (cache);
+}
+
+/**
+ * gclue_wifi_cache_is_empty:
+ * @cache: a #GClueWifiCache
+ *
+ * Returns: %TRUE if @cache has no entries, %FALSE otherwise.
+ **/
+gboolean
+gclue_wifi_cache_is_empty (GClueWifiCache *cache)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_CACHE (cache), TRUE);
+
+        return g_hash_table_size (cache->priv->entries) == 0;
+}
@@ -0,0 +1,69 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-cache.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_WIFI_CACHE_H
+#define GCLUE_WIFI_CACHE_H
+
+#include <glib-object.h>
+#include "gclue-location.h"
+#include "gclue-wifi-scan.h"
+
+G_BEGIN_DECLS
+
+#define GCLUE_TYPE_WIFI_CACHE            (gclue_wifi_cache_get_type())
+#define GCLUE_WIFI_CACHE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WIFI_CACHE, GClueWifiCache))
+#define GCLUE_WIFI_CACHE_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WIFI_CACHE, GClueWifiCache const))
+#define GCLUE_WIFI_CACHE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GCLUE_TYPE_WIFI_CACHE, GClueWifiCacheClass))
+#define GCLUE_IS_WIFI_CACHE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_WIFI_CACHE))
+#define GCLUE_IS_WIFI_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_WIFI_CACHE))
+#define GCLUE_WIFI_CACHE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_WIFI_CACHE, GClueWifiCacheClass))
+
+typedef struct _GClueWifiCache        GClueWifiCache;
+typedef struct _GClueWifiCacheClass   GClueWifiCacheClass;
+typedef struct _GClueWifiCachePrivate GClueWifiCachePrivate;
+
+struct _GClueWifiCache
+{
+        GObject parent;
+
+        /*< private >*/
+        GClueWifiCachePrivate *priv;
+};
+
+struct _GClueWifiCacheClass
+{
+        GObjectClass parent_class;
+};
+
+GType            gclue_wifi_cache_get_type      (void) G_GNUC_CONST;
+
+GClueWifiCache * gclue_wifi_cache_get_singleton (void);
+GClueLocation *  gclue_wifi_cache_lookup        (GClueWifiCache      *cache,
+                                                 const GClueWifiScan *scan);
+void             gclue_wifi_cache_add           (GClueWifiCache      *cache,
+                                                 const GClueWifiScan *scan,
+                                                 GClueLocation       *location);
+gboolean         gclue_wifi_cache_is_empty      (GClueWifiCache *cache);
+
+G_END_DECLS
+
+#endif /* GCLUE_WIFI_CACHE_H */
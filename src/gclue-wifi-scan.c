@@ -0,0 +1,268 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-scan.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+#include "gclue-wifi-scan.h"
+
+/**
+ * SECTION:gclue-wifi-scan
+ * @short_description: Snapshot of visible WiFi access points
+ *
+ * The access point records are updated all the time as wpa_supplicant tells
+ * us about changes. Once a scan completes, a copy of them is taken into a
+ * single, contiguous and immutable block, which is then shared by everything
+ * that looks at the result of that scan: the change detection, the cache, the
+ * geolocation query and the submission. They all see the same data, however
+ * long the query takes.
+ **/
+
+/* Diversity penalties (dB) for each access point already selected in the same
+ * frequency band, or from the same manufacturer.
+ */
+#define BAND_PENALTY 1
+#define OUI_PENALTY  3
+
+static GClueWifiScan *
+scan_alloc (guint size)
+{
+        GClueWifiScan *scan;
+
+        scan = g_malloc (sizeof (GClueWifiScan) +
+                         size * sizeof (GClueWifiBSS));
+        scan->ref_count = 1;
+        scan->time = g_get_monotonic_time ();
+        scan->n_bss = 0;
+
+        return scan;
+}
+
+static gint
+compare_bss (gconstpointer a,
+             gconstpointer b)
+{
+        const GClueWifiBSS *bss_a = a;
+        const GClueWifiBSS *bss_b = b;
+
+        return (bss_a->bssid > bss_b->bssid) - (bss_a->bssid < bss_b->bssid);
+}
+
+/**
+ * gclue_wifi_scan_new:
+ * @bss_records: BSSID => #GClueWifiBSS hash table of the visible access
+ * points
+ * @weak_signal: Signal strength (dBm) at or below which access points are
+ * too weak to be useful
+ * @seen_since: Monotonic time access points must have been seen since
+ *
+ * Takes a snapshot of the access points in @bss_records that can be used for
+ * geolocation, i-e the ones that are not opted out of, have a signal stronger
+ * than @weak_signal and were last seen at or after @seen_since.
+ *
+ * Returns: (transfer full): A new #GClueWifiScan. Use gclue_wifi_scan_unref()
+ * when done.
+ **/
+GClueWifiScan *
+gclue_wifi_scan_new (GHashTable *bss_records,
+                     gint        weak_signal,
+                     gint64      seen_since)
+{
+        GClueWifiScan *scan;
+        GHashTableIter iter;
+        GClueWifiBSS *bss;
+
+        scan = scan_alloc (g_hash_table_size (bss_records));
+
+        g_hash_table_iter_init (&iter, bss_records);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &bss)) {
+                if (bss->nomap ||
+                    bss->signal <= weak_signal ||
+                    bss->last_seen < seen_since)
+                        continue;
+
+                scan->bss[scan->n_bss] = *bss;
+                scan->bss[scan->n_bss].age =
+                        MAX (scan->time - bss->last_seen, 0) / G_USEC_PER_SEC;
+                scan->n_bss++;
+        }
+        qsort (scan->bss, scan->n_bss, sizeof (GClueWifiBSS), compare_bss);
+
+        return scan;
+}
+
+/**
+ * gclue_wifi_scan_has_same_bss:
+ * @scan: (nullable): A #GClueWifiScan
+ * @other: (nullable): Another #GClueWifiScan
+ *
+ * Returns: %TRUE if @scan and @other contain the same access points, however
+ * their signals changed. %NULL counts as different from anything.
+ **/
+gboolean
+gclue_wifi_scan_has_same_bss (const GClueWifiScan *scan,
+                              const GClueWifiScan *other)
+{
+        guint i;
+
+        if (scan == NULL || other == NULL || scan->n_bss != other->n_bss)
+                return FALSE;
+
+        /* Both are sorted by BSSID */
+        for (i = 0; i < scan->n_bss; i++) {
+                if (scan->bss[i].bssid != other->bss[i].bssid)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+static guint
+get_band (const GClueWifiBSS *bss)
+{
+        if (bss->frequency < 3000)
+                return 0; /* 2.4 GHz */
+        else if (bss->frequency < 5925)
+                return 1; /* 5 GHz */
+        else
+                return 2; /* 6 GHz */
+}
+
+/* Manufacturer part of the BSSID */
+static gpointer
+get_oui (const GClueWifiBSS *bss)
+{
+        return GUINT_TO_POINTER ((guint) (bss->bssid >> 24));
+}
+
+static guint
+count_oui (GHashTable         *ouis,
+           const GClueWifiBSS *bss)
+{
+        return GPOINTER_TO_UINT (g_hash_table_lookup (ouis, get_oui (bss)));
+}
+
+/**
+ * gclue_wifi_scan_select:
+ * @scan: A #GClueWifiScan
+ * @max_bss: Maximum number of access points to select, 0 for no limit
+ *
+ * Picks the (at most) @max_bss access points of @scan most useful for a
+ * geolocation query. Access points are picked by signal strength, but each
+ * access point already picked in the same frequency band, or with the same
+ * OUI, counts against the others so the selection doesn't end up being all
+ * the radios of a single deployment.
+ *
+ * Returns: (transfer full): A #GClueWifiScan with the selected access points,
+ * which is @scan itself if it has no more than @max_bss of them. Use
+ * gclue_wifi_scan_unref() when done.
+ **/
+GClueWifiScan *
+gclue_wifi_scan_select (GClueWifiScan *scan,
+                        guint          max_bss)
+{
+        GClueWifiScan *selection;
+        gboolean *picked;
+        GHashTable *ouis; /* OUI => number of picked APs */
+        guint bands[3] = { 0, 0, 0 };
+        guint i, n_picked;
+
+        g_return_val_if_fail (scan != NULL, NULL);
+
+        if (max_bss == 0 || scan->n_bss <= max_bss)
+                return gclue_wifi_scan_ref (scan);
+
+        selection = scan_alloc (max_bss);
+        selection->time = scan->time;
+        picked = g_new0 (gboolean, scan->n_bss);
+        ouis = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+        for (n_picked = 0; n_picked < max_bss; n_picked++) {
+                gint best_score = G_MININT;
+                guint best = 0;
+                guint n_oui;
+
+                for (i = 0; i < scan->n_bss; i++) {
+                        const GClueWifiBSS *bss = &scan->bss[i];
+                        gint score;
+
+                        if (picked[i])
+                                continue;
+
+                        score = bss->signal -
+                                BAND_PENALTY * (gint) bands[get_band (bss)] -
+                                OUI_PENALTY * (gint) count_oui (ouis, bss);
+                        if (score > best_score) {
+                                best_score = score;
+                                best = i;
+                        }
+                }
+
+                picked[best] = TRUE;
+                bands[get_band (&scan->bss[best])]++;
+                n_oui = count_oui (ouis, &scan->bss[best]);
+                g_hash_table_insert (ouis,
+                                     get_oui (&scan->bss[best]),
+                                     GUINT_TO_POINTER (n_oui + 1));
+        }
+
+        /* Keep it sorted by BSSID, like any snapshot */
+        for (i = 0; i < scan->n_bss; i++) {
+                if (picked[i])
+                        selection->bss[selection->n_bss++] = scan->bss[i];
+        }
+
+        g_hash_table_unref (ouis);
+        g_free (picked);
+
+        return selection;
+}
+
+/**
+ * gclue_wifi_scan_ref:
+ * @scan: A #GClueWifiScan
+ *
+ * Returns: @scan
+ **/
+GClueWifiScan *
+gclue_wifi_scan_ref (GClueWifiScan *scan)
+{
+        g_return_val_if_fail (scan != NULL, NULL);
+
+        g_atomic_int_inc (&scan->ref_count);
+
+        return scan;
+}
+
+/**
+ * gclue_wifi_scan_unref:
+ * @scan: A #GClueWifiScan
+ *
+ * Drops a reference to @scan, freeing it if that was the last one.
+ **/
+void
+gclue_wifi_scan_unref (GClueWifiScan *scan)
+{
+        g_return_if_fail (scan != NULL);
+
+        if (g_atomic_int_dec_and_test (&scan->ref_count))
+                g_free (scan);
+}
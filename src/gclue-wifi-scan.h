@@ -0,0 +1,60 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-scan.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_WIFI_SCAN_H
+#define GCLUE_WIFI_SCAN_H
+
+#include <glib.h>
+#include "gclue-wifi-bss.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GClueWifiScan GClueWifiScan;
+
+struct _GClueWifiScan {
+        /*< private >*/
+        gint         ref_count;
+
+        /*< public >*/
+        gint64       time;  /* Monotonic time the snapshot was taken at */
+        guint        n_bss;
+        GClueWifiBSS bss[]; /* Sorted by BSSID */
+};
+
+GClueWifiScan *
+gclue_wifi_scan_new (GHashTable *bss_records,
+                     gint        weak_signal,
+                     gint64      seen_since);
+gboolean
+gclue_wifi_scan_has_same_bss (const GClueWifiScan *scan,
+                              const GClueWifiScan *other);
+GClueWifiScan *
+gclue_wifi_scan_select (GClueWifiScan *scan,
+                        guint          max_bss);
+GClueWifiScan *
+gclue_wifi_scan_ref (GClueWifiScan *scan);
+void
+gclue_wifi_scan_unref (GClueWifiScan *scan);
+
+G_END_DECLS
+
+#endif /* GCLUE_WIFI_SCAN_H */
@@ -0,0 +1,344 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-scanner.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <glib.h>
+#include "gclue-wifi-scanner.h"
+#include "gclue-wpa-scanner.h"
+#include "gclue-replay-scanner.h"
+#include "gclue-config.h"
+
+/**
+ * SECTION:gclue-wifi-scanner
+ * @short_description: Source of WiFi access points
+ *
+ * This interface is implemented by the modules that find out which WiFi access
+ * points are around. Normally that is wpa_supplicant but the same data can
+ * also be replayed from a recorded trace, e.g to run the rest of the WiFi
+ * source on a machine without any radio.
+ *
+ * Implementations keep a table of the access points they currently see,
+ * BSSID => #GClueWifiBSS, with a single record for each access point, and
+ * emit #GClueWifiScanner::bss-list-changed whenever one appears in it or
+ * disappears from it. The records are owned by the scanner and shared by all
+ * its users, so they are read-only to them.
+ *
+ * There is a single scanner for all the WiFi sources, so the radio is scanned
+ * and the access points are kept track of only once. Starting and stopping
+ * it is counted, so it keeps going as long as any of its users needs it.
+ **/
+
+G_DEFINE_INTERFACE (GClueWifiScanner, gclue_wifi_scanner, 0);
+
+static void
+gclue_wifi_scanner_default_init (GClueWifiScannerInterface *iface)
+{
+        GParamSpec *spec;
+
+        spec = g_param_spec_boolean ("is-ready",
+                                     "IsReady",
+                                     "Whether the available devices are known",
+                                     FALSE,
+                                     G_PARAM_READABLE);
+        g_object_interface_install_property (iface, spec);
+
+        /**
+         * GClueWifiScanner::device-added:
+         *
+         * A WiFi device became available.
+         **/
+        g_signal_new ("device-added",
+                      GCLUE_TYPE_WIFI_SCANNER,
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE,
+                      0);
+
+        /**
+         * GClueWifiScanner::device-removed:
+         *
+         * A WiFi device went away, along with the access points only it saw.
+         **/
+        g_signal_new ("device-removed",
+                      GCLUE_TYPE_WIFI_SCANNER,
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE,
+                      0);
+
+        /**
+         * GClueWifiScanner::bss-list-changed:
+         *
+         * An access point appeared or disappeared.
+         **/
+        g_signal_new ("bss-list-changed",
+                      GCLUE_TYPE_WIFI_SCANNER,
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE,
+                      0);
+
+        /**
+         * GClueWifiScanner::scan-done:
+         * @success: Whether the scan succeeded on any device
+         *
+         * A scan finished on all devices. It may also be emitted without
+         * gclue_wifi_scanner_scan() having been called, if the scanner
+         * learned about a new set of access points by itself. Users tell
+         * which scan it was by gclue_wifi_scanner_get_scan_id().
+         **/
+        g_signal_new ("scan-done",
+                      GCLUE_TYPE_WIFI_SCANNER,
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      g_cclosure_marshal_VOID__BOOLEAN,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_BOOLEAN);
+}
+
+/**
+ * gclue_wifi_scanner_get_is_ready:
+ * @scanner: A #GClueWifiScanner
+ *
+ * Returns: %TRUE once @scanner found out which WiFi devices there are, so
+ * gclue_wifi_scanner_get_has_devices() can be relied on.
+ **/
+gboolean
+gclue_wifi_scanner_get_is_ready (GClueWifiScanner *scanner)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_SCANNER (scanner), FALSE);
+
+        return GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->get_is_ready
+                                                        (scanner);
+}
+
+gboolean
+gclue_wifi_scanner_get_has_devices (GClueWifiScanner *scanner)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_SCANNER (scanner), FALSE);
+
+        return GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->get_has_devices
+                                                        (scanner);
+}
+
+/**
+ * gclue_wifi_scanner_get_bss_records:
+ * @scanner: A #GClueWifiScanner
+ *
+ * Returns: (transfer none): The access points currently seen by @scanner,
+ * BSSID => #GClueWifiBSS. Empty unless @scanner was started.
+ **/
+GHashTable *
+gclue_wifi_scanner_get_bss_records (GClueWifiScanner *scanner)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_SCANNER (scanner), NULL);
+
+        return GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->get_bss_records
+                                                        (scanner);
+}
+
+/**
+ * gclue_wifi_scanner_get_scan_started:
+ * @scanner: A #GClueWifiScanner
+ *
+ * Gets when the latest scan actually started, which is earlier than when a
+ * user asked for it if it joined a scan in progress.
+ *
+ * Returns: The monotonic time the latest scan started at, or 0 if there was
+ * none since @scanner was started.
+ **/
+gint64
+gclue_wifi_scanner_get_scan_started (GClueWifiScanner *scanner)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_SCANNER (scanner), 0);
+
+        return GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->get_scan_started
+                                                        (scanner);
+}
+
+/**
+ * gclue_wifi_scanner_get_scan_id:
+ * @scanner: A #GClueWifiScanner
+ *
+ * Gets the ID of the latest scan, as returned by gclue_wifi_scanner_scan() to
+ * the users asking for it. While #GClueWifiScanner::scan-done is emitted, that
+ * is the scan that finished.
+ *
+ * Returns: The ID of the latest scan, or 0 if there was none yet.
+ **/
+guint
+gclue_wifi_scanner_get_scan_id (GClueWifiScanner *scanner)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_SCANNER (scanner), 0);
+
+        return GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->get_scan_id
+                                                        (scanner);
+}
+
+/**
+ * gclue_wifi_scanner_get_sets_pace:
+ * @scanner: A #GClueWifiScanner
+ *
+ * Gets whether @scanner scans at a pace of its own, e.g the one a trace was
+ * recorded at, rather than when asked to. Its users should then take each
+ * scan as it comes, instead of scheduling their own.
+ *
+ * Returns: %TRUE if @scanner sets the pace of the scans.
+ **/
+gboolean
+gclue_wifi_scanner_get_sets_pace (GClueWifiScanner *scanner)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_SCANNER (scanner), FALSE);
+
+        return GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->get_sets_pace
+                                                        (scanner);
+}
+
+/**
+ * gclue_wifi_scanner_start:
+ * @scanner: A #GClueWifiScanner
+ *
+ * Starts keeping track of the access points around, unless some other user
+ * of @scanner started it already.
+ **/
+void
+gclue_wifi_scanner_start (GClueWifiScanner *scanner)
+{
+        g_return_if_fail (GCLUE_IS_WIFI_SCANNER (scanner));
+
+        GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->start (scanner);
+}
+
+/**
+ * gclue_wifi_scanner_stop:
+ * @scanner: A #GClueWifiScanner
+ *
+ * Undoes a gclue_wifi_scanner_start() call. Once no user needs @scanner
+ * anymore, it stops keeping track of the access points around, cancelling
+ * any ongoing scan and forgetting about all the access points.
+ **/
+void
+gclue_wifi_scanner_stop (GClueWifiScanner *scanner)
+{
+        g_return_if_fail (GCLUE_IS_WIFI_SCANNER (scanner));
+
+        GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->stop (scanner);
+}
+
+/**
+ * gclue_wifi_scanner_scan:
+ * @scanner: A #GClueWifiScanner
+ * @last_scan: (nullable): Snapshot of the last scan, to target this one at
+ * the channels it found access points on
+ * @active: Whether to probe for access points rather than only listen
+ * @full: Whether to scan all channels, even if @last_scan is given
+ *
+ * Starts a scan on all devices, or joins the one in progress.
+ * #GClueWifiScanner::scan-done is emitted once it is done.
+ *
+ * Returns: The ID of the scan, for telling when it is done among the scans of
+ * other users and the ones @scanner did by itself.
+ **/
+guint
+gclue_wifi_scanner_scan (GClueWifiScanner    *scanner,
+                         const GClueWifiScan *last_scan,
+                         gboolean             active,
+                         gboolean             full)
+{
+        g_return_val_if_fail (GCLUE_IS_WIFI_SCANNER (scanner), 0);
+
+        return GCLUE_WIFI_SCANNER_GET_INTERFACE (scanner)->scan (scanner,
+                                                                 last_scan,
+                                                                 active,
+                                                                 full);
+}
+
+static void
+on_scanner_destroyed (gpointer data,
+                      GObject *where_the_object_was)
+{
+        GClueWifiScanner **scanner = (GClueWifiScanner **) data;
+
+        *scanner = NULL;
+}
+
+/* Replays a recorded trace instead of scanning, if configured to */
+static GClueWifiScanner *
+create_scanner (void)
+{
+        GClueConfig *config = gclue_config_get_singleton ();
+        GClueWifiScanner *scanner;
+        const char *replay_file;
+        GError *error = NULL;
+
+        replay_file = gclue_config_get_wifi_replay_file (config);
+        if (replay_file == NULL)
+                return gclue_wpa_scanner_new ();
+
+        scanner = gclue_replay_scanner_new
+                (replay_file,
+                 gclue_config_get_wifi_replay_speed (config),
+                 &error);
+        if (scanner == NULL) {
+                g_warning ("Failed to load WiFi replay file: %s",
+                           error->message);
+                g_error_free (error);
+        }
+
+        return scanner;
+}
+
+/**
+ * gclue_wifi_scanner_get_singleton:
+ *
+ * Get the #GClueWifiScanner singleton, as configured.
+ *
+ * Returns: (transfer full): a new ref to #GClueWifiScanner, or %NULL if it
+ * could not be created. Use g_object_unref() when done.
+ **/
+GClueWifiScanner *
+gclue_wifi_scanner_get_singleton (void)
+{
+        static GClueWifiScanner *scanner = NULL;
+
+        if (scanner == NULL) {
+                scanner = create_scanner ();
+                if (scanner != NULL)
+                        g_object_weak_ref (G_OBJECT (scanner),
+                                           on_scanner_destroyed,
+                                           &scanner);
+        } else
+                g_object_ref (scanner);
+
+        return scanner;
+}
@@ -0,0 +1,76 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wifi-scanner.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef GCLUE_WIFI_SCANNER_H
+#define GCLUE_WIFI_SCANNER_H
+
+#include <gio/gio.h>
+#include "gclue-wifi-scan.h"
+
+G_BEGIN_DECLS
+
+GType gclue_wifi_scanner_get_type (void) G_GNUC_CONST;
+
+#define GCLUE_TYPE_WIFI_SCANNER               (gclue_wifi_scanner_get_type ())
+#define GCLUE_WIFI_SCANNER(obj)               (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WIFI_SCANNER, GClueWifiScanner))
+#define GCLUE_IS_WIFI_SCANNER(obj)            (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_WIFI_SCANNER))
+#define GCLUE_WIFI_SCANNER_GET_INTERFACE(obj) (G_TYPE_INSTANCE_GET_INTERFACE ((obj), GCLUE_TYPE_WIFI_SCANNER, GClueWifiScannerInterface))
+
+typedef struct _GClueWifiScanner          GClueWifiScanner;
+typedef struct _GClueWifiScannerInterface GClueWifiScannerInterface;
+
+struct _GClueWifiScannerInterface {
+        /* <private> */
+        GTypeInterface parent_iface;
+
+        gboolean     (*get_is_ready)     (GClueWifiScanner    *scanner);
+        gboolean     (*get_has_devices)  (GClueWifiScanner    *scanner);
+        GHashTable * (*get_bss_records)  (GClueWifiScanner    *scanner);
+        gint64       (*get_scan_started) (GClueWifiScanner    *scanner);
+        guint        (*get_scan_id)      (GClueWifiScanner    *scanner);
+        gboolean     (*get_sets_pace)    (GClueWifiScanner    *scanner);
+        void         (*start)            (GClueWifiScanner    *scanner);
+        void         (*stop)             (GClueWifiScanner    *scanner);
+        guint        (*scan)             (GClueWifiScanner    *scanner,
+                                          const GClueWifiScan *last_scan,
+                                          gboolean             active,
+                                          gboolean             full);
+};
+
+GClueWifiScanner *
+             gclue_wifi_scanner_get_singleton    (void);
+gboolean     gclue_wifi_scanner_get_is_ready     (GClueWifiScanner    *scanner);
+gboolean     gclue_wifi_scanner_get_has_devices  (GClueWifiScanner    *scanner);
+GHashTable * gclue_wifi_scanner_get_bss_records  (GClueWifiScanner    *scanner);
+gint64       gclue_wifi_scanner_get_scan_started (GClueWifiScanner    *scanner);
+guint        gclue_wifi_scanner_get_scan_id      (GClueWifiScanner    *scanner);
+gboolean     gclue_wifi_scanner_get_sets_pace    (GClueWifiScanner    *scanner);
+void         gclue_wifi_scanner_start            (GClueWifiScanner    *scanner);
+void         gclue_wifi_scanner_stop             (GClueWifiScanner    *scanner);
+guint        gclue_wifi_scanner_scan             (GClueWifiScanner    *scanner,
+                                                  const GClueWifiScan *last_scan,
+                                                  gboolean             active,
+                                                  gboolean             full);
+
+G_END_DECLS
+
+#endif /* GCLUE_WIFI_SCANNER_H */
@@ -27,16 +27,23 @@
 #include "gclue-config.h"
 #include "gclue-error.h"
 #include "gclue-mozilla.h"
+#include "gclue-wifi-scan.h"
+#include "gclue-wifi-cache.h"
+#include "gclue-wifi-ap-store.h"
+#include "gclue-scan-scheduler.h"
+#include "gclue-wifi-scanner.h"
+#include "gclue-cell-registry.h"
 
 #define WIFI_SCAN_TIMEOUT_HIGH_ACCURACY 10
 /* Since this is only used for city-level accuracy, 5 minutes betweeen each
  * scan is more than enough.
  */
 #define WIFI_SCAN_TIMEOUT_LOW_ACCURACY  300
-
-#define BSSID_LEN 7
-#define BSSID_STR_LEN 18
-#define MAX_SSID_LEN 32
+/* How far we back off while the device doesn't seem to move */
+#define WIFI_SCAN_TIMEOUT_HIGH_ACCURACY_MAX 160
+#define WIFI_SCAN_TIMEOUT_LOW_ACCURACY_MAX  1200
+/* Recent scan to location latencies to report percentiles of */
+#define LATENCY_SAMPLES 100
 
 /**
  * SECTION:gclue-wifi
@@ -52,17 +59,27 @@ static gboolean
 gclue_wifi_stop (GClueLocationSource *source);
 
 struct _GClueWifiPrivate {
-        WPASupplicant *supplicant;
-        WPAInterface *interface;
-        GHashTable *bss_proxies;
-        GHashTable *ignored_bss_proxies;
+        GClueWifiScanner *scanner;
+        gboolean started;
         gboolean bss_list_changed;
 
-        gulong bss_added_id;
-        gulong bss_removed_id;
-        gulong scan_done_id;
-
         guint scan_timeout;
+        guint scan_id;        /* Of the scan we asked for, 0 if none */
+        GClueScanScheduler *scheduler;
+        GClueWifiScan *scan;  /* Snapshot of the last scan */
+        GArray *scan_samples; /* BSS set of the last scan, as BSSSample */
+
+        GClueWifiCache *cache;
+        GClueWifiAPStore *ap_store;
+        GClueWifiScan *query_scan; /* Snapshot of the last query */
+        GClueCellRegistry *cell_registry; /* Street level only */
+
+        GArray *last_samples; /* BSS set we last looked up, as BSSSample */
+        guint n_changes;
+        guint n_refreshes;
+
+        gint64 latencies[LATENCY_SAMPLES]; /* Microseconds, as a ring */
+        guint n_latencies;
 
         GClueAccuracyLevel accuracy_level;
 };
@@ -78,14 +95,20 @@ static GParamSpec *gParamSpecs[LAST_PROP];
 static SoupMessage *
 gclue_wifi_create_query (GClueWebSource *source,
                          GError        **error);
-static SoupMessage *
-gclue_wifi_create_submit_query (GClueWebSource  *source,
-                                GClueLocation   *location,
-                                GError         **error);
+static GClueSubmission *
+gclue_wifi_create_submission (GClueWebSource  *source,
+                              GClueLocation   *location,
+                              GError         **error);
 static GClueLocation *
 gclue_wifi_parse_response (GClueWebSource *source,
                            const char     *json,
                            GError        **error);
+static void
+gclue_wifi_learn_location (GClueWebSource *source,
+                           GClueLocation  *location);
+static void
+gclue_wifi_accept_location (GClueWebSource *source,
+                            GClueLocation  *location);
 static GClueAccuracyLevel
 gclue_wifi_get_available_accuracy_level (GClueWebSource *source,
                                          gboolean        net_available);
@@ -96,15 +119,7 @@ G_DEFINE_TYPE_WITH_CODE (GClueWifi,
                          G_ADD_PRIVATE (GClueWifi))
 
 static void
-disconnect_bss_signals (GClueWifi *wifi);
-static void
-on_scan_call_done (GObject      *source_object,
-                   GAsyncResult *res,
-                   gpointer      user_data);
-static void
-on_scan_done (WPAInterface *object,
-              gboolean      success,
-              gpointer      user_data);
+stop_scanning (GClueWifi *wifi);
 
 static void
 gclue_wifi_finalize (GObject *gwifi)
@@ -113,11 +128,21 @@ gclue_wifi_finalize (GObject *gwifi)
 
         G_OBJECT_CLASS (gclue_wifi_parent_class)->finalize (gwifi);
 
-        disconnect_bss_signals (wifi);
-        g_clear_object (&wifi->priv->supplicant);
-        g_clear_object (&wifi->priv->interface);
-        g_clear_pointer (&wifi->priv->bss_proxies, g_hash_table_unref);
-        g_clear_pointer (&wifi->priv->ignored_bss_proxies, g_hash_table_unref);
+        stop_scanning (wifi);
+        if (wifi->priv->scanner != NULL)
+                g_signal_handlers_disconnect_by_data (wifi->priv->scanner,
+                                                      wifi);
+        g_clear_object (&wifi->priv->scanner);
+        if (wifi->priv->cell_registry != NULL)
+                g_signal_handlers_disconnect_by_data
+                        (wifi->priv->cell_registry, wifi);
+        g_clear_object (&wifi->priv->cell_registry);
+        g_clear_pointer (&wifi->priv->scan, gclue_wifi_scan_unref);
+        g_clear_pointer (&wifi->priv->query_scan, gclue_wifi_scan_unref);
+        g_clear_pointer (&wifi->priv->last_samples, g_array_unref);
+        g_clear_object (&wifi->priv->scheduler);
+        g_clear_object (&wifi->priv->cache);
+        g_clear_object (&wifi->priv->ap_store);
 }
 
 static void
@@ -168,11 +193,13 @@ gclue_wifi_class_init (GClueWifiClass *klass)
 
         source_class->start = gclue_wifi_start;
         source_class->stop = gclue_wifi_stop;
-        web_class->create_submit_query = gclue_wifi_create_submit_query;
+        web_class->create_submission = gclue_wifi_create_submission;
         web_class->create_query = gclue_wifi_create_query;
         web_class->parse_response = gclue_wifi_parse_response;
         web_class->get_available_accuracy_level =
                 gclue_wifi_get_available_accuracy_level;
+        web_class->learn_location = gclue_wifi_learn_location;
+        web_class->accept_location = gclue_wifi_accept_location;
         gwifi_class->get_property = gclue_wifi_get_property;
         gwifi_class->set_property = gclue_wifi_set_property;
         gwifi_class->finalize = gclue_wifi_finalize;
@@ -190,224 +217,300 @@ gclue_wifi_class_init (GClueWifiClass *klass)
                                          gParamSpecs[PROP_ACCURACY_LEVEL]);
 }
 
-static void
-on_bss_added (WPAInterface *object,
-              const gchar  *path,
-              GVariant     *properties,
-              gpointer      user_data);
+typedef struct {
+        guint64 bssid;
+        gdouble weight;
+} BSSSample;
 
-static guint
-variant_to_string (GVariant *variant, guint max_len, char *ret)
+static gint
+compare_samples (gconstpointer a,
+                 gconstpointer b)
 {
-        guint i;
-        guint len;
-
-        len = g_variant_n_children (variant);
-        if (len == 0)
-                return 0;
-        g_return_val_if_fail(len < max_len, 0);
-        ret[len] = '\0';
+        const BSSSample *sample_a = a;
+        const BSSSample *sample_b = b;
 
-        for (i = 0; i < len; i++)
-                g_variant_get_child (variant,
-                                     i,
-                                     "y",
-                                     &ret[i]);
+        if (sample_a->bssid < sample_b->bssid)
+                return -1;
 
-        return len;
+        return (sample_a->bssid > sample_b->bssid) ? 1 : 0;
 }
 
-static guint
-get_ssid_from_bss (WPABSS *bss, char *ssid)
+/* Returns BSS set of the last scan as BSSSample array, sorted by BSSID */
+static GArray *
+get_bss_samples (GClueWifi            *wifi,
+                 GClueWifiChangeMetric metric)
 {
-        GVariant *variant = wpa_bss_get_ssid (bss);
+        GClueWifiScan *scan = wifi->priv->scan;
+        GArray *samples;
+        guint i, n_bss;
+
+        n_bss = (scan != NULL) ? scan->n_bss : 0;
+        samples = g_array_sized_new (FALSE,
+                                     FALSE,
+                                     sizeof (BSSSample),
+                                     n_bss);
+
+        /* Snapshot is already sorted by BSSID */
+        for (i = 0; i < n_bss; i++) {
+                const GClueWifiBSS *bss = &scan->bss[i];
+                BSSSample sample;
+
+                sample.bssid = bss->bssid;
+                /* Linear in dB above the noise floor, so the strong (and
+                 * therefore near) APs dominate and the flickering weak ones
+                 * at the edge of range hardly matter.
+                 */
+                if (metric == GCLUE_WIFI_CHANGE_METRIC_WEIGHTED_JACCARD)
+                        sample.weight = CLAMP (bss->signal + 100, 1, 70);
+                else
+                        sample.weight = 1.0;
+
+                g_array_append_val (samples, sample);
+        }
 
-        return variant_to_string (variant, MAX_SSID_LEN, ssid);
+        return samples;
 }
 
-static gboolean
-get_bssid_from_bss (WPABSS *bss, char *bssid)
+/* (Weighted) Jaccard similarity of two sorted BSSSample arrays */
+static gdouble
+get_similarity (GArray *a,
+                GArray *b)
 {
-        GVariant *variant;
-        char raw_bssid[BSSID_LEN] = { 0 };
-        guint raw_len, i;
-
-        variant = wpa_bss_get_bssid (bss);
-        if (variant == NULL)
-                return FALSE;
-
-        raw_len = variant_to_string (variant, BSSID_LEN, raw_bssid);
-        g_return_val_if_fail (raw_len == BSSID_LEN - 1, FALSE);
-
-        for (i = 0; i < BSSID_LEN - 1; i++) {
-                unsigned char c = (unsigned char) raw_bssid[i];
-
-                if (i == BSSID_LEN - 2) {
-                        g_snprintf (bssid + (i * 3), 3, "%02x", c);
+        gdouble intersection = 0, union_ = 0;
+        guint i = 0, j = 0;
+
+        while (i < a->len || j < b->len) {
+                BSSSample *sample_a = NULL, *sample_b = NULL;
+                gint cmp;
+
+                if (i < a->len)
+                        sample_a = &g_array_index (a, BSSSample, i);
+                if (j < b->len)
+                        sample_b = &g_array_index (b, BSSSample, j);
+
+                if (sample_a == NULL)
+                        cmp = 1;
+                else if (sample_b == NULL)
+                        cmp = -1;
+                else
+                        cmp = compare_samples (sample_a, sample_b);
+
+                if (cmp < 0) {
+                        union_ += sample_a->weight;
+                        i++;
+                } else if (cmp > 0) {
+                        union_ += sample_b->weight;
+                        j++;
                 } else {
-                        g_snprintf (bssid + (i * 3), 4, "%02x:", c);
+                        intersection += MIN (sample_a->weight,
+                                             sample_b->weight);
+                        union_ += MAX (sample_a->weight, sample_b->weight);
+                        i++;
+                        j++;
                 }
         }
 
-        return TRUE;
+        if (union_ == 0)
+                return 1.0;
+
+        return intersection / union_;
 }
 
-static void
-add_bss_proxy (GClueWifi *wifi,
-               WPABSS    *bss)
+/* Checks if the BSS set drifted enough from the one we last looked up, to
+ * be worth looking up again.
+ */
+static gboolean
+bss_set_changed_significantly (GClueWifi *wifi)
 {
-        const char *path;
-
-        path = g_dbus_proxy_get_object_path (G_DBUS_PROXY (bss));
-        if (g_hash_table_replace (wifi->priv->bss_proxies,
-                                  g_strdup (path),
-                                  bss)) {
-                char ssid[MAX_SSID_LEN] = { 0 };
+        GClueWifiPrivate *priv = wifi->priv;
+        GClueConfig *config = gclue_config_get_singleton ();
+        GClueWifiChangeMetric metric;
+        gdouble threshold, similarity = 0.0;
+        gboolean significant = TRUE;
+        GArray *samples;
+
+        metric = gclue_config_get_wifi_change_metric (config);
+        threshold = gclue_config_get_wifi_change_threshold (config);
+        samples = get_bss_samples (wifi, metric);
+
+        if (priv->last_samples != NULL &&
+            metric != GCLUE_WIFI_CHANGE_METRIC_ANY) {
+                similarity = get_similarity (priv->last_samples, samples);
+                significant = similarity < threshold;
+        }
 
-                wifi->priv->bss_list_changed = TRUE;
-                get_ssid_from_bss (bss, ssid);
-                g_debug ("WiFi AP '%s' added.", ssid);
+        priv->n_changes++;
+        if (significant) {
+                priv->n_refreshes++;
+                g_clear_pointer (&priv->last_samples, g_array_unref);
+                priv->last_samples = samples;
+        } else {
+                g_array_unref (samples);
         }
+
+        g_debug ("WiFi AP set similarity to last lookup: %.2f (threshold "
+                 "%.2f), %s. %u of %u changes triggered a lookup.",
+                 similarity,
+                 threshold,
+                 significant ? "looking up" : "ignoring",
+                 priv->n_refreshes,
+                 priv->n_changes);
+
+        return significant;
 }
 
+/* Lets the scheduler know how much the BSS set drifted since last scan */
 static void
-on_bss_signal_notify (GObject    *gobject,
-                      GParamSpec *pspec,
-                      gpointer    user_data)
+report_scan_drift (GClueWifi *wifi)
 {
-        GClueWifi *wifi = GCLUE_WIFI (user_data);
-        WPABSS *bss = WPA_BSS (gobject);
-        const char *path;
+        GClueWifiPrivate *priv = wifi->priv;
+        GArray *samples;
+        gdouble drift;
 
-        if (wpa_bss_get_signal (bss) <= -90) {
-                char bssid[BSSID_STR_LEN] = { 0 };
+        if (!priv->bss_list_changed && priv->scan_samples != NULL) {
+                gclue_scan_scheduler_report_drift (priv->scheduler, 0.0);
 
-                get_bssid_from_bss (bss, bssid);
-                g_debug ("WiFi AP '%s' still has very low strength (%u dBm)"
-                         ", ignoring again..",
-                         bssid,
-                         wpa_bss_get_signal (bss));
                 return;
         }
 
-        g_signal_handlers_disconnect_by_func (G_OBJECT (bss),
-                                              on_bss_signal_notify,
-                                              user_data);
-        add_bss_proxy (wifi, g_object_ref (bss));
-        path = g_dbus_proxy_get_object_path (G_DBUS_PROXY (bss));
-        g_hash_table_remove (wifi->priv->ignored_bss_proxies, path);
+        samples = get_bss_samples (wifi,
+                                   GCLUE_WIFI_CHANGE_METRIC_WEIGHTED_JACCARD);
+        if (priv->scan_samples != NULL) {
+                drift = 1.0 - get_similarity (priv->scan_samples, samples);
+                gclue_scan_scheduler_report_drift (priv->scheduler, drift);
+        }
+
+        g_clear_pointer (&priv->scan_samples, g_array_unref);
+        priv->scan_samples = samples;
 }
 
+/* Takes a snapshot of the visible APs, leaving out the ones that are too weak
+ * to be useful and the ones wpa_supplicant still knows about but didn't see
+ * recently. The AP records are shared with other consumers of the scanner,
+ * so whether the set changed is decided from our own snapshots.
+ */
 static void
-on_bss_proxy_ready (GObject      *source_object,
-                    GAsyncResult *res,
-                    gpointer      user_data)
+take_snapshot (GClueWifi *wifi)
 {
-        GClueWifi *wifi = GCLUE_WIFI (user_data);
-        WPABSS *bss;
-        GError *error = NULL;
-        char ssid[MAX_SSID_LEN] = { 0 };
-
-        bss = wpa_bss_proxy_new_for_bus_finish (res, &error);
-        if (bss == NULL) {
-                g_debug ("%s", error->message);
-                g_error_free (error);
-
-                return;
-        }
+        GClueWifiPrivate *priv = wifi->priv;
+        GClueConfig *config = gclue_config_get_singleton ();
+        GHashTable *bss_records;
+        GClueWifiScan *scan;
+        gint weak_signal;
+        gint64 scan_started, seen_since = 0;
 
-        if (gclue_mozilla_should_ignore_bss (bss)) {
-                g_object_unref (bss);
+        weak_signal = gclue_config_get_wifi_weak_signal (config);
 
-                return;
-        }
+        /* Of the scan itself, which may have been started by the other WiFi
+         * source before we joined it.
+         */
+        scan_started = gclue_wifi_scanner_get_scan_started (priv->scanner);
+        if (scan_started != 0)
+                seen_since = scan_started -
+                             (gint64) gclue_config_get_wifi_max_bss_age
+                                        (config) * G_USEC_PER_SEC;
+
+        bss_records = gclue_wifi_scanner_get_bss_records (priv->scanner);
+        scan = gclue_wifi_scan_new (bss_records, weak_signal, seen_since);
+        if (scan->n_bss < g_hash_table_size (bss_records))
+                g_debug ("Ignoring %u of %u WiFi APs with signal at or "
+                         "below %d dBm or not seen in the last scan",
+                         g_hash_table_size (bss_records) - scan->n_bss,
+                         g_hash_table_size (bss_records),
+                         weak_signal);
+
+        if (!gclue_wifi_scan_has_same_bss (priv->scan, scan))
+                priv->bss_list_changed = TRUE;
+        g_clear_pointer (&priv->scan, gclue_wifi_scan_unref);
+        priv->scan = scan;
+}
 
-        get_ssid_from_bss (bss, ssid);
-        g_debug ("WiFi AP '%s' added.", ssid);
-
-        if (wpa_bss_get_signal (bss) <= -90) {
-                const char *path;
-                char bssid[BSSID_STR_LEN] = { 0 };
-
-                get_bssid_from_bss (bss, bssid);
-                g_debug ("WiFi AP '%s' has very low strength (%u dBm)"
-                         ", ignoring for now..",
-                         bssid,
-                         wpa_bss_get_signal (bss));
-                g_signal_connect (G_OBJECT (bss),
-                                  "notify::signal",
-                                  G_CALLBACK (on_bss_signal_notify),
-                                  user_data);
-                path = g_dbus_proxy_get_object_path (G_DBUS_PROXY (bss));
-                g_hash_table_replace (wifi->priv->ignored_bss_proxies,
-                                      g_strdup (path),
-                                      bss);
-                return;
-        }
+static int
+compare_latencies (const void *a,
+                   const void *b)
+{
+        gint64 latency_a = *(const gint64 *) a;
+        gint64 latency_b = *(const gint64 *) b;
 
-        add_bss_proxy (wifi, bss);
+        return (latency_a > latency_b) - (latency_a < latency_b);
 }
 
+/* Logs how long it took from @scan to a location, along with the median and
+ * 99th percentile of the recent ones.
+ */
 static void
-on_bss_added (WPAInterface *object,
-              const gchar  *path,
-              GVariant     *properties,
-              gpointer      user_data)
+report_latency (GClueWifi           *wifi,
+                const GClueWifiScan *scan,
+                const char          *how)
 {
-        wpa_bss_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-                                   G_DBUS_PROXY_FLAGS_NONE,
-                                   "fi.w1.wpa_supplicant1",
-                                   path,
-                                   NULL,
-                                   on_bss_proxy_ready,
-                                   user_data);
+        GClueWifiPrivate *priv = wifi->priv;
+        gint64 sorted[LATENCY_SAMPLES];
+        gint64 latency;
+        guint n;
+
+        latency = g_get_monotonic_time () - scan->time;
+        priv->latencies[priv->n_latencies % LATENCY_SAMPLES] = latency;
+        priv->n_latencies++;
+
+        n = MIN (priv->n_latencies, LATENCY_SAMPLES);
+        memcpy (sorted, priv->latencies, n * sizeof (gint64));
+        qsort (sorted, n, sizeof (gint64), compare_latencies);
+
+        g_debug ("Location %s %" G_GINT64_FORMAT " ms after the scan, "
+                 "p50 %" G_GINT64_FORMAT " ms and p99 %" G_GINT64_FORMAT
+                 " ms of the last %u",
+                 how,
+                 latency / 1000,
+                 sorted[(n - 1) / 2] / 1000,
+                 sorted[(n - 1) * 99 / 100] / 1000,
+                 n);
 }
 
+/* Tries to find out the location without asking the geolocation service,
+ * from the cache first and then from the positions of the APs we learned.
+ */
 static gboolean
-remove_bss_from_hashtable (const gchar *path, GHashTable *hash_table)
+set_location_locally (GClueWifi *wifi)
 {
-        char ssid[MAX_SSID_LEN] = { 0 };
-        WPABSS *bss = NULL;
+        GClueWifiPrivate *priv = wifi->priv;
+        GClueLocation *location;
 
-        bss = g_hash_table_lookup (hash_table, path);
-        if (bss == NULL)
+        if (priv->scan == NULL)
                 return FALSE;
 
-        get_ssid_from_bss (bss, ssid);
-        g_debug ("WiFi AP '%s' removed.", ssid);
+        location = gclue_wifi_cache_lookup (priv->cache, priv->scan);
+        if (location == NULL)
+                location = gclue_wifi_ap_store_locate (priv->ap_store,
+                                                       priv->scan);
+        if (location == NULL)
+                return FALSE;
 
-        g_hash_table_remove (hash_table, path);
+        report_latency (wifi, priv->scan, "found locally");
+        gclue_location_source_set_location (GCLUE_LOCATION_SOURCE (wifi),
+                                            location);
+        g_object_unref (location);
 
         return TRUE;
 }
 
-static void
-on_bss_removed (WPAInterface *object,
-                const gchar  *path,
-                gpointer      user_data)
+/* Whether there is any WiFi device to scan with */
+static gboolean
+has_devices (GClueWifi *wifi)
 {
-        GClueWifiPrivate *priv = GCLUE_WIFI (user_data)->priv;
-
-        if (remove_bss_from_hashtable (path, priv->bss_proxies))
-                priv->bss_list_changed = TRUE;
-        remove_bss_from_hashtable (path, priv->ignored_bss_proxies);
+        return wifi->priv->scanner != NULL &&
+               gclue_wifi_scanner_get_has_devices (wifi->priv->scanner);
 }
 
-static void
-cancel_wifi_scan (GClueWifi *wifi)
+/* A street-level client is waiting for its first location, so it's worth
+ * actively probing for APs rather than waiting for their beacons.
+ */
+static gboolean
+waiting_for_first_fix (GClueWifi *wifi)
 {
-        GClueWifiPrivate *priv = wifi->priv;
-
-        if (priv->scan_timeout != 0) {
-                g_source_remove (priv->scan_timeout);
-                priv->scan_timeout = 0;
-        }
+        GClueLocationSource *source = GCLUE_LOCATION_SOURCE (wifi);
 
-        if (priv->scan_done_id != 0) {
-                g_signal_handler_disconnect (priv->interface,
-                                             priv->scan_done_id);
-                priv->scan_done_id = 0;
-        }
+        return wifi->priv->accuracy_level != GCLUE_ACCURACY_LEVEL_CITY &&
+               gclue_location_source_get_location (source) == NULL;
 }
 
 static gboolean
@@ -415,70 +518,81 @@ on_scan_timeout (gpointer user_data)
 {
         GClueWifi *wifi = GCLUE_WIFI (user_data);
         GClueWifiPrivate *priv = wifi->priv;
-        GVariantBuilder builder;
-        GVariant *args;
+        gboolean active, full;
 
-        if (priv->interface == NULL)
+        if (!has_devices (wifi))
                 return FALSE;
 
         g_debug ("WiFi scan timeout. Restarting-scan..");
         priv->scan_timeout = 0;
 
-        if (priv->scan_done_id == 0)
-                priv->scan_done_id = g_signal_connect
-                                        (priv->interface,
-                                         "scan-done",
-                                         G_CALLBACK (on_scan_done),
-                                         wifi);
-
-        g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-        g_variant_builder_add (&builder,
-                               "{sv}",
-                               "Type", g_variant_new ("s", "passive"));
-        args = g_variant_builder_end (&builder);
-
-        wpa_interface_call_scan (WPA_INTERFACE (priv->interface),
-                                 args,
-                                 NULL,
-                                 on_scan_call_done,
-                                 wifi);
+        full = gclue_scan_scheduler_next_scan_is_full (priv->scheduler);
+        active = waiting_for_first_fix (wifi);
+        if (active)
+                full = TRUE;
+        g_debug ("Starting %s %s WiFi scan",
+                 full ? "full" : "targeted",
+                 active ? "active" : "passive");
+        priv->scan_id = gclue_wifi_scanner_scan (priv->scanner,
+                                                 priv->scan,
+                                                 active,
+                                                 full);
 
         return FALSE;
 }
 
+/* Called once scans on all the devices are done */
 static void
-on_scan_done (WPAInterface *object,
-              gboolean      success,
-              gpointer      user_data)
+on_scan_done (GClueWifiScanner *scanner,
+              gboolean          success,
+              gpointer          user_data)
 {
         GClueWifi *wifi = GCLUE_WIFI (user_data);
         GClueWifiPrivate *priv = wifi->priv;
         guint timeout;
 
-        if (!success) {
-                g_warning ("WiFi scan failed");
-
+        /* The scanner is shared, so this might be a scan for another
+         * consumer, or one the scanner did by itself. We only look at the
+         * results at our own pace, unless the scanner sets it.
+         */
+        if (gclue_wifi_scanner_get_sets_pace (scanner)) {
+                if (!priv->started)
+                        return;
+        } else if (priv->scan_id == 0 ||
+                   gclue_wifi_scanner_get_scan_id (scanner) != priv->scan_id) {
                 return;
         }
-        g_debug ("WiFi scan completed");
+        priv->scan_id = 0;
 
-        if (priv->interface == NULL)
-                return;
+        /* Try again later rather than give up */
+        if (!success)
+                goto schedule_scan;
+
+        take_snapshot (wifi);
+        report_scan_drift (wifi);
 
         if (priv->bss_list_changed) {
                 priv->bss_list_changed = FALSE;
-                g_debug ("Refreshing location..");
-                gclue_web_source_refresh (GCLUE_WEB_SOURCE (wifi));
+
+                /* A marginal AP coming and going doesn't mean we moved */
+                if (!bss_set_changed_significantly (wifi))
+                        goto schedule_scan;
+
+                /* We have most likely been here before so try to avoid a
+                 * round-trip to the geolocation service. This also keeps us
+                 * going while we are offline.
+                 */
+                if (!set_location_locally (wifi)) {
+                        g_debug ("Refreshing location..");
+                        gclue_web_source_refresh (GCLUE_WEB_SOURCE (wifi));
+                }
         }
 
-        /* With high-enough accuracy requests, we need to scan more often since
-         * user's location can change quickly. With low accuracy, we don't since
-         * we wouldn't want to drain power unnecessarily.
-         */
-        if (priv->accuracy_level >= GCLUE_ACCURACY_LEVEL_STREET)
-                timeout = WIFI_SCAN_TIMEOUT_HIGH_ACCURACY;
-        else
-                timeout = WIFI_SCAN_TIMEOUT_LOW_ACCURACY;
+schedule_scan:
+        if (gclue_wifi_scanner_get_sets_pace (scanner))
+                return;
+
+        timeout = gclue_scan_scheduler_next_interval (priv->scheduler);
         priv->scan_timeout = g_timeout_add_seconds (timeout,
                                                     on_scan_timeout,
                                                     wifi);
@@ -486,85 +600,51 @@ on_scan_done (WPAInterface *object,
 }
 
 static void
-on_scan_call_done (GObject      *source_object,
-                   GAsyncResult *res,
-                   gpointer      user_data)
-{
-        GClueWifi *wifi = GCLUE_WIFI (user_data);
-        GError *error = NULL;
-
-        if (!wpa_interface_call_scan_finish
-                (WPA_INTERFACE (source_object),
-                 res,
-                 &error)) {
-                g_warning ("Scanning of WiFi networks failed: %s",
-                           error->message);
-                g_error_free (error);
-
-                cancel_wifi_scan (wifi);
-
-                return;
-        }
-}
-
-static void
-connect_bss_signals (GClueWifi *wifi)
+start_scanning (GClueWifi *wifi)
 {
         GClueWifiPrivate *priv = wifi->priv;
-        const gchar *const *bss_list;
-        guint i;
 
-        if (priv->bss_added_id != 0)
+        if (priv->started)
                 return;
-        if (priv->interface == NULL) {
+        if (!has_devices (wifi)) {
                 gclue_web_source_refresh (GCLUE_WEB_SOURCE (wifi));
 
                 return;
         }
 
+        priv->started = TRUE;
+        gclue_wifi_scanner_start (priv->scanner);
+        if (priv->cell_registry != NULL)
+                gclue_cell_registry_set_combining (priv->cell_registry, TRUE);
+
+        gclue_scan_scheduler_reset (priv->scheduler);
         on_scan_timeout (wifi);
 
         priv->bss_list_changed = TRUE;
-        priv->bss_added_id = g_signal_connect (priv->interface,
-                                               "bss-added",
-                                               G_CALLBACK (on_bss_added),
-                                               wifi);
-        priv->bss_removed_id = g_signal_connect (priv->interface,
-                                                "bss-removed",
-                                                G_CALLBACK (on_bss_removed),
-                                                wifi);
-
-        bss_list = wpa_interface_get_bsss (WPA_INTERFACE (priv->interface));
-        if (bss_list == NULL)
-                return;
-
-        for (i = 0; bss_list[i] != NULL; i++)
-                on_bss_added (WPA_INTERFACE (priv->interface),
-                              bss_list[i],
-                              NULL,
-                              wifi);
 }
 
 static void
-disconnect_bss_signals (GClueWifi *wifi)
+stop_scanning (GClueWifi *wifi)
 {
         GClueWifiPrivate *priv = wifi->priv;
 
-        cancel_wifi_scan (wifi);
-
-        if (priv->bss_added_id != 0) {
-                g_signal_handler_disconnect (priv->interface,
-                                             priv->bss_added_id);
-                priv->bss_added_id = 0;
+        if (priv->scan_timeout != 0) {
+                g_source_remove (priv->scan_timeout);
+                priv->scan_timeout = 0;
         }
-        if (priv->bss_removed_id != 0) {
-                g_signal_handler_disconnect (priv->interface,
-                                             priv->bss_removed_id);
-                priv->bss_removed_id = 0;
+        priv->scan_id = 0;
+
+        if (priv->started) {
+                priv->started = FALSE;
+                gclue_wifi_scanner_stop (priv->scanner);
+                if (priv->cell_registry != NULL)
+                        gclue_cell_registry_set_combining
+                                (priv->cell_registry, FALSE);
         }
 
-        g_hash_table_remove_all (priv->bss_proxies);
-        g_hash_table_remove_all (priv->ignored_bss_proxies);
+        g_clear_pointer (&priv->last_samples, g_array_unref);
+        g_clear_pointer (&priv->scan_samples, g_array_unref);
+        g_clear_pointer (&priv->scan, gclue_wifi_scan_unref);
 }
 
 static gboolean
@@ -578,7 +658,7 @@ gclue_wifi_start (GClueLocationSource *source)
         if (!base_class->start (source))
                 return FALSE;
 
-        connect_bss_signals (GCLUE_WIFI (source));
+        start_scanning (GCLUE_WIFI (source));
         return TRUE;
 }
 
@@ -593,7 +673,7 @@ gclue_wifi_stop (GClueLocationSource *source)
         if (!base_class->stop (source))
                 return FALSE;
 
-        disconnect_bss_signals (GCLUE_WIFI (source));
+        stop_scanning (GCLUE_WIFI (source));
         return TRUE;
 }
 
@@ -603,9 +683,22 @@ gclue_wifi_get_available_accuracy_level (GClueWebSource *source,
 {
         GClueWifiPrivate *priv = GCLUE_WIFI (source)->priv;
 
-        if (!net_available)
+        /* Don't fall back to city level before we know if there is any WiFi
+         * device to do better with.
+         */
+        if (priv->scanner != NULL &&
+            !gclue_wifi_scanner_get_is_ready (priv->scanner))
                 return GCLUE_ACCURACY_LEVEL_NONE;
-        else if (priv->interface != NULL &&
+
+        /* Without network, we can only help with locations we have cached
+         * or APs we know the position of.
+         */
+        if (!net_available &&
+            (!has_devices (GCLUE_WIFI (source)) ||
+             (gclue_wifi_cache_is_empty (priv->cache) &&
+              gclue_wifi_ap_store_is_empty (priv->ap_store))))
+                return GCLUE_ACCURACY_LEVEL_NONE;
+        else if (has_devices (GCLUE_WIFI (source)) &&
                  priv->accuracy_level != GCLUE_ACCURACY_LEVEL_CITY)
                 return GCLUE_ACCURACY_LEVEL_STREET;
         else
@@ -613,79 +706,52 @@ gclue_wifi_get_available_accuracy_level (GClueWebSource *source,
 }
 
 static void
-on_interface_proxy_ready (GObject      *source_object,
-                          GAsyncResult *res,
-                          gpointer      user_data)
+on_scanner_ready (GObject    *object,
+                  GParamSpec *pspec,
+                  gpointer    user_data)
 {
-        GClueWifi *wifi = GCLUE_WIFI (user_data);
-        WPAInterface *interface;
-        GError *error = NULL;
-
-        interface = wpa_interface_proxy_new_for_bus_finish (res, &error);
-        if (interface == NULL) {
-                g_debug ("%s", error->message);
-                g_error_free (error);
-
-                return;
-        }
-
-        if (wifi->priv->interface != NULL) {
-                g_object_unref (interface);
-                return;
-        }
+        gclue_web_source_refresh (GCLUE_WEB_SOURCE (user_data));
+}
 
-        wifi->priv->interface = interface;
-        g_debug ("WiFi device '%s' added.",
-                 wpa_interface_get_ifname (interface));
+/* The 3G source leaves looking up the tower to us while we combine, but we
+ * only query again when the APs change. Without any APs around, the tower is
+ * all we have to go by though.
+ */
+static void
+on_tower_changed (GClueCellRegistry *registry,
+                  gpointer           user_data)
+{
+        GClueWifi *wifi = GCLUE_WIFI (user_data);
+        GClueWifiPrivate *priv = wifi->priv;
 
-        if (gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (wifi)))
-                connect_bss_signals (wifi);
-        else
+        if (priv->started && (priv->scan == NULL || priv->scan->n_bss == 0))
                 gclue_web_source_refresh (GCLUE_WEB_SOURCE (wifi));
 }
 
 static void
-on_interface_added (WPASupplicant *supplicant,
-                    const gchar   *path,
-                    GVariant      *properties,
-                    gpointer       user_data)
+on_device_added (GClueWifiScanner *scanner,
+                 gpointer          user_data)
 {
         GClueWifi *wifi = GCLUE_WIFI (user_data);
 
-        if (wifi->priv->interface != NULL)
-                return;
-
-        wpa_interface_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-                                         G_DBUS_PROXY_FLAGS_NONE,
-                                         "fi.w1.wpa_supplicant1",
-                                         path,
-                                         NULL,
-                                         on_interface_proxy_ready,
-                                         wifi);
+        /* If we are scanning already, it takes part from the next scan on */
+        if (!gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (wifi)))
+                gclue_web_source_refresh (GCLUE_WEB_SOURCE (wifi));
+        else if (!wifi->priv->started)
+                start_scanning (wifi);
 }
 
 static void
-on_interface_removed (WPASupplicant *supplicant,
-                      const gchar   *path,
-                      gpointer       user_data)
+on_device_removed (GClueWifiScanner *scanner,
+                   gpointer          user_data)
 {
         GClueWifi *wifi = GCLUE_WIFI (user_data);
-        GClueWifiPrivate *priv = wifi->priv;
-        const char *object_path;
 
-        if (priv->interface == NULL)
-                return;
-
-        object_path = g_dbus_proxy_get_object_path
-                        (G_DBUS_PROXY (priv->interface));
-        if (g_strcmp0 (object_path, path) != 0)
-                return;
-
-        g_debug ("WiFi device '%s' removed.",
-                 wpa_interface_get_ifname (priv->interface));
-
-        disconnect_bss_signals (wifi);
-        g_clear_object (&wifi->priv->interface);
+        if (!has_devices (wifi))
+                /* That was the last one */
+                stop_scanning (wifi);
+        else if (wifi->priv->started)
+                take_snapshot (wifi);
 
         gclue_web_source_refresh (GCLUE_WEB_SOURCE (wifi));
 }
@@ -695,14 +761,8 @@ gclue_wifi_init (GClueWifi *wifi)
 {
         wifi->priv = G_TYPE_INSTANCE_GET_PRIVATE ((wifi), GCLUE_TYPE_WIFI, GClueWifiPrivate);
 
-        wifi->priv->bss_proxies = g_hash_table_new_full (g_str_hash,
-                                                         g_str_equal,
-                                                         g_free,
-                                                         g_object_unref);
-        wifi->priv->ignored_bss_proxies = g_hash_table_new_full (g_str_hash,
-                                                                 g_str_equal,
-                                                                 g_free,
-                                                                 g_object_unref);
+        wifi->priv->cache = gclue_wifi_cache_get_singleton ();
+        wifi->priv->ap_store = gclue_wifi_ap_store_get_singleton ();
 }
 
 static void
@@ -710,11 +770,27 @@ gclue_wifi_constructed (GObject *object)
 {
         GClueWifi *wifi = GCLUE_WIFI (object);
         GClueWifiPrivate *priv = wifi->priv;
-        const gchar *const *interfaces;
-        GError *error = NULL;
+        GClueMinUINT *threshold;
 
         G_OBJECT_CLASS (gclue_wifi_parent_class)->constructed (object);
 
+        /* With high-enough accuracy requests, we need to scan more often since
+         * user's location can change quickly. With low accuracy, we don't since
+         * we wouldn't want to drain power unnecessarily.
+         */
+        threshold = gclue_location_source_get_time_threshold
+                        (GCLUE_LOCATION_SOURCE (wifi));
+        if (priv->accuracy_level >= GCLUE_ACCURACY_LEVEL_STREET)
+                priv->scheduler = gclue_scan_scheduler_new
+                        (WIFI_SCAN_TIMEOUT_HIGH_ACCURACY,
+                         WIFI_SCAN_TIMEOUT_HIGH_ACCURACY_MAX,
+                         threshold);
+        else
+                priv->scheduler = gclue_scan_scheduler_new
+                        (WIFI_SCAN_TIMEOUT_LOW_ACCURACY,
+                         WIFI_SCAN_TIMEOUT_LOW_ACCURACY_MAX,
+                         threshold);
+
         if (wifi->priv->accuracy_level == GCLUE_ACCURACY_LEVEL_CITY) {
                 GClueConfig *config = gclue_config_get_singleton ();
 
@@ -722,36 +798,34 @@ gclue_wifi_constructed (GObject *object)
                         goto refresh_n_exit;
         }
 
-        /* FIXME: We should be using async variant */
-        priv->supplicant = wpa_supplicant_proxy_new_for_bus_sync
-                        (G_BUS_TYPE_SYSTEM,
-                         G_DBUS_PROXY_FLAGS_NONE,
-                         "fi.w1.wpa_supplicant1",
-                         "/fi/w1/wpa_supplicant1",
-                         NULL,
-                         &error);
-        if (priv->supplicant == NULL) {
-                g_warning ("Failed to connect to wpa_supplicant service: %s",
-                           error->message);
-                g_error_free (error);
+        priv->scanner = gclue_wifi_scanner_get_singleton ();
+        if (priv->scanner == NULL)
                 goto refresh_n_exit;
-        }
 
-        g_signal_connect (priv->supplicant,
-                          "interface-added",
-                          G_CALLBACK (on_interface_added),
+        g_signal_connect (priv->scanner,
+                          "notify::is-ready",
+                          G_CALLBACK (on_scanner_ready),
+                          wifi);
+        g_signal_connect (priv->scanner,
+                          "device-added",
+                          G_CALLBACK (on_device_added),
                           wifi);
-        g_signal_connect (priv->supplicant,
-                          "interface-removed",
-                          G_CALLBACK (on_interface_removed),
+        g_signal_connect (priv->scanner,
+                          "device-removed",
+                          G_CALLBACK (on_device_removed),
+                          wifi);
+        g_signal_connect (priv->scanner,
+                          "scan-done",
+                          G_CALLBACK (on_scan_done),
                           wifi);
 
-        interfaces = wpa_supplicant_get_interfaces (priv->supplicant);
-        if (interfaces != NULL && interfaces[0] != NULL)
-                on_interface_added (priv->supplicant,
-                                    interfaces[0],
-                                    NULL,
-                                    wifi);
+        if (priv->accuracy_level != GCLUE_ACCURACY_LEVEL_CITY) {
+                priv->cell_registry = gclue_cell_registry_get_singleton ();
+                g_signal_connect (priv->cell_registry,
+                                  "tower-changed",
+                                  G_CALLBACK (on_tower_changed),
+                                  wifi);
+        }
 
 refresh_n_exit:
         gclue_web_source_refresh (GCLUE_WEB_SOURCE (object));
@@ -818,11 +892,30 @@ gclue_wifi_get_accuracy_level (GClueWifi *wifi)
         return wifi->priv->accuracy_level;
 }
 
-static GList *
-get_bss_list (GClueWifi *wifi,
-              GError   **error)
+/**
+ * gclue_wifi_report_speed:
+ * @wifi: a #GClueWifi
+ * @speed: Current speed estimate of the device, in meters per second
+ *
+ * Lets @wifi know how fast we are moving, so it can adapt its scan interval.
+ **/
+void
+gclue_wifi_report_speed (GClueWifi *wifi,
+                         gdouble    speed)
+{
+        g_return_if_fail (GCLUE_IS_WIFI (wifi));
+
+        if (wifi->priv->scheduler != NULL)
+                gclue_scan_scheduler_report_speed (wifi->priv->scheduler,
+                                                   speed);
+}
+
+/* Returns the snapshot of the last scan, if there is one with any APs */
+static GClueWifiScan *
+get_scan (GClueWifi *wifi,
+          GError   **error)
 {
-        if (wifi->priv->interface == NULL) {
+        if (!has_devices (wifi)) {
                 g_set_error_literal (error,
                                      G_IO_ERROR,
                                      G_IO_ERROR_FAILED,
@@ -830,21 +923,54 @@ get_bss_list (GClueWifi *wifi,
                 return NULL;
         }
 
-        return g_hash_table_get_values (wifi->priv->bss_proxies);
+        if (wifi->priv->scan == NULL || wifi->priv->scan->n_bss == 0)
+                return NULL;
+
+        return wifi->priv->scan;
 }
 
 static SoupMessage *
 gclue_wifi_create_query (GClueWebSource *source,
                          GError        **error)
 {
-        GList *bss_list; /* As in Access Points */
-        SoupMessage *msg;
+        GClueWifi *wifi = GCLUE_WIFI (source);
+        GClueWifiScan *scan, *selection;
+        const GClue3GTower *tower = NULL;
+        SoupMessage *query;
+        guint max_aps;
 
-        bss_list = get_bss_list (GCLUE_WIFI (source), NULL);
+        scan = get_scan (wifi, NULL);
 
-        msg = gclue_mozilla_create_query (bss_list, NULL, error);
-        g_list_free (bss_list);
-        return msg;
+        /* Send the cell tower along, so there is a single request getting
+         * an answer based on both.
+         */
+        if (wifi->priv->started && wifi->priv->cell_registry != NULL)
+                tower = gclue_cell_registry_get_tower
+                        (wifi->priv->cell_registry);
+        if (tower != NULL)
+                g_debug ("Including cell tower in WiFi query");
+
+        /* Remember what we asked for, so we can cache the answer */
+        g_clear_pointer (&wifi->priv->query_scan, gclue_wifi_scan_unref);
+        if (scan == NULL)
+                return gclue_mozilla_create_query (NULL, tower, error);
+        wifi->priv->query_scan = gclue_wifi_scan_ref (scan);
+
+        /* Beyond a couple dozen access points, the location doesn't get
+         * any better, only the request bigger.
+         */
+        max_aps = gclue_config_get_wifi_max_query_aps
+                (gclue_config_get_singleton ());
+        selection = gclue_wifi_scan_select (scan, max_aps);
+        if (selection != scan)
+                g_debug ("Querying with %u of %u access points",
+                         selection->n_bss,
+                         scan->n_bss);
+
+        query = gclue_mozilla_create_query (selection, tower, error);
+        gclue_wifi_scan_unref (selection);
+
+        return query;
 }
 
 static GClueLocation *
@@ -855,22 +981,51 @@ gclue_wifi_parse_response (GClueWebSource *source,
         return gclue_mozilla_parse_response (json, error);
 }
 
-static SoupMessage *
-gclue_wifi_create_submit_query (GClueWebSource  *source,
-                                GClueLocation   *location,
-                                GError         **error)
+/* Only the answer that won, the others are parsed too */
+static void
+gclue_wifi_accept_location (GClueWebSource *source,
+                            GClueLocation  *location)
 {
-        GList *bss_list; /* As in Access Points */
-        SoupMessage * msg;
+        GClueWifiPrivate *priv = GCLUE_WIFI (source)->priv;
 
-        bss_list = get_bss_list (GCLUE_WIFI (source), error);
-        if (bss_list == NULL)
+        if (priv->query_scan == NULL)
+                return;
+
+        gclue_wifi_cache_add (priv->cache, priv->query_scan, location);
+        report_latency (GCLUE_WIFI (source), priv->query_scan, "looked up");
+}
+
+static GClueSubmission *
+gclue_wifi_create_submission (GClueWebSource  *source,
+                              GClueLocation   *location,
+                              GError         **error)
+{
+        GClueWifiScan *scan;
+
+        scan = get_scan (GCLUE_WIFI (source), error);
+        if (scan == NULL)
                 return NULL;
 
-        msg = gclue_mozilla_create_submit_query (location,
-                                                 bss_list,
-                                                 NULL,
-                                                 error);
-        g_list_free (bss_list);
-        return msg;
+        return gclue_mozilla_create_submission (location,
+                                                scan,
+                                                NULL,
+                                                error);
+}
+
+static void
+gclue_wifi_learn_location (GClueWebSource *source,
+                           GClueLocation  *location)
+{
+        GClueWifi *wifi = GCLUE_WIFI (source);
+        GClueWifiScan *scan;
+
+        /* Both instances see the same APs, only one of them needs to learn */
+        if (wifi->priv->accuracy_level == GCLUE_ACCURACY_LEVEL_CITY)
+                return;
+
+        scan = get_scan (wifi, NULL);
+        if (scan == NULL)
+                return;
+
+        gclue_wifi_ap_store_learn (wifi->priv->ap_store, scan, location);
 }
@@ -64,6 +64,8 @@ struct _GClueWifiClass {
 
 GClueWifi *        gclue_wifi_get_singleton      (GClueAccuracyLevel level);
 GClueAccuracyLevel gclue_wifi_get_accuracy_level (GClueWifi *wifi);
+void               gclue_wifi_report_speed       (GClueWifi *wifi,
+                                                  gdouble    speed);
 
 G_END_DECLS
 
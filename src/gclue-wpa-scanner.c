@@ -0,0 +1,1086 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wpa-scanner.c
+ *
+ * Copyright 2014 Red Hat, Inc.
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Zeeshan Ali (Khattak) <zeeshanak@gnome.org>
+ *          agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+#include <string.h>
+#include "gclue-wpa-scanner.h"
+#include "gclue-wifi-bss.h"
+#include "gclue-mozilla.h"
+#include "wpa_supplicant-interface.h"
+
+/**
+ * SECTION:gclue-wpa-scanner
+ * @short_description: wpa_supplicant-based WiFi scanner
+ *
+ * Finds out about WiFi access points through wpa_supplicant, on all the WiFi
+ * devices it manages. Each access point is represented by the record with the
+ * strongest signal from all the devices seeing it.
+ **/
+
+static void
+gclue_wifi_scanner_interface_init (GClueWifiScannerInterface *iface);
+
+typedef struct {
+        WPAInterface *proxy;
+        guint64 index; /* N in /fi/w1/wpa_supplicant1/Interfaces/N */
+
+        gulong bss_added_id;
+        gulong bss_removed_id;
+        gulong scan_done_id;
+        gboolean scanning;
+} WifiInterface;
+
+struct _GClueWpaScannerPrivate {
+        WPASupplicant *supplicant;
+        GCancellable *cancellable;
+        gint64 connect_started;
+        guint proxies_pending;
+        gboolean ready;
+
+        GList *interfaces;       /* WifiInterface */
+        GHashTable *bss_paths;   /* Path ID => GClueWifiBSS, all interfaces */
+        GHashTable *bss_records; /* BSSID => GClueWifiBSS, merged */
+
+        guint n_users;
+        guint bss_properties_id;
+        GCancellable *bss_cancellable;
+
+        guint scans_pending;
+        gboolean scan_succeeded;
+        gint64 scan_started;
+        guint scan_id;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueWpaScanner,
+                         gclue_wpa_scanner,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GCLUE_TYPE_WIFI_SCANNER,
+                                                gclue_wifi_scanner_interface_init)
+                         G_ADD_PRIVATE (GClueWpaScanner))
+
+enum
+{
+        PROP_0,
+        PROP_IS_READY,
+        LAST_PROP
+};
+static GParamSpec *gParamSpecs[LAST_PROP];
+
+static void
+stop_watching (GClueWpaScanner *scanner);
+static void
+on_scan_call_done (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data);
+static void
+on_scan_done (WPAInterface *object,
+              gboolean      success,
+              gpointer      user_data);
+
+static void
+wifi_interface_free (WifiInterface *iface)
+{
+        g_object_unref (iface->proxy);
+        g_slice_free (WifiInterface, iface);
+}
+
+static void
+gclue_wpa_scanner_finalize (GObject *object)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (object);
+        GClueWpaScannerPrivate *priv = scanner->priv;
+
+        stop_watching (scanner);
+        g_cancellable_cancel (priv->cancellable);
+        g_clear_object (&priv->cancellable);
+        if (priv->supplicant != NULL)
+                g_signal_handlers_disconnect_by_data (priv->supplicant,
+                                                      scanner);
+        g_list_free_full (priv->interfaces,
+                          (GDestroyNotify) wifi_interface_free);
+        priv->interfaces = NULL;
+        g_clear_object (&priv->supplicant);
+        g_clear_pointer (&priv->bss_records, g_hash_table_unref);
+        g_clear_pointer (&priv->bss_paths, g_hash_table_unref);
+
+        G_OBJECT_CLASS (gclue_wpa_scanner_parent_class)->finalize (object);
+}
+
+static void
+gclue_wpa_scanner_get_property (GObject    *object,
+                                guint       prop_id,
+                                GValue     *value,
+                                GParamSpec *pspec)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (object);
+
+        switch (prop_id) {
+        case PROP_IS_READY:
+                g_value_set_boolean (value, scanner->priv->ready);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_wpa_scanner_constructed (GObject *object);
+
+static void
+gclue_wpa_scanner_class_init (GClueWpaScannerClass *klass)
+{
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        object_class->get_property = gclue_wpa_scanner_get_property;
+        object_class->finalize = gclue_wpa_scanner_finalize;
+        object_class->constructed = gclue_wpa_scanner_constructed;
+
+        g_object_class_override_property (object_class,
+                                          PROP_IS_READY,
+                                          "is-ready");
+        gParamSpecs[PROP_IS_READY] =
+                        g_object_class_find_property (object_class,
+                                                      "is-ready");
+}
+
+static void
+gclue_wpa_scanner_init (GClueWpaScanner *scanner)
+{
+        scanner->priv = G_TYPE_INSTANCE_GET_PRIVATE (scanner,
+                                                     GCLUE_TYPE_WPA_SCANNER,
+                                                     GClueWpaScannerPrivate);
+
+        scanner->priv->bss_paths = g_hash_table_new_full
+                (g_int64_hash,
+                 g_int64_equal,
+                 NULL,
+                 (GDestroyNotify) gclue_wifi_bss_free);
+        scanner->priv->bss_records = g_hash_table_new (g_int64_hash,
+                                                       g_int64_equal);
+        scanner->priv->cancellable = g_cancellable_new ();
+}
+
+static void
+emit_bss_list_changed (GClueWpaScanner *scanner)
+{
+        g_signal_emit_by_name (scanner, "bss-list-changed");
+}
+
+/* Returns the strongest record for @bssid among all interfaces */
+static GClueWifiBSS *
+find_strongest_bss (GClueWpaScanner *scanner,
+                    guint64          bssid)
+{
+        GHashTableIter iter;
+        GClueWifiBSS *bss, *strongest = NULL;
+
+        g_hash_table_iter_init (&iter, scanner->priv->bss_paths);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &bss)) {
+                if (bss->bssid != bssid)
+                        continue;
+
+                if (strongest == NULL || bss->signal > strongest->signal)
+                        strongest = bss;
+        }
+
+        return strongest;
+}
+
+/* Offers @bss for the merged table, where each AP is represented by the
+ * record with the strongest signal from all interfaces seeing it.
+ */
+static void
+merge_bss (GClueWpaScanner *scanner,
+           GClueWifiBSS    *bss)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        GClueWifiBSS *current;
+
+        current = g_hash_table_lookup (priv->bss_records, &bss->bssid);
+        if (current == NULL) {
+                g_hash_table_insert (priv->bss_records, &bss->bssid, bss);
+                g_debug ("WiFi AP '%s' added.", bss->ssid);
+                emit_bss_list_changed (scanner);
+        } else if (bss->signal > current->signal) {
+                g_hash_table_replace (priv->bss_records, &bss->bssid, bss);
+        }
+}
+
+/* Drops @bss, freeing it */
+static void
+remove_bss (GClueWpaScanner *scanner,
+            GClueWifiBSS    *bss)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        guint64 bssid = bss->bssid;
+        gboolean merged;
+        char ssid[GCLUE_WIFI_MAX_SSID_LEN + 1];
+
+        merged = (g_hash_table_lookup (priv->bss_records, &bssid) == bss);
+        if (merged) {
+                g_hash_table_remove (priv->bss_records, &bssid);
+                memcpy (ssid, bss->ssid, sizeof (ssid));
+        }
+        g_hash_table_remove (priv->bss_paths, &bss->path_id);
+        if (!merged)
+                return;
+
+        /* Another interface might still see the same AP */
+        bss = find_strongest_bss (scanner, bssid);
+        if (bss != NULL) {
+                g_hash_table_insert (priv->bss_records, &bss->bssid, bss);
+
+                return;
+        }
+
+        g_debug ("WiFi AP '%s' removed.", ssid);
+        emit_bss_list_changed (scanner);
+}
+
+static void
+add_bss (GClueWpaScanner *scanner,
+         GClueWifiBSS    *bss)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        GClueWifiBSS *old;
+
+        old = g_hash_table_lookup (priv->bss_paths, &bss->path_id);
+        if (old != NULL)
+                remove_bss (scanner, old);
+
+        g_hash_table_insert (priv->bss_paths, &bss->path_id, bss);
+        merge_bss (scanner, bss);
+}
+
+static void
+on_bss_properties_changed (GDBusConnection *connection,
+                           const gchar     *sender_name,
+                           const gchar     *object_path,
+                           const gchar     *interface_name,
+                           const gchar     *signal_name,
+                           GVariant        *parameters,
+                           gpointer         user_data)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (user_data);
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        GVariant *properties;
+        GClueWifiBSS *bss;
+        guint64 path_id;
+        gboolean signal_changed;
+
+        if (!gclue_wifi_bss_path_to_id (object_path, &path_id))
+                return;
+
+        bss = g_hash_table_lookup (priv->bss_paths, &path_id);
+        if (bss == NULL)
+                return;
+
+        properties = g_variant_get_child_value (parameters, 1);
+        signal_changed = gclue_wifi_bss_update (bss, properties);
+        g_variant_unref (properties);
+
+        /* Whether it is too weak is only decided once the scan is done */
+        if (!signal_changed ||
+            g_hash_table_lookup (priv->bss_records, &bss->bssid) == bss)
+                return;
+
+        merge_bss (scanner, bss);
+}
+
+static void
+add_bss_from_properties (GClueWpaScanner *scanner,
+                         const gchar     *path,
+                         GVariant        *properties)
+{
+        GClueWifiBSS *bss;
+
+        bss = gclue_wifi_bss_new (path, properties);
+        if (bss == NULL) {
+                g_debug ("Ignoring WiFi AP with unknown BSSID..");
+
+                return;
+        }
+
+        if (gclue_mozilla_should_ignore_bss (bss)) {
+                gclue_wifi_bss_free (bss);
+
+                return;
+        }
+
+        add_bss (scanner, bss);
+}
+
+typedef struct {
+        GClueWpaScanner *scanner;
+        char *path;
+} GetAllData;
+
+static void
+on_bss_get_all_ready (GObject      *source_object,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+        GetAllData *data = user_data;
+        GVariant *result, *properties;
+        GError *error = NULL;
+
+        result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+                                                res,
+                                                &error);
+        if (result == NULL) {
+                /* Cancelled means the scanner might be gone already */
+                if (!g_error_matches (error,
+                                      G_IO_ERROR,
+                                      G_IO_ERROR_CANCELLED))
+                        g_debug ("Failed to get properties of WiFi AP '%s': %s",
+                                 data->path,
+                                 error->message);
+                g_error_free (error);
+                goto out;
+        }
+
+        properties = g_variant_get_child_value (result, 0);
+        add_bss_from_properties (data->scanner, data->path, properties);
+        g_variant_unref (properties);
+        g_variant_unref (result);
+
+out:
+        g_free (data->path);
+        g_slice_free (GetAllData, data);
+}
+
+static void
+on_bss_added (WPAInterface *object,
+              const gchar  *path,
+              GVariant     *properties,
+              gpointer      user_data)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (user_data);
+        GetAllData *data;
+
+        /* BSSAdded hands us all the properties already */
+        if (properties != NULL) {
+                add_bss_from_properties (scanner, path, properties);
+
+                return;
+        }
+
+        data = g_slice_new (GetAllData);
+        data->scanner = scanner;
+        data->path = g_strdup (path);
+        g_dbus_connection_call (g_dbus_proxy_get_connection
+                                        (G_DBUS_PROXY (object)),
+                                "fi.w1.wpa_supplicant1",
+                                path,
+                                "org.freedesktop.DBus.Properties",
+                                "GetAll",
+                                g_variant_new ("(s)",
+                                               "fi.w1.wpa_supplicant1.BSS"),
+                                G_VARIANT_TYPE ("(a{sv})"),
+                                G_DBUS_CALL_FLAGS_NONE,
+                                -1,
+                                scanner->priv->bss_cancellable,
+                                on_bss_get_all_ready,
+                                data);
+}
+
+static void
+on_bss_removed (WPAInterface *object,
+                const gchar  *path,
+                gpointer      user_data)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (user_data);
+        GClueWifiBSS *bss;
+        guint64 path_id;
+
+        if (!gclue_wifi_bss_path_to_id (path, &path_id))
+                return;
+
+        bss = g_hash_table_lookup (scanner->priv->bss_paths, &path_id);
+        if (bss == NULL)
+                return;
+
+        remove_bss (scanner, bss);
+}
+
+/* Drops all APs seen through @iface */
+static void
+remove_interface_bsss (GClueWpaScanner *scanner,
+                       WifiInterface   *iface)
+{
+        GHashTableIter iter;
+        GClueWifiBSS *bss;
+        GList *stale = NULL, *l;
+
+        g_hash_table_iter_init (&iter, scanner->priv->bss_paths);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &bss)) {
+                if ((bss->path_id >> 32) == iface->index)
+                        stale = g_list_prepend (stale, bss);
+        }
+
+        for (l = stale; l != NULL; l = l->next)
+                remove_bss (scanner, l->data);
+        g_list_free (stale);
+}
+
+static WifiInterface *
+find_interface (GClueWpaScanner *scanner,
+                WPAInterface    *proxy)
+{
+        GList *l;
+
+        for (l = scanner->priv->interfaces; l != NULL; l = l->next) {
+                WifiInterface *iface = l->data;
+
+                if (iface->proxy == proxy)
+                        return iface;
+        }
+
+        return NULL;
+}
+
+static WifiInterface *
+find_interface_by_path (GClueWpaScanner *scanner,
+                        const char      *path)
+{
+        GList *l;
+
+        for (l = scanner->priv->interfaces; l != NULL; l = l->next) {
+                WifiInterface *iface = l->data;
+                const char *iface_path;
+
+                iface_path = g_dbus_proxy_get_object_path
+                                (G_DBUS_PROXY (iface->proxy));
+                if (g_strcmp0 (iface_path, path) == 0)
+                        return iface;
+        }
+
+        return NULL;
+}
+
+static void
+cancel_wifi_scan (GClueWpaScanner *scanner)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        GList *l;
+
+        for (l = priv->interfaces; l != NULL; l = l->next) {
+                WifiInterface *iface = l->data;
+
+                if (iface->scan_done_id != 0) {
+                        g_signal_handler_disconnect (iface->proxy,
+                                                     iface->scan_done_id);
+                        iface->scan_done_id = 0;
+                }
+                iface->scanning = FALSE;
+        }
+        priv->scans_pending = 0;
+}
+
+/* Frequencies (MHz) the APs of @scan were seen on through @iface */
+static GArray *
+get_interface_channels (const GClueWifiScan *scan,
+                        WifiInterface       *iface)
+{
+        GArray *channels;
+        guint i, j;
+
+        channels = g_array_new (FALSE, FALSE, sizeof (guint16));
+        if (scan == NULL)
+                return channels;
+
+        for (i = 0; i < scan->n_bss; i++) {
+                const GClueWifiBSS *bss = &scan->bss[i];
+
+                if ((bss->path_id >> 32) != iface->index ||
+                    bss->frequency == 0)
+                        continue;
+
+                for (j = 0; j < channels->len; j++) {
+                        if (g_array_index (channels, guint16, j) ==
+                            bss->frequency)
+                                break;
+                }
+                if (j == channels->len)
+                        g_array_append_val (channels, bss->frequency);
+        }
+
+        return channels;
+}
+
+static GVariant *
+get_scan_args (const GClueWifiScan *last_scan,
+               WifiInterface       *iface,
+               gboolean             active,
+               gboolean             full)
+{
+        GVariantBuilder builder;
+        GVariantBuilder channels_builder;
+        GArray *channels;
+        guint i;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+        g_variant_builder_add (&builder,
+                               "{sv}",
+                               "Type",
+                               g_variant_new ("s",
+                                              active ? "active" : "passive"));
+        if (full)
+                return g_variant_builder_end (&builder);
+
+        /* Without any channels, it's a full scan anyway */
+        channels = get_interface_channels (last_scan, iface);
+        if (channels->len > 0) {
+                g_variant_builder_init (&channels_builder,
+                                        G_VARIANT_TYPE ("a(uu)"));
+                for (i = 0; i < channels->len; i++)
+                        g_variant_builder_add (&channels_builder,
+                                               "(uu)",
+                                               (guint32) g_array_index
+                                                        (channels, guint16, i),
+                                               (guint32) 20);
+                g_variant_builder_add (&builder,
+                                       "{sv}",
+                                       "Channels",
+                                       g_variant_builder_end
+                                                (&channels_builder));
+        }
+        g_debug ("Restricting scan on '%s' to %u channels",
+                 wpa_interface_get_ifname (iface->proxy),
+                 channels->len);
+        g_array_unref (channels);
+
+        return g_variant_builder_end (&builder);
+}
+
+static guint
+gclue_wpa_scanner_scan (GClueWifiScanner    *wifi_scanner,
+                        const GClueWifiScan *last_scan,
+                        gboolean             active,
+                        gboolean             full)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (wifi_scanner);
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        GList *l;
+
+        /* A request while scans are in progress joins them */
+        if (priv->scans_pending == 0) {
+                priv->scan_succeeded = FALSE;
+                priv->scan_started = g_get_monotonic_time ();
+                priv->scan_id++;
+        }
+
+        /* Scan on all devices together and only report the results once
+         * they are all done.
+         */
+        for (l = priv->interfaces; l != NULL; l = l->next) {
+                WifiInterface *iface = l->data;
+                GVariant *args;
+
+                if (iface->scanning)
+                        continue;
+
+                if (iface->scan_done_id == 0)
+                        iface->scan_done_id = g_signal_connect
+                                                (iface->proxy,
+                                                 "scan-done",
+                                                 G_CALLBACK (on_scan_done),
+                                                 scanner);
+
+                args = get_scan_args (last_scan, iface, active, full);
+                wpa_interface_call_scan (iface->proxy,
+                                         args,
+                                         NULL,
+                                         on_scan_call_done,
+                                         scanner);
+                iface->scanning = TRUE;
+                priv->scans_pending++;
+        }
+
+        return priv->scan_id;
+}
+
+static void
+finish_interface_scan (GClueWpaScanner *scanner,
+                       WifiInterface   *iface)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+
+        if (!iface->scanning)
+                return;
+
+        iface->scanning = FALSE;
+        priv->scans_pending--;
+        if (priv->scans_pending > 0)
+                return;
+
+        if (!priv->scan_succeeded)
+                g_warning ("WiFi scan failed on all devices");
+
+        g_signal_emit_by_name (scanner, "scan-done", priv->scan_succeeded);
+}
+
+static void
+on_scan_done (WPAInterface *object,
+              gboolean      success,
+              gpointer      user_data)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (user_data);
+        WifiInterface *iface;
+
+        iface = find_interface (scanner, object);
+        if (iface == NULL || !iface->scanning)
+                return; /* Not a scan we asked for */
+
+        if (!success) {
+                g_warning ("WiFi scan failed on '%s'",
+                           wpa_interface_get_ifname (object));
+        } else {
+                g_debug ("WiFi scan completed on '%s'",
+                         wpa_interface_get_ifname (object));
+                scanner->priv->scan_succeeded = TRUE;
+        }
+
+        finish_interface_scan (scanner, iface);
+}
+
+static void
+on_scan_call_done (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (user_data);
+        WifiInterface *iface;
+        GError *error = NULL;
+
+        if (!wpa_interface_call_scan_finish
+                (WPA_INTERFACE (source_object),
+                 res,
+                 &error)) {
+                g_warning ("Scanning of WiFi networks failed: %s",
+                           error->message);
+                g_error_free (error);
+
+                iface = find_interface (scanner,
+                                        WPA_INTERFACE (source_object));
+                if (iface != NULL)
+                        finish_interface_scan (scanner, iface);
+
+                return;
+        }
+}
+
+static void
+connect_interface_signals (GClueWpaScanner *scanner,
+                           WifiInterface   *iface)
+{
+        const gchar *const *bss_list;
+        guint i;
+
+        if (iface->bss_added_id != 0)
+                return;
+
+        iface->bss_added_id = g_signal_connect (iface->proxy,
+                                                "bss-added",
+                                                G_CALLBACK (on_bss_added),
+                                                scanner);
+        iface->bss_removed_id = g_signal_connect (iface->proxy,
+                                                  "bss-removed",
+                                                  G_CALLBACK (on_bss_removed),
+                                                  scanner);
+
+        bss_list = wpa_interface_get_bsss (iface->proxy);
+        if (bss_list == NULL)
+                return;
+
+        for (i = 0; bss_list[i] != NULL; i++)
+                on_bss_added (iface->proxy,
+                              bss_list[i],
+                              NULL,
+                              scanner);
+}
+
+static void
+disconnect_interface_signals (GClueWpaScanner *scanner,
+                              WifiInterface   *iface)
+{
+        if (iface->scan_done_id != 0) {
+                g_signal_handler_disconnect (iface->proxy,
+                                             iface->scan_done_id);
+                iface->scan_done_id = 0;
+        }
+        if (iface->bss_added_id != 0) {
+                g_signal_handler_disconnect (iface->proxy,
+                                             iface->bss_added_id);
+                iface->bss_added_id = 0;
+        }
+        if (iface->bss_removed_id != 0) {
+                g_signal_handler_disconnect (iface->proxy,
+                                             iface->bss_removed_id);
+                iface->bss_removed_id = 0;
+        }
+}
+
+static void
+start_watching (GClueWpaScanner *scanner)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        GList *l;
+
+        if (priv->bss_properties_id != 0 || priv->interfaces == NULL)
+                return;
+
+        /* One subscription for all APs, rather than a proxy for each */
+        priv->bss_properties_id = g_dbus_connection_signal_subscribe
+                (g_dbus_proxy_get_connection (G_DBUS_PROXY (priv->supplicant)),
+                 "fi.w1.wpa_supplicant1",
+                 "org.freedesktop.DBus.Properties",
+                 "PropertiesChanged",
+                 NULL,
+                 "fi.w1.wpa_supplicant1.BSS",
+                 G_DBUS_SIGNAL_FLAGS_NONE,
+                 on_bss_properties_changed,
+                 scanner,
+                 NULL);
+        priv->bss_cancellable = g_cancellable_new ();
+
+        for (l = priv->interfaces; l != NULL; l = l->next)
+                connect_interface_signals (scanner, l->data);
+}
+
+static void
+stop_watching (GClueWpaScanner *scanner)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        GList *l;
+
+        cancel_wifi_scan (scanner);
+
+        for (l = priv->interfaces; l != NULL; l = l->next)
+                disconnect_interface_signals (scanner, l->data);
+
+        if (priv->bss_properties_id != 0) {
+                g_dbus_connection_signal_unsubscribe
+                        (g_dbus_proxy_get_connection
+                                (G_DBUS_PROXY (priv->supplicant)),
+                         priv->bss_properties_id);
+                priv->bss_properties_id = 0;
+        }
+        if (priv->bss_cancellable != NULL) {
+                g_cancellable_cancel (priv->bss_cancellable);
+                g_clear_object (&priv->bss_cancellable);
+        }
+
+        g_hash_table_remove_all (priv->bss_records);
+        g_hash_table_remove_all (priv->bss_paths);
+        priv->scan_started = 0;
+}
+
+/* Both WiFi sources share us, so we only stop once neither needs us anymore */
+static void
+gclue_wpa_scanner_start (GClueWifiScanner *wifi_scanner)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (wifi_scanner);
+
+        scanner->priv->n_users++;
+        start_watching (scanner);
+}
+
+static void
+gclue_wpa_scanner_stop (GClueWifiScanner *wifi_scanner)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (wifi_scanner);
+        GClueWpaScannerPrivate *priv = scanner->priv;
+
+        if (priv->n_users == 0 || --priv->n_users > 0)
+                return;
+
+        stop_watching (scanner);
+}
+
+static gboolean
+gclue_wpa_scanner_get_is_ready (GClueWifiScanner *scanner)
+{
+        return GCLUE_WPA_SCANNER (scanner)->priv->ready;
+}
+
+/* Ready once wpa_supplicant answered, or turned out to be unavailable, and
+ * we have a proxy for each of the devices it had at that point.
+ */
+static void
+check_ready (GClueWpaScanner *scanner)
+{
+        GClueWpaScannerPrivate *priv = scanner->priv;
+
+        if (priv->ready || priv->proxies_pending > 0)
+                return;
+
+        priv->ready = TRUE;
+        g_debug ("WiFi scanner ready after %" G_GINT64_FORMAT " ms, "
+                 "with %u devices",
+                 (g_get_monotonic_time () - priv->connect_started) / 1000,
+                 g_list_length (priv->interfaces));
+        g_object_notify_by_pspec (G_OBJECT (scanner),
+                                  gParamSpecs[PROP_IS_READY]);
+}
+
+static gboolean
+gclue_wpa_scanner_get_has_devices (GClueWifiScanner *scanner)
+{
+        return GCLUE_WPA_SCANNER (scanner)->priv->interfaces != NULL;
+}
+
+static GHashTable *
+gclue_wpa_scanner_get_bss_records (GClueWifiScanner *scanner)
+{
+        return GCLUE_WPA_SCANNER (scanner)->priv->bss_records;
+}
+
+static gint64
+gclue_wpa_scanner_get_scan_started (GClueWifiScanner *scanner)
+{
+        return GCLUE_WPA_SCANNER (scanner)->priv->scan_started;
+}
+
+static void
+on_interface_proxy_ready (GObject      *source_object,
+                          GAsyncResult *res,
+                          gpointer      user_data)
+{
+        GClueWpaScanner *scanner;
+        GClueWpaScannerPrivate *priv;
+        WPAInterface *interface;
+        WifiInterface *iface;
+        GError *error = NULL;
+        const char *path;
+
+        interface = wpa_interface_proxy_new_for_bus_finish (res, &error);
+        if (interface == NULL &&
+            g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+                /* The scanner is gone already */
+                g_error_free (error);
+
+                return;
+        }
+
+        scanner = GCLUE_WPA_SCANNER (user_data);
+        priv = scanner->priv;
+        priv->proxies_pending--;
+        if (interface == NULL) {
+                g_debug ("%s", error->message);
+                g_error_free (error);
+                check_ready (scanner);
+
+                return;
+        }
+
+        path = g_dbus_proxy_get_object_path (G_DBUS_PROXY (interface));
+        if (find_interface_by_path (scanner, path) != NULL) {
+                g_object_unref (interface);
+                check_ready (scanner);
+
+                return;
+        }
+
+        iface = g_slice_new0 (WifiInterface);
+        iface->proxy = interface;
+        iface->index = g_ascii_strtoull (strrchr (path, '/') + 1, NULL, 10);
+        priv->interfaces = g_list_append (priv->interfaces, iface);
+        g_debug ("WiFi device '%s' added.",
+                 wpa_interface_get_ifname (interface));
+
+        /* Will take part from the next scan on */
+        if (priv->bss_properties_id != 0)
+                connect_interface_signals (scanner, iface);
+
+        g_signal_emit_by_name (scanner, "device-added");
+        check_ready (scanner);
+}
+
+static void
+on_interface_added (WPASupplicant *supplicant,
+                    const gchar   *path,
+                    GVariant      *properties,
+                    gpointer       user_data)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (user_data);
+
+        if (find_interface_by_path (scanner, path) != NULL)
+                return;
+
+        scanner->priv->proxies_pending++;
+        wpa_interface_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+                                         G_DBUS_PROXY_FLAGS_NONE,
+                                         "fi.w1.wpa_supplicant1",
+                                         path,
+                                         scanner->priv->cancellable,
+                                         on_interface_proxy_ready,
+                                         scanner);
+}
+
+static void
+on_interface_removed (WPASupplicant *supplicant,
+                      const gchar   *path,
+                      gpointer       user_data)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (user_data);
+        GClueWpaScannerPrivate *priv = scanner->priv;
+        WifiInterface *iface;
+
+        iface = find_interface_by_path (scanner, path);
+        if (iface == NULL)
+                return;
+
+        g_debug ("WiFi device '%s' removed.",
+                 wpa_interface_get_ifname (iface->proxy));
+
+        if (priv->interfaces->next == NULL) {
+                /* That was the last one */
+                stop_watching (scanner);
+                priv->interfaces = g_list_remove (priv->interfaces, iface);
+        } else {
+                priv->interfaces = g_list_remove (priv->interfaces, iface);
+                disconnect_interface_signals (scanner, iface);
+                remove_interface_bsss (scanner, iface);
+                finish_interface_scan (scanner, iface);
+        }
+        wifi_interface_free (iface);
+
+        g_signal_emit_by_name (scanner, "device-removed");
+}
+
+static void
+on_supplicant_proxy_ready (GObject      *source_object,
+                           GAsyncResult *res,
+                           gpointer      user_data)
+{
+        GClueWpaScanner *scanner;
+        GClueWpaScannerPrivate *priv;
+        WPASupplicant *supplicant;
+        const gchar *const *interfaces;
+        GError *error = NULL;
+        guint i;
+
+        supplicant = wpa_supplicant_proxy_new_for_bus_finish (res, &error);
+        if (supplicant == NULL &&
+            g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+                /* The scanner is gone already */
+                g_error_free (error);
+
+                return;
+        }
+
+        scanner = GCLUE_WPA_SCANNER (user_data);
+        priv = scanner->priv;
+        if (supplicant == NULL) {
+                g_warning ("Failed to connect to wpa_supplicant service: %s",
+                           error->message);
+                g_error_free (error);
+                check_ready (scanner);
+
+                return;
+        }
+
+        priv->supplicant = supplicant;
+        g_debug ("Connected to wpa_supplicant after %" G_GINT64_FORMAT " ms",
+                 (g_get_monotonic_time () - priv->connect_started) / 1000);
+
+        g_signal_connect (priv->supplicant,
+                          "interface-added",
+                          G_CALLBACK (on_interface_added),
+                          scanner);
+        g_signal_connect (priv->supplicant,
+                          "interface-removed",
+                          G_CALLBACK (on_interface_removed),
+                          scanner);
+
+        interfaces = wpa_supplicant_get_interfaces (priv->supplicant);
+        for (i = 0; interfaces != NULL && interfaces[i] != NULL; i++)
+                on_interface_added (priv->supplicant,
+                                    interfaces[i],
+                                    NULL,
+                                    scanner);
+        check_ready (scanner);
+}
+
+static void
+gclue_wpa_scanner_constructed (GObject *object)
+{
+        GClueWpaScanner *scanner = GCLUE_WPA_SCANNER (object);
+
+        G_OBJECT_CLASS (gclue_wpa_scanner_parent_class)->constructed (object);
+
+        /* Don't block the main loop on a slow or restarting wpa_supplicant */
+        scanner->priv->connect_started = g_get_monotonic_time ();
+        wpa_supplicant_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+                                          G_DBUS_PROXY_FLAGS_NONE,
+                                          "fi.w1.wpa_supplicant1",
+                                          "/fi/w1/wpa_supplicant1",
+                                          scanner->priv->cancellable,
+                                          on_supplicant_proxy_ready,
+                                          scanner);
+}
+
+static guint
+gclue_wpa_scanner_get_scan_id (GClueWifiScanner *scanner)
+{
+        return GCLUE_WPA_SCANNER (scanner)->priv->scan_id;
+}
+
+/* We scan when asked to */
+static gboolean
+gclue_wpa_scanner_get_sets_pace (GClueWifiScanner *scanner)
+{
+        return FALSE;
+}
+
+static void
+gclue_wifi_scanner_interface_init (GClueWifiScannerInterface *iface)
+{
+        iface->get_is_ready = gclue_wpa_scanner_get_is_ready;
+        iface->get_has_devices = gclue_wpa_scanner_get_has_devices;
+        iface->get_bss_records = gclue_wpa_scanner_get_bss_records;
+        iface->get_scan_started = gclue_wpa_scanner_get_scan_started;
+        iface->get_scan_id = gclue_wpa_scanner_get_scan_id;
+        iface->get_sets_pace = gclue_wpa_scanner_get_sets_pace;
+        iface->start = gclue_wpa_scanner_start;
+        iface->stop = gclue_wpa_scanner_stop;
+        iface->scan = gclue_wpa_scanner_scan;
+}
+
+/**
+ * gclue_wpa_scanner_new:
+ *
+ * Creates a scanner for the WiFi devices managed by wpa_supplicant.
+ *
+ * Returns: (transfer full): A new #GClueWifiScanner. Use g_object_unref()
+ * when done.
+ **/
+GClueWifiScanner *
+gclue_wpa_scanner_new (void)
+{
+        return g_object_new (GCLUE_TYPE_WPA_SCANNER, NULL);
+}
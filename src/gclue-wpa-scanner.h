@@ -0,0 +1,71 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-wpa-scanner.h
+ *
+ * Copyright 2014 Red Hat, Inc.
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Zeeshan Ali (Khattak) <zeeshanak@gnome.org>
+ *          agent <agent@local>
+ */
+
+#ifndef GCLUE_WPA_SCANNER_H
+#define GCLUE_WPA_SCANNER_H
+
+#include <gio/gio.h>
+#include "gclue-wifi-scanner.h"
+
+G_BEGIN_DECLS
+
+GType gclue_wpa_scanner_get_type (void) G_GNUC_CONST;
+
+#define GCLUE_TYPE_WPA_SCANNER            (gclue_wpa_scanner_get_type ())
+#define GCLUE_WPA_SCANNER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_WPA_SCANNER, GClueWpaScanner))
+#define GCLUE_IS_WPA_SCANNER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_WPA_SCANNER))
+#define GCLUE_WPA_SCANNER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GCLUE_TYPE_WPA_SCANNER, GClueWpaScannerClass))
+#define GCLUE_IS_WPA_SCANNER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GCLUE_TYPE_WPA_SCANNER))
+#define GCLUE_WPA_SCANNER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GCLUE_TYPE_WPA_SCANNER, GClueWpaScannerClass))
+
+/**
+ * GClueWpaScanner:
+ *
+ * All the fields in the #GClueWpaScanner structure are private and should never be accessed directly.
+**/
+typedef struct _GClueWpaScanner        GClueWpaScanner;
+typedef struct _GClueWpaScannerClass   GClueWpaScannerClass;
+typedef struct _GClueWpaScannerPrivate GClueWpaScannerPrivate;
+
+struct _GClueWpaScanner {
+        /* <private> */
+        GObject parent_instance;
+        GClueWpaScannerPrivate *priv;
+};
+
+/**
+ * GClueWpaScannerClass:
+ *
+ * All the fields in the #GClueWpaScannerClass structure are private and should never be accessed directly.
+**/
+struct _GClueWpaScannerClass {
+        /* <private> */
+        GObjectClass parent_class;
+};
+
+GClueWifiScanner * gclue_wpa_scanner_new (void);
+
+G_END_DECLS
+
+#endif /* GCLUE_WPA_SCANNER_H */
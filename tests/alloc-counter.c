@@ -0,0 +1,88 @@
+/* vim: set et ts=8 sw=8: */
+/* alloc-counter.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include "alloc-counter.h"
+
+/* Counts the heap allocations of the whole process, including those made by
+ * GLib and the other libraries, so the benchmarks can report allocations per
+ * operation. This works by interposing malloc() and friends, and forwarding
+ * them to the functions glibc exports for that, so it's only available with
+ * glibc. A realloc() counts as an allocation, as that's what it does when a
+ * buffer has to grow.
+ */
+static gint n_allocations = 0;
+
+#ifdef __GLIBC__
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n_members, size_t size);
+extern void *__libc_realloc (void *mem, size_t size);
+
+void *
+malloc (size_t size)
+{
+        g_atomic_int_inc (&n_allocations);
+
+        return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_members,
+        size_t size)
+{
+        g_atomic_int_inc (&n_allocations);
+
+        return __libc_calloc (n_members, size);
+}
+
+void *
+realloc (void  *mem,
+         size_t size)
+{
+        g_atomic_int_inc (&n_allocations);
+
+        return __libc_realloc (mem, size);
+}
+
+gboolean
+alloc_counter_is_available (void)
+{
+        return TRUE;
+}
+
+#else
+
+gboolean
+alloc_counter_is_available (void)
+{
+        return FALSE;
+}
+
+#endif
+
+/* Only differences between two calls mean anything */
+guint
+alloc_counter_get (void)
+{
+        return g_atomic_int_get (&n_allocations);
+}
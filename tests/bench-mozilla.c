@@ -0,0 +1,283 @@
+/* vim: set et ts=8 sw=8: */
+/* bench-mozilla.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include "gclue-mozilla.h"
+#include "alloc-counter.h"
+
+#define N_ITERATIONS 100000
+#define N_BSS        25 /* The default max-query-aps */
+
+static const char config[] =
+        "[agent]\n"
+        "whitelist=\n"
+        "[wifi]\n"
+        "url=http://localhost/v1/geolocate\n";
+
+static const char reply[] =
+        "{\"location\":{\"lat\":51.5073219,\"lng\":-0.1276474},"
+        "\"accuracy\":25.0}";
+
+static void
+print_result (const char *name,
+              gint64      usec,
+              guint       n_allocations,
+              gsize       n_bytes)
+{
+        g_print ("  %-12s %8.3f µs", name, (gdouble) usec / N_ITERATIONS);
+        if (alloc_counter_is_available ())
+                g_print (" %8.1f allocations",
+                         (gdouble) n_allocations / N_ITERATIONS);
+        if (n_bytes > 0)
+                g_print (" %6" G_GSIZE_FORMAT " bytes", n_bytes);
+        g_print ("\n");
+}
+
+typedef GClueLocation * (*ParseFunc) (const char *json);
+
+static GClueLocation *
+parse_pull (const char *json)
+{
+        return gclue_mozilla_parse_response (json, NULL);
+}
+
+/* The full parser, as gclue_mozilla_parse_response() used for every reply
+ * before it had a pull parser.
+ */
+static GClueLocation *
+parse_tree (const char *json)
+{
+        JsonParser *parser;
+        JsonObject *object, *loc_object;
+        GClueLocation *location;
+
+        parser = json_parser_new ();
+        json_parser_load_from_data (parser, json, -1, NULL);
+
+        object = json_node_get_object (json_parser_get_root (parser));
+        loc_object = json_object_get_object_member (object, "location");
+        location = gclue_location_new
+                (json_object_get_double_member (loc_object, "lat"),
+                 json_object_get_double_member (loc_object, "lng"),
+                 json_object_get_double_member (object, "accuracy"));
+        g_object_unref (parser);
+
+        return location;
+}
+
+static void
+bench_parse (const char *name,
+             ParseFunc   func)
+{
+        gint64 start;
+        guint n_allocations, i;
+
+        /* Warm up, so e.g the types are registered before we start */
+        g_object_unref (func (reply));
+
+        n_allocations = alloc_counter_get ();
+        start = g_get_monotonic_time ();
+        for (i = 0; i < N_ITERATIONS; i++)
+                g_object_unref (func (reply));
+        print_result (name,
+                      g_get_monotonic_time () - start,
+                      alloc_counter_get () - n_allocations,
+                      0);
+}
+
+typedef SoupMessage * (*CreateQueryFunc) (const GClueWifiScan *scan,
+                                          const GClue3GTower  *tower);
+
+static SoupMessage *
+create_query_writer (const GClueWifiScan *scan,
+                     const GClue3GTower  *tower)
+{
+        return gclue_mozilla_create_query (scan, tower, NULL);
+}
+
+/* The same payload, built as gclue_mozilla_create_query() did before it
+ * wrote JSON directly.
+ */
+static SoupMessage *
+create_query_builder (const GClueWifiScan *scan,
+                      const GClue3GTower  *tower)
+{
+        SoupMessage *msg;
+        JsonBuilder *builder;
+        JsonGenerator *generator;
+        JsonNode *root_node;
+        char *data;
+        gsize data_len;
+        guint i;
+
+        builder = json_builder_new ();
+        json_builder_begin_object (builder);
+
+        json_builder_set_member_name (builder, "radioType");
+        json_builder_add_string_value (builder, "gsm");
+
+        json_builder_set_member_name (builder, "cellTowers");
+        json_builder_begin_array (builder);
+        json_builder_begin_object (builder);
+        json_builder_set_member_name (builder, "cellId");
+        json_builder_add_int_value (builder, tower->cell_id);
+        json_builder_set_member_name (builder, "mobileCountryCode");
+        json_builder_add_int_value (builder, tower->mcc);
+        json_builder_set_member_name (builder, "mobileNetworkCode");
+        json_builder_add_int_value (builder, tower->mnc);
+        json_builder_set_member_name (builder, "locationAreaCode");
+        json_builder_add_int_value (builder, tower->lac);
+        json_builder_end_object (builder);
+        json_builder_end_array (builder);
+
+        json_builder_set_member_name (builder, "wifiAccessPoints");
+        json_builder_begin_array (builder);
+        for (i = 0; i < scan->n_bss; i++) {
+                json_builder_begin_object (builder);
+                json_builder_set_member_name (builder, "macAddress");
+                json_builder_add_string_value (builder, scan->bss[i].mac);
+                json_builder_set_member_name (builder, "signalStrength");
+                json_builder_add_int_value (builder, scan->bss[i].signal);
+                json_builder_end_object (builder);
+        }
+        json_builder_end_array (builder);
+
+        json_builder_end_object (builder);
+
+        generator = json_generator_new ();
+        root_node = json_builder_get_root (builder);
+        json_generator_set_root (generator, root_node);
+        data = json_generator_to_data (generator, &data_len);
+
+        json_node_free (root_node);
+        g_object_unref (builder);
+        g_object_unref (generator);
+
+        msg = soup_message_new ("POST", "http://localhost/v1/geolocate");
+        soup_message_set_request (msg,
+                                  "application/json",
+                                  SOUP_MEMORY_TAKE,
+                                  data,
+                                  data_len);
+
+        return msg;
+}
+
+static GClueWifiScan *
+create_scan (void)
+{
+        GHashTable *records;
+        GClueWifiScan *scan;
+        guint i;
+
+        records = g_hash_table_new_full (g_int64_hash,
+                                         g_int64_equal,
+                                         NULL,
+                                         (GDestroyNotify) gclue_wifi_bss_free);
+        for (i = 0; i < N_BSS; i++) {
+                GClueWifiBSS *bss;
+                char *mac;
+
+                mac = g_strdup_printf ("02:00:00:00:%02x:%02x",
+                                       i * 37 % 256,
+                                       i);
+                bss = gclue_wifi_bss_new_for_mac (mac, "Network", i);
+                bss->signal = -40 - i;
+                bss->last_seen = g_get_monotonic_time ();
+                g_hash_table_insert (records, &bss->bssid, bss);
+                g_free (mac);
+        }
+
+        scan = gclue_wifi_scan_new (records, -90, 0);
+        g_hash_table_unref (records);
+
+        return scan;
+}
+
+static void
+bench_create_query (const char     *name,
+                    CreateQueryFunc func)
+{
+        GClue3GTower tower = { 234, 15, 0x1234, 0xabcdef };
+        GClueWifiScan *scan;
+        SoupMessage *msg;
+        gint64 start;
+        guint n_allocations, i;
+        gsize n_bytes;
+
+        scan = create_scan ();
+
+        /* Warm up, so e.g the types are registered before we start */
+        msg = func (scan, &tower);
+        n_bytes = msg->request_body->length;
+        g_object_unref (msg);
+
+        n_allocations = alloc_counter_get ();
+        start = g_get_monotonic_time ();
+        for (i = 0; i < N_ITERATIONS; i++)
+                g_object_unref (func (scan, &tower));
+        print_result (name,
+                      g_get_monotonic_time () - start,
+                      alloc_counter_get () - n_allocations,
+                      n_bytes);
+
+        gclue_wifi_scan_unref (scan);
+}
+
+int
+main (int argc, char **argv)
+{
+        char *dir, *path;
+        GError *error = NULL;
+
+        dir = g_dir_make_tmp ("geoclue-bench-XXXXXX", &error);
+        if (dir == NULL) {
+                g_printerr ("Failed to create a directory: %s\n",
+                            error->message);
+                g_error_free (error);
+
+                return EXIT_FAILURE;
+        }
+        path = g_build_filename (dir, "geoclue.conf", NULL);
+        g_file_set_contents (path, config, -1, NULL);
+        g_setenv ("GEOCLUE_CONFIG", path, TRUE);
+
+        g_print ("Parsing a geolocate reply, per reply:\n");
+        bench_parse ("pull parser", parse_pull);
+        bench_parse ("json-glib", parse_tree);
+
+        g_print ("Creating a geolocate query for %u access points and a "
+                 "cell tower, per query:\n",
+                 N_BSS);
+        bench_create_query ("writer", create_query_writer);
+        bench_create_query ("JsonBuilder", create_query_builder);
+
+        g_unlink (path);
+        g_rmdir (dir);
+        g_free (path);
+        g_free (dir);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,561 @@
+/* vim: set et ts=8 sw=8: */
+/* bench-wifi.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "gclue-wifi.h"
+#include "gclue-wifi-scanner.h"
+#include "gclue-web-source.h"
+#include "gclue-cell-registry.h"
+#include "alloc-counter.h"
+#include "mock-service.h"
+
+/* Runs a WiFi source at street level against the stand-in service, replaying
+ * a trace where each scan sees a new set of access points, and measures the
+ * time from each scan to the location it resulted in.
+ *
+ * GClue3G needs ModemManager, so the cell tower it would find is handed to
+ * the cell registry directly, which is all GClue3G does with it when WiFi is
+ * around: the WiFi source then sends it along with the access points.
+ */
+
+#define MAX_APS 40
+
+/* Commandline options */
+static gint n_scans = 100;
+static gint interval = 100; /* ms */
+static gint n_aps = 10;
+static gint latency = 20;   /* ms */
+static gint jitter = 30;    /* ms */
+static gdouble error_rate = 0.02;
+static gboolean no_tower = FALSE;
+static gboolean submit = FALSE;
+
+static GOptionEntry entries[] =
+{
+        { "scans",
+          's',
+          0,
+          G_OPTION_ARG_INT,
+          &n_scans,
+          "Replay N scans. Default: 100",
+          "N" },
+        { "interval",
+          'i',
+          0,
+          G_OPTION_ARG_INT,
+          &interval,
+          "Replay a scan every I milliseconds. Default: 100",
+          "I" },
+        { "aps",
+          'a',
+          0,
+          G_OPTION_ARG_INT,
+          &n_aps,
+          "Put A access points in each scan, at most 40. Default: 10",
+          "A" },
+        { "latency",
+          'l',
+          0,
+          G_OPTION_ARG_INT,
+          &latency,
+          "Let the service answer after L milliseconds. Default: 20",
+          "L" },
+        { "jitter",
+          'j',
+          0,
+          G_OPTION_ARG_INT,
+          &jitter,
+          "Let the service take up to J more milliseconds. Default: 30",
+          "J" },
+        { "error-rate",
+          'e',
+          0,
+          G_OPTION_ARG_DOUBLE,
+          &error_rate,
+          "Let the service fail this share of the requests. Default: 0.02",
+          "R" },
+        { "no-tower",
+          0,
+          0,
+          G_OPTION_ARG_NONE,
+          &no_tower,
+          "Don't send a cell tower along with the access points",
+          NULL },
+        { "submit",
+          0,
+          0,
+          G_OPTION_ARG_NONE,
+          &submit,
+          "Submit a GPS location for each scan too",
+          NULL },
+        { NULL }
+};
+
+static const GClue3GTower tower = { 234, 15, 0x1234, 0xabcdef };
+
+static GMainLoop *main_loop;
+static gint64 *scan_times;
+static gint64 *fix_times;
+static guint n_fixes = 0;
+static guint n_other_fixes = 0;
+static guint n_warnings = 0;
+
+/* A GPS to submit locations from */
+typedef GClueLocationSource      BenchGps;
+typedef GClueLocationSourceClass BenchGpsClass;
+
+G_DEFINE_TYPE (BenchGps, bench_gps, GCLUE_TYPE_LOCATION_SOURCE)
+
+static void
+bench_gps_class_init (BenchGpsClass *klass)
+{
+}
+
+static void
+bench_gps_init (BenchGps *gps)
+{
+}
+
+static char *
+write_trace (const char *dir)
+{
+        GString *trace;
+        char *path;
+        gint i, j;
+
+        trace = g_string_new ("# time bssid signal frequency ssid\n");
+        for (i = 0; i < n_scans; i++) {
+                for (j = 0; j < n_aps; j++) {
+                        g_string_append_printf (trace, "%d ", i);
+                        g_string_append_printf (trace,
+                                                MOCK_GRID_BSSID_FORMAT,
+                                                i >> 8,
+                                                i & 0xff,
+                                                j >> 8,
+                                                j & 0xff);
+                        g_string_append_printf (trace,
+                                                " %d %d Cell%d\n",
+                                                -40 - j,
+                                                (j % 2) ? 5180 : 2412,
+                                                i);
+                }
+        }
+
+        path = g_build_filename (dir, "trace", NULL);
+        g_file_set_contents (path, trace->str, trace->len, NULL);
+        g_string_free (trace, TRUE);
+
+        return path;
+}
+
+static char *
+write_config (const char *dir,
+              const char *url,
+              const char *trace)
+{
+        GString *config;
+        char *path;
+        char speed[G_ASCII_DTOSTR_BUF_SIZE];
+
+        config = g_string_new (NULL);
+        g_string_append (config, "[agent]\nwhitelist=\n");
+        g_string_append_printf (config,
+                                "[wifi]\n"
+                                "enable=true\n"
+                                "url=%sv1/geolocate\n"
+                                "replay-file=%s\n"
+                                "replay-speed=%s\n"
+                                "max-query-aps=%d\n"
+                                "cache-persist=false\n",
+                                url,
+                                trace,
+                                g_ascii_dtostr (speed,
+                                                sizeof (speed),
+                                                1000.0 / interval),
+                                MAX_APS);
+        if (submit)
+                g_string_append_printf (config,
+                                        "submit-data=true\n"
+                                        "submission-url=%sv1/submit\n"
+                                        "submission-nick=geoclue-bench\n"
+                                        "submission-persist=false\n",
+                                        url);
+        g_string_append (config, "[web]\nresponse-cache-persist=false\n");
+
+        path = g_build_filename (dir, "geoclue.conf", NULL);
+        g_file_set_contents (path, config->str, config->len, NULL);
+        g_string_free (config, TRUE);
+
+        return path;
+}
+
+/* The scan the APs on the grid came from, or -1 */
+static gint
+get_scan_index (GHashTable *bss_records)
+{
+        GHashTableIter iter;
+        GClueWifiBSS *bss;
+        guint high, low, index_high, index_low;
+
+        g_hash_table_iter_init (&iter, bss_records);
+        if (!g_hash_table_iter_next (&iter, NULL, (gpointer *) &bss))
+                return -1;
+
+        if (sscanf (bss->mac,
+                    "02:00:%2x:%2x:%2x:%2x",
+                    &high,
+                    &low,
+                    &index_high,
+                    &index_low) != 4)
+                return -1;
+
+        return (high << 8) | low;
+}
+
+static void
+on_scan_done (GClueWifiScanner *scanner,
+              gboolean          success,
+              gpointer          user_data)
+{
+        gint index;
+
+        index = get_scan_index (gclue_wifi_scanner_get_bss_records (scanner));
+        if (index < 0 || index >= n_scans || scan_times[index] != 0)
+                return;
+
+        scan_times[index] = gclue_wifi_scanner_get_scan_started (scanner);
+}
+
+/* Once the WiFi source started its query, like a GPS fixing at each scan */
+static void
+on_scan_done_after (GClueWifiScanner *scanner,
+                    gboolean          success,
+                    gpointer          user_data)
+{
+        static guint64 started = 0;
+        GClueLocation *location;
+        gint index;
+
+        index = get_scan_index (gclue_wifi_scanner_get_bss_records (scanner));
+        if (index < 0)
+                return;
+
+        if (started == 0)
+                started = g_get_real_time () / G_USEC_PER_SEC;
+        location = gclue_location_new_full (MOCK_GRID_LATITUDE +
+                                            index * MOCK_GRID_STEP,
+                                            MOCK_GRID_LONGITUDE,
+                                            5.0,
+                                            GCLUE_LOCATION_SPEED_UNKNOWN,
+                                            GCLUE_LOCATION_HEADING_UNKNOWN,
+                                            GCLUE_LOCATION_ALTITUDE_UNKNOWN,
+                                            started + index * 60,
+                                            NULL);
+        gclue_location_source_set_location (user_data, location);
+        g_object_unref (location);
+}
+
+static void
+on_location_notify (GObject    *gobject,
+                    GParamSpec *pspec,
+                    gpointer    user_data)
+{
+        GClueLocation *location;
+        gdouble index;
+
+        location = gclue_location_source_get_location
+                                (GCLUE_LOCATION_SOURCE (gobject));
+        if (location == NULL)
+                return;
+
+        index = (gclue_location_get_latitude (location) -
+                 MOCK_GRID_LATITUDE) / MOCK_GRID_STEP;
+        if (fabs (gclue_location_get_longitude (location) -
+                  MOCK_GRID_LONGITUDE) > MOCK_GRID_STEP / 2 ||
+            fabs (index - lround (index)) > 0.1 ||
+            lround (index) < 0 || lround (index) >= n_scans ||
+            scan_times[lround (index)] == 0 ||
+            fix_times[lround (index)] != 0) {
+                n_other_fixes++;
+
+                return;
+        }
+
+        fix_times[lround (index)] = g_get_monotonic_time ();
+        n_fixes++;
+        if (n_fixes == (guint) n_scans)
+                g_main_loop_quit (main_loop);
+}
+
+static void
+on_log (const char    *log_domain,
+        GLogLevelFlags log_level,
+        const char    *message,
+        gpointer       user_data)
+{
+        n_warnings++;
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+        g_main_loop_quit (main_loop);
+
+        return FALSE;
+}
+
+static int
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+        gint64 time_a = *(const gint64 *) a;
+        gint64 time_b = *(const gint64 *) b;
+
+        return (time_a > time_b) - (time_a < time_b);
+}
+
+static void
+report (guint n_allocations)
+{
+        GArray *latencies;
+        gint i;
+
+        latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+        for (i = 0; i < n_scans; i++) {
+                gint64 time;
+
+                if (scan_times[i] == 0 || fix_times[i] == 0)
+                        continue;
+
+                time = fix_times[i] - scan_times[i];
+                g_array_append_val (latencies, time);
+        }
+        g_array_sort (latencies, compare_times);
+
+        g_print ("%d scans of %d access points, %s cell tower, every %d ms; "
+                 "service answering in %d-%d ms, failing %.0f%% of the "
+                 "time\n",
+                 n_scans,
+                 n_aps,
+                 no_tower ? "no" : "a",
+                 interval,
+                 latency,
+                 latency + jitter,
+                 error_rate * 100);
+        g_print ("  %u scans located, %u not, %u other locations, "
+                 "%u warnings\n",
+                 n_fixes,
+                 n_scans - n_fixes,
+                 n_other_fixes,
+                 n_warnings);
+        if (latencies->len > 0) {
+                guint n = latencies->len;
+
+                g_print ("  Scan to location: median %.1f ms, "
+                         "99th percentile %.1f ms\n",
+                         g_array_index (latencies, gint64, (n - 1) / 2) /
+                         1000.0,
+                         g_array_index (latencies, gint64, (n - 1) * 99 / 100) /
+                         1000.0);
+        }
+        if (alloc_counter_is_available () && n_fixes + n_other_fixes > 0)
+                g_print ("  %.1f allocations per location\n",
+                         (gdouble) n_allocations /
+                         (n_fixes + n_other_fixes));
+
+        g_array_unref (latencies);
+}
+
+static GSubprocess *
+spawn_mock_service (const char *path,
+                    char      **url,
+                    GError    **error)
+{
+        GSubprocess *mock;
+        GDataInputStream *output;
+        char *latency_str, *jitter_str;
+        char error_rate_str[G_ASCII_DTOSTR_BUF_SIZE];
+
+        latency_str = g_strdup_printf ("%d", latency);
+        jitter_str = g_strdup_printf ("%d", jitter);
+        g_ascii_dtostr (error_rate_str, sizeof (error_rate_str), error_rate);
+        mock = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE,
+                                 error,
+                                 path,
+                                 "--latency", latency_str,
+                                 "--jitter", jitter_str,
+                                 "--error-rate", error_rate_str,
+                                 NULL);
+        g_free (latency_str);
+        g_free (jitter_str);
+        if (mock == NULL)
+                return NULL;
+
+        output = g_data_input_stream_new
+                        (g_subprocess_get_stdout_pipe (mock));
+        *url = g_data_input_stream_read_line (output, NULL, NULL, error);
+        g_object_unref (output);
+        if (*url == NULL) {
+                if (error != NULL && *error == NULL)
+                        g_set_error_literal (error,
+                                             G_IO_ERROR,
+                                             G_IO_ERROR_FAILED,
+                                             "Mock service didn't start");
+                g_subprocess_force_exit (mock);
+                g_object_unref (mock);
+
+                return NULL;
+        }
+
+        return mock;
+}
+
+int
+main (int argc, char **argv)
+{
+        GOptionContext *context;
+        GSubprocess *mock;
+        GClueWifiScanner *scanner;
+        GClueLocationSource *gps;
+        GClueWifi *wifi;
+        char *dir, *url, *trace, *config;
+        guint n_allocations;
+        GError *error = NULL;
+
+        context = g_option_context_new ("MOCK-SERVICE - Benchmark the WiFi "
+                                        "source against a stand-in service");
+        g_option_context_add_main_entries (context, entries, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error)) {
+                g_printerr ("%s\n", error->message);
+
+                return EXIT_FAILURE;
+        }
+        g_option_context_free (context);
+        if (argc != 2) {
+                g_printerr ("Usage: %s [OPTION…] MOCK-SERVICE\n", argv[0]);
+
+                return EXIT_FAILURE;
+        }
+        n_scans = CLAMP (n_scans, 1, G_MAXUINT16);
+        n_aps = CLAMP (n_aps, 1, MAX_APS);
+        interval = MAX (interval, 1);
+
+        mock = spawn_mock_service (argv[1], &url, &error);
+        if (mock == NULL) {
+                g_printerr ("Failed to start the mock service: %s\n",
+                            error->message);
+                g_error_free (error);
+
+                return EXIT_FAILURE;
+        }
+
+        dir = g_dir_make_tmp ("geoclue-bench-XXXXXX", &error);
+        if (dir == NULL) {
+                g_printerr ("Failed to create a directory: %s\n",
+                            error->message);
+                g_error_free (error);
+                g_subprocess_force_exit (mock);
+
+                return EXIT_FAILURE;
+        }
+        trace = write_trace (dir);
+        config = write_config (dir, url, trace);
+        g_setenv ("GEOCLUE_CONFIG", config, TRUE);
+        g_setenv ("XDG_CACHE_HOME", dir, TRUE);
+        /* The base monitor always has full connectivity */
+        g_setenv ("GIO_USE_NETWORK_MONITOR", "base", TRUE);
+        g_setenv ("GIO_USE_PROXY_RESOLVER", "dummy", TRUE);
+
+        g_log_set_handler ("Geoclue", G_LOG_LEVEL_WARNING, on_log, NULL);
+        main_loop = g_main_loop_new (NULL, FALSE);
+        scan_times = g_new0 (gint64, n_scans);
+        fix_times = g_new0 (gint64, n_scans);
+
+        n_allocations = alloc_counter_get ();
+
+        /* Before the WiFi source, to see each scan before it does */
+        scanner = gclue_wifi_scanner_get_singleton ();
+        if (scanner == NULL) {
+                g_printerr ("Failed to replay the WiFi scans\n");
+                g_subprocess_force_exit (mock);
+
+                return EXIT_FAILURE;
+        }
+        g_signal_connect (scanner,
+                          "scan-done",
+                          G_CALLBACK (on_scan_done),
+                          NULL);
+        if (!no_tower)
+                gclue_cell_registry_set_tower
+                        (gclue_cell_registry_get_singleton (), &tower);
+
+        wifi = gclue_wifi_get_singleton (GCLUE_ACCURACY_LEVEL_STREET);
+        g_signal_connect (wifi,
+                          "notify::location",
+                          G_CALLBACK (on_location_notify),
+                          NULL);
+        gps = g_object_new (bench_gps_get_type (), NULL);
+        if (submit) {
+                gclue_web_source_set_submit_source (GCLUE_WEB_SOURCE (wifi),
+                                                    gps);
+                g_signal_connect_after (scanner,
+                                        "scan-done",
+                                        G_CALLBACK (on_scan_done_after),
+                                        gps);
+        }
+        gclue_location_source_start (GCLUE_LOCATION_SOURCE (wifi));
+
+        g_timeout_add ((guint) n_scans * interval + latency + jitter + 1000,
+                       on_timeout,
+                       NULL);
+        g_main_loop_run (main_loop);
+
+        n_allocations = alloc_counter_get () - n_allocations;
+        report (n_allocations);
+
+        gclue_location_source_stop (GCLUE_LOCATION_SOURCE (wifi));
+        g_object_unref (wifi);
+        g_object_unref (gps);
+        g_object_unref (scanner);
+        g_subprocess_send_signal (mock, SIGTERM);
+        g_subprocess_wait (mock, NULL, NULL);
+        g_object_unref (mock);
+
+        g_unlink (config);
+        g_unlink (trace);
+        g_rmdir (dir);
+        g_free (config);
+        g_free (trace);
+        g_free (dir);
+        g_free (url);
+        g_free (scan_times);
+        g_free (fix_times);
+        g_main_loop_unref (main_loop);
+
+        return (n_fixes > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,468 @@
+/* vim: set et ts=8 sw=8: */
+/* mock-service.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+#include "mock-service.h"
+
+/* A stand-in for the geolocation service, answering geolocate queries and
+ * taking submissions the way the Mozilla Location Service does, so the WiFi
+ * source can be run and benchmarked without depending on a real service.
+ * Each answer comes after a configurable delay, and a configurable share of
+ * the requests fails with a server error.
+ *
+ * Prints its base URL on stdout once it's listening, and how many requests
+ * it got on stderr when terminated.
+ */
+
+#define CELL_ACCURACY  1000.0  /* Meters */
+#define GEOIP_ACCURACY 25000.0 /* Meters */
+
+/* Commandline options */
+static gint port = 0;
+static gint latency = 0; /* ms */
+static gint jitter = 0;  /* ms */
+static gdouble error_rate = 0.0;
+static gint seed = 1;
+
+static GOptionEntry entries[] =
+{
+        { "port",
+          'p',
+          0,
+          G_OPTION_ARG_INT,
+          &port,
+          "Listen on port P of the loopback interface. "
+          "Default: 0 (any free port)",
+          "P" },
+        { "latency",
+          'l',
+          0,
+          G_OPTION_ARG_INT,
+          &latency,
+          "Answer each request after L milliseconds. Default: 0",
+          "L" },
+        { "jitter",
+          'j',
+          0,
+          G_OPTION_ARG_INT,
+          &jitter,
+          "Add up to J more milliseconds at random. Default: 0",
+          "J" },
+        { "error-rate",
+          'e',
+          0,
+          G_OPTION_ARG_DOUBLE,
+          &error_rate,
+          "Fail this share of the requests, between 0 and 1. Default: 0",
+          "R" },
+        { "seed",
+          's',
+          0,
+          G_OPTION_ARG_INT,
+          &seed,
+          "Seed of the latency and failures. Default: 1",
+          "S" },
+        { NULL }
+};
+
+static GRand *rand_gen;
+static guint n_queries = 0;
+static guint n_submissions = 0;
+static guint n_items = 0;
+static guint n_failures = 0;
+
+static const char parse_error[] =
+        "{\"error\":{\"errors\":[{\"domain\":\"global\","
+        "\"reason\":\"parseError\",\"message\":\"Parse Error\"}],"
+        "\"code\":400,\"message\":\"Parse Error\"}}";
+
+typedef struct {
+        SoupServer *server;
+        SoupMessage *msg;
+} DelayedAnswer;
+
+static gboolean
+on_delay_done (gpointer user_data)
+{
+        DelayedAnswer *answer = user_data;
+
+        soup_server_unpause_message (answer->server, answer->msg);
+        g_object_unref (answer->msg);
+        g_slice_free (DelayedAnswer, answer);
+
+        return FALSE;
+}
+
+/* Holds back the answer set on @msg as long as configured */
+static void
+delay_answer (SoupServer  *server,
+              SoupMessage *msg)
+{
+        DelayedAnswer *answer;
+        guint delay = latency;
+
+        if (jitter > 0)
+                delay += g_rand_int_range (rand_gen, 0, jitter + 1);
+        if (delay == 0)
+                return;
+
+        answer = g_slice_new (DelayedAnswer);
+        answer->server = server;
+        answer->msg = g_object_ref (msg);
+        soup_server_pause_message (server, msg);
+        g_timeout_add (delay, on_delay_done, answer);
+}
+
+static gboolean
+fail_on_purpose (SoupMessage *msg)
+{
+        if (g_rand_double (rand_gen) >= error_rate)
+                return FALSE;
+
+        n_failures++;
+        soup_message_set_status (msg, SOUP_STATUS_SERVICE_UNAVAILABLE);
+
+        return TRUE;
+}
+
+static JsonObject *
+parse_request (SoupMessage *msg,
+               JsonParser  *parser)
+{
+        SoupBuffer *body;
+        JsonNode *root;
+        gboolean parsed;
+
+        body = soup_message_body_flatten (msg->request_body);
+        parsed = json_parser_load_from_data (parser,
+                                             body->data,
+                                             body->length,
+                                             NULL);
+        soup_buffer_free (body);
+        if (!parsed)
+                return NULL;
+
+        root = json_parser_get_root (parser);
+        if (root == NULL || !JSON_NODE_HOLDS_OBJECT (root))
+                return NULL;
+
+        return json_node_get_object (root);
+}
+
+static JsonArray *
+get_array_member (JsonObject *object,
+                  const char *name)
+{
+        JsonNode *node;
+
+        node = json_object_get_member (object, name);
+        if (node == NULL || !JSON_NODE_HOLDS_ARRAY (node))
+                return NULL;
+
+        return json_node_get_array (node);
+}
+
+static const char *
+get_string_member (JsonObject *object,
+                   const char *name)
+{
+        JsonNode *node;
+
+        node = json_object_get_member (object, name);
+        if (node == NULL ||
+            !JSON_NODE_HOLDS_VALUE (node) ||
+            json_node_get_value_type (node) != G_TYPE_STRING)
+                return NULL;
+
+        return json_node_get_string (node);
+}
+
+static void
+place_by_hash (guint    hash,
+               gdouble *latitude,
+               gdouble *longitude)
+{
+        /* South of the grid, so it's never mistaken for a place on it */
+        *latitude = MOCK_GRID_LATITUDE - 0.01 -
+                    (hash % 1000) * MOCK_GRID_STEP;
+        *longitude = MOCK_GRID_LONGITUDE +
+                     (hash / 1000 % 1000) * MOCK_GRID_STEP;
+}
+
+static void
+place_access_point (const char *mac,
+                    gdouble    *latitude,
+                    gdouble    *longitude)
+{
+        guint cell_high, cell_low, index_high, index_low;
+
+        if (sscanf (mac,
+                    "02:00:%2x:%2x:%2x:%2x",
+                    &cell_high,
+                    &cell_low,
+                    &index_high,
+                    &index_low) == 4) {
+                *latitude = MOCK_GRID_LATITUDE +
+                            ((cell_high << 8) | cell_low) * MOCK_GRID_STEP;
+                *longitude = MOCK_GRID_LONGITUDE;
+
+                return;
+        }
+
+        place_by_hash (g_str_hash (mac), latitude, longitude);
+}
+
+/* The center of the access points, else the cell tower, else GeoIP */
+static char *
+locate (JsonObject *request)
+{
+        JsonArray *array;
+        gdouble latitude = 0.0, longitude = 0.0, accuracy;
+        char lat_str[G_ASCII_DTOSTR_BUF_SIZE];
+        char lng_str[G_ASCII_DTOSTR_BUF_SIZE];
+        char accuracy_str[G_ASCII_DTOSTR_BUF_SIZE];
+        guint i, n_aps = 0;
+
+        array = get_array_member (request, "wifiAccessPoints");
+        for (i = 0; array != NULL && i < json_array_get_length (array); i++) {
+                JsonNode *node = json_array_get_element (array, i);
+                const char *mac;
+                gdouble ap_latitude, ap_longitude;
+
+                if (!JSON_NODE_HOLDS_OBJECT (node))
+                        continue;
+                mac = get_string_member (json_node_get_object (node),
+                                         "macAddress");
+                if (mac == NULL)
+                        continue;
+
+                place_access_point (mac, &ap_latitude, &ap_longitude);
+                latitude += ap_latitude;
+                longitude += ap_longitude;
+                n_aps++;
+        }
+
+        array = get_array_member (request, "cellTowers");
+        if (n_aps > 0) {
+                latitude /= n_aps;
+                longitude /= n_aps;
+                accuracy = MOCK_GRID_ACCURACY;
+        } else if (array != NULL && json_array_get_length (array) > 0) {
+                JsonNode *node = json_array_get_element (array, 0);
+                char *tower;
+
+                tower = json_to_string (node, FALSE);
+                place_by_hash (g_str_hash (tower), &latitude, &longitude);
+                g_free (tower);
+                accuracy = CELL_ACCURACY;
+        } else {
+                place_by_hash (0, &latitude, &longitude);
+                accuracy = GEOIP_ACCURACY;
+        }
+
+        return g_strdup_printf
+                ("{\"location\":{\"lat\":%s,\"lng\":%s},\"accuracy\":%s}",
+                 g_ascii_dtostr (lat_str, sizeof (lat_str), latitude),
+                 g_ascii_dtostr (lng_str, sizeof (lng_str), longitude),
+                 g_ascii_dtostr (accuracy_str,
+                                 sizeof (accuracy_str),
+                                 accuracy));
+}
+
+static void
+handle_geolocate (SoupServer        *server,
+                  SoupMessage       *msg,
+                  const char        *path,
+                  GHashTable        *query,
+                  SoupClientContext *client,
+                  gpointer           user_data)
+{
+        JsonParser *parser;
+        JsonObject *request;
+        char *answer;
+
+        if (msg->method != SOUP_METHOD_POST) {
+                soup_message_set_status (msg, SOUP_STATUS_METHOD_NOT_ALLOWED);
+
+                return;
+        }
+        n_queries++;
+
+        if (fail_on_purpose (msg))
+                goto out;
+
+        parser = json_parser_new ();
+        request = parse_request (msg, parser);
+        if (request != NULL) {
+                answer = locate (request);
+                soup_message_set_status (msg, SOUP_STATUS_OK);
+                soup_message_set_response (msg,
+                                           "application/json",
+                                           SOUP_MEMORY_TAKE,
+                                           answer,
+                                           strlen (answer));
+        } else {
+                soup_message_set_status (msg, SOUP_STATUS_BAD_REQUEST);
+                soup_message_set_response (msg,
+                                           "application/json",
+                                           SOUP_MEMORY_STATIC,
+                                           parse_error,
+                                           strlen (parse_error));
+        }
+        g_object_unref (parser);
+
+out:
+        delay_answer (server, msg);
+}
+
+static void
+handle_submit (SoupServer        *server,
+               SoupMessage       *msg,
+               const char        *path,
+               GHashTable        *query,
+               SoupClientContext *client,
+               gpointer           user_data)
+{
+        JsonParser *parser;
+        JsonObject *request;
+        JsonArray *items = NULL;
+
+        if (msg->method != SOUP_METHOD_POST) {
+                soup_message_set_status (msg, SOUP_STATUS_METHOD_NOT_ALLOWED);
+
+                return;
+        }
+
+        if (fail_on_purpose (msg))
+                goto out;
+
+        parser = json_parser_new ();
+        request = parse_request (msg, parser);
+        if (request != NULL)
+                items = get_array_member (request, "items");
+
+        if (items != NULL) {
+                n_submissions++;
+                n_items += json_array_get_length (items);
+                soup_message_set_status (msg, SOUP_STATUS_OK);
+                soup_message_set_response (msg,
+                                           "application/json",
+                                           SOUP_MEMORY_STATIC,
+                                           "{}",
+                                           2);
+        } else {
+                soup_message_set_status (msg, SOUP_STATUS_BAD_REQUEST);
+                soup_message_set_response (msg,
+                                           "application/json",
+                                           SOUP_MEMORY_STATIC,
+                                           parse_error,
+                                           strlen (parse_error));
+        }
+        g_object_unref (parser);
+
+out:
+        delay_answer (server, msg);
+}
+
+static gboolean
+on_signal (gpointer user_data)
+{
+        g_main_loop_quit (user_data);
+
+        return FALSE;
+}
+
+int
+main (int argc, char **argv)
+{
+        GOptionContext *context;
+        SoupServer *server;
+        GMainLoop *main_loop;
+        GSList *uris;
+        char *uri;
+        GError *error = NULL;
+
+        context = g_option_context_new ("- Stand-in for the geolocation "
+                                        "service");
+        g_option_context_add_main_entries (context, entries, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error)) {
+                g_printerr ("%s\n", error->message);
+
+                return EXIT_FAILURE;
+        }
+        g_option_context_free (context);
+
+        rand_gen = g_rand_new_with_seed (seed);
+        server = soup_server_new (SOUP_SERVER_SERVER_HEADER,
+                                  "geoclue-mock-service ",
+                                  NULL);
+        soup_server_add_handler (server,
+                                 "/v1/geolocate",
+                                 handle_geolocate,
+                                 NULL,
+                                 NULL);
+        soup_server_add_handler (server,
+                                 "/v1/submit",
+                                 handle_submit,
+                                 NULL,
+                                 NULL);
+        if (!soup_server_listen_local (server,
+                                       port,
+                                       SOUP_SERVER_LISTEN_IPV4_ONLY,
+                                       &error)) {
+                g_printerr ("Failed to listen: %s\n", error->message);
+
+                return EXIT_FAILURE;
+        }
+
+        uris = soup_server_get_uris (server);
+        uri = soup_uri_to_string (uris->data, FALSE);
+        g_print ("%s\n", uri);
+        fflush (stdout);
+        g_free (uri);
+        g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+
+        main_loop = g_main_loop_new (NULL, FALSE);
+        g_unix_signal_add (SIGINT, on_signal, main_loop);
+        g_unix_signal_add (SIGTERM, on_signal, main_loop);
+        g_main_loop_run (main_loop);
+
+        g_printerr ("Mock service: %u queries, %u submissions of %u items, "
+                    "%u failed on purpose\n",
+                    n_queries,
+                    n_submissions,
+                    n_items,
+                    n_failures);
+
+        g_main_loop_unref (main_loop);
+        g_object_unref (server);
+        g_rand_free (rand_gen);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+/* vim: set et ts=8 sw=8: */
+/* mock-service.h
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#ifndef MOCK_SERVICE_H
+#define MOCK_SERVICE_H
+
+/* The stand-in service places access points with a BSSID of the form
+ * 02:00:CC:CC:AA:AA on a grid, CCCC being the index of the cell they are in
+ * and AAAA that of the access point in the cell. The cells are lined up
+ * northwards from the origin. Other access points are placed by a hash of
+ * their BSSID, close to the grid but not on it.
+ */
+#define MOCK_GRID_BSSID_FORMAT "02:00:%02x:%02x:%02x:%02x"
+#define MOCK_GRID_LATITUDE     45.0
+#define MOCK_GRID_LONGITUDE    5.0
+#define MOCK_GRID_STEP         0.0001 /* Degrees of latitude, about 11 m */
+#define MOCK_GRID_ACCURACY     20.0   /* Meters */
+
+#endif /* MOCK_SERVICE_H */
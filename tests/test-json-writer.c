@@ -0,0 +1,216 @@
+/* vim: set et ts=8 sw=8: */
+/* test-json-writer.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <locale.h>
+#include <string.h>
+#include <glib.h>
+#include <json-glib/json-glib.h>
+#include "gclue-json-writer.h"
+
+/* Like SSIDs can be, as they're whatever the access point owner chose */
+static const char *strings[] = {
+        "",
+        "Plain",
+        "Has \"quotes\"",
+        "Back\\slash\\",
+        "Control\x01 \x1f characters",
+        "New\nline, tab\t, return\r, backspace\b and form feed\f",
+        "Caf\xc3\xa9 \xe2\x98\x95 \xf0\x9f\x93\xb6",
+        "Delete\x7f",
+        "/* \"\\u0041\" */",
+        "Thirty-two bytes long SSID .....",
+};
+
+static const gint64 ints[] = {
+        0, -1, 1, 42, -122, G_MAXINT32, (gint64) G_MAXUINT32 + 1, -G_MAXINT32,
+};
+
+static const gdouble doubles[] = {
+        0.0, 0.5, -0.1, 51.5073219, -122.084, 180.0, 1e-7, 6.02214076e23,
+};
+
+static JsonNode *
+parse (const GString *json)
+{
+        JsonParser *parser;
+        JsonNode *root;
+        GError *error = NULL;
+
+        parser = json_parser_new ();
+        json_parser_load_from_data (parser, json->str, json->len, &error);
+        g_assert_no_error (error);
+        root = json_node_copy (json_parser_get_root (parser));
+        g_object_unref (parser);
+
+        return root;
+}
+
+static void
+test_escaping (void)
+{
+        GString *json;
+
+        json = g_string_new (NULL);
+        gclue_json_begin (json, '[');
+        gclue_json_append_string (json, "a\"b\\c\nd\x01");
+        gclue_json_append_string (json, "\xc3\xa9");
+        gclue_json_end (json, ']');
+
+        g_assert_cmpstr (json->str,
+                         ==,
+                         "[\"a\\\"b\\\\c\\nd\\u0001\",\"\xc3\xa9\"]");
+
+        g_string_free (json, TRUE);
+}
+
+static void
+test_strings (void)
+{
+        GString *json;
+        JsonNode *root;
+        JsonArray *array;
+        JsonObject *object;
+        guint i;
+
+        json = g_string_new (NULL);
+        gclue_json_begin (json, '{');
+        gclue_json_append_name (json, "values");
+        gclue_json_begin (json, '[');
+        for (i = 0; i < G_N_ELEMENTS (strings); i++)
+                gclue_json_append_string (json, strings[i]);
+        gclue_json_end (json, ']');
+        gclue_json_append_name (json, "names");
+        gclue_json_begin (json, '{');
+        for (i = 1; i < G_N_ELEMENTS (strings); i++) {
+                gclue_json_append_name (json, strings[i]);
+                gclue_json_append_int (json, i);
+        }
+        gclue_json_end (json, '}');
+        gclue_json_end (json, '}');
+
+        g_test_message ("%s", json->str);
+        root = parse (json);
+        object = json_node_get_object (root);
+
+        array = json_object_get_array_member (object, "values");
+        g_assert_cmpuint (json_array_get_length (array),
+                          ==,
+                          G_N_ELEMENTS (strings));
+        for (i = 0; i < G_N_ELEMENTS (strings); i++)
+                g_assert_cmpstr (json_array_get_string_element (array, i),
+                                 ==,
+                                 strings[i]);
+
+        object = json_object_get_object_member (object, "names");
+        for (i = 1; i < G_N_ELEMENTS (strings); i++)
+                g_assert_cmpint (json_object_get_int_member (object,
+                                                             strings[i]),
+                                 ==,
+                                 i);
+
+        json_node_free (root);
+        g_string_free (json, TRUE);
+}
+
+static void
+check_numbers (void)
+{
+        GString *json;
+        JsonNode *root;
+        JsonArray *array;
+        guint i;
+
+        json = g_string_new (NULL);
+        gclue_json_begin (json, '[');
+        for (i = 0; i < G_N_ELEMENTS (ints); i++)
+                gclue_json_append_int (json, ints[i]);
+        for (i = 0; i < G_N_ELEMENTS (doubles); i++)
+                gclue_json_append_double (json, doubles[i]);
+        gclue_json_end (json, ']');
+
+        g_test_message ("%s", json->str);
+        root = parse (json);
+        array = json_node_get_array (root);
+
+        g_assert_cmpuint (json_array_get_length (array),
+                          ==,
+                          G_N_ELEMENTS (ints) + G_N_ELEMENTS (doubles));
+        for (i = 0; i < G_N_ELEMENTS (ints); i++)
+                g_assert_cmpint (json_array_get_int_element (array, i),
+                                 ==,
+                                 ints[i]);
+        /* Read back exactly, not just approximately */
+        for (i = 0; i < G_N_ELEMENTS (doubles); i++)
+                g_assert_cmpfloat (json_array_get_double_element
+                                        (array, G_N_ELEMENTS (ints) + i),
+                                   ==,
+                                   doubles[i]);
+
+        json_node_free (root);
+        g_string_free (json, TRUE);
+}
+
+static void
+test_numbers (void)
+{
+        check_numbers ();
+}
+
+/* Numbers must not follow the locale, e.g get a ',' as decimal point */
+static void
+test_numbers_locale (void)
+{
+        const char *locales[] = { "de_DE.UTF-8", "fr_FR.UTF-8", "nl_NL.UTF-8",
+                                  "ru_RU.UTF-8", "de_DE", "fr_FR", NULL };
+        char *old_locale;
+        guint i;
+
+        old_locale = g_strdup (setlocale (LC_NUMERIC, NULL));
+
+        for (i = 0; locales[i] != NULL; i++)
+                if (setlocale (LC_NUMERIC, locales[i]) != NULL &&
+                    strcmp (localeconv ()->decimal_point, ",") == 0)
+                        break;
+
+        if (locales[i] != NULL) {
+                g_test_message ("Using the %s locale", locales[i]);
+                check_numbers ();
+        } else {
+                g_test_skip ("No locale with a ',' as decimal point");
+        }
+
+        setlocale (LC_NUMERIC, old_locale);
+        g_free (old_locale);
+}
+
+int
+main (int argc, char **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/json-writer/escaping", test_escaping);
+        g_test_add_func ("/json-writer/strings", test_strings);
+        g_test_add_func ("/json-writer/numbers", test_numbers);
+        g_test_add_func ("/json-writer/numbers-locale", test_numbers_locale);
+
+        return g_test_run ();
+}
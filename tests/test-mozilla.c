@@ -0,0 +1,482 @@
+/* vim: set et ts=8 sw=8: */
+/* test-mozilla.c
+ *
+ * Copyright 2026 agent
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: agent <agent@local>
+ */
+
+#include <math.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include "gclue-mozilla.h"
+
+static const char config[] =
+        "[agent]\n"
+        "whitelist=\n"
+        "[wifi]\n"
+        "url=http://localhost/v1/geolocate\n"
+        "submit-data=true\n"
+        "submission-url=http://localhost/v1/submit\n"
+        "submission-nick=geoclue-test\n";
+
+typedef struct {
+        const char *description;
+        const char *json;
+        gdouble latitude;
+        gdouble longitude;
+        gdouble accuracy;
+} ValidReply;
+
+static const ValidReply valid_replies[] = {
+        { "Mozilla Location Service",
+          "{\"location\": {\"lat\": 51.0, \"lng\": -0.1}, \"accuracy\": 600.0}",
+          51.0, -0.1, 600.0 },
+        { "Google, with a fallback",
+          "{\"location\":{\"lat\":37.4219983,\"lng\":-122.084},"
+          "\"accuracy\":15.25,\"fallback\":\"ipf\"}",
+          37.4219983, -122.084, 15.25 },
+        { "Integers",
+          "{\"location\":{\"lat\":-33,\"lng\":151},\"accuracy\":1000}",
+          -33.0, 151.0, 1000.0 },
+        { "Numbers in exponent form",
+          "{\"location\":{\"lat\":5.1E1,\"lng\":-1e-1},\"accuracy\":6e+2}",
+          51.0, -0.1, 600.0 },
+        { "Members in another order, nested objects and arrays",
+          "{\"accuracy\":20,"
+          "\"extra\":{\"a\":[1,{\"b\":[]},\"x\",[[-2.5e3]]],\"c\":null},"
+          "\"location\":{\"alt\":{\"v\":true,\"w\":false},"
+          "\"lng\":2.35,\"lat\":48.85}}",
+          48.85, 2.35, 20.0 },
+        { "Escaped strings",
+          "{\"note\":\"a \\\"quoted\\\" \\\\ \\u00e9 string\","
+          "\"location\":{\"lat\":1.5,\"lng\":2.5},\"accuracy\":3}",
+          1.5, 2.5, 3.0 },
+        { "Escaped keys",
+          "{\"loc\\u0061tion\":{\"l\\u0061t\":1.5,\"lng\":2.5},"
+          "\"\\u0061ccuracy\":3}",
+          1.5, 2.5, 3.0 },
+        { "Whitespace everywhere",
+          " \n{ \"location\" : { \"lat\" : -33.9 ,\t\"lng\" : 151.2 } ,"
+          "\r\n \"accuracy\" : 1000 }\n ",
+          -33.9, 151.2, 1000.0 },
+};
+
+typedef struct {
+        const char *description;
+        const char *json;
+        gint code;
+        const char *message;
+} ErrorReply;
+
+static const ErrorReply error_replies[] = {
+        { "Mozilla Location Service, not found",
+          "{\"error\":{\"errors\":[{\"domain\":\"geolocation\","
+          "\"reason\":\"notFound\",\"message\":\"Not found\"}],"
+          "\"code\":404,\"message\":\"Not found\"}}",
+          404, "Not found" },
+        { "Google, no API key",
+          "{\"error\":{\"code\":403,"
+          "\"message\":\"The request is missing a valid API key.\","
+          "\"status\":\"PERMISSION_DENIED\"}}",
+          403, "The request is missing a valid API key." },
+        { "Error that is not an object",
+          "{\"error\":\"Not found\"}",
+          0, "Unknown error" },
+};
+
+typedef struct {
+        const char *description;
+        const char *json;
+} InvalidReply;
+
+static const InvalidReply invalid_replies[] = {
+        { "Empty", "" },
+        { "Not an object", "[1,2,3]" },
+        { "Truncated",
+          "{\"location\":{\"lat\":1,\"lng\":2},\"accuracy\":3" },
+        { "Unterminated string",
+          "{\"location\":{\"lat\":1,\"lng\":2},\"accuracy\":3,\"a\":\"b}" },
+        { "Trailing comma",
+          "{\"location\":{\"lat\":1,\"lng\":2},\"accuracy\":3,}" },
+        { "Extra closing brace",
+          "{\"location\":{\"lat\":1,\"lng\":2},\"accuracy\":3}}" },
+        { "No location",
+          "{\"accuracy\":3}" },
+        { "No accuracy",
+          "{\"location\":{\"lat\":1,\"lng\":2}}" },
+        { "No longitude",
+          "{\"location\":{\"lat\":1},\"accuracy\":3}" },
+        { "Location is an array",
+          "{\"location\":[1,2],\"accuracy\":3}" },
+        { "Latitude is a string",
+          "{\"location\":{\"lat\":\"1\",\"lng\":2},\"accuracy\":3}" },
+        { "Accuracy is null",
+          "{\"location\":{\"lat\":1,\"lng\":2},\"accuracy\":null}" },
+        { "Not a number",
+          "{\"location\":{\"lat\":nan,\"lng\":2},\"accuracy\":3}" },
+        { "Latitude out of range",
+          "{\"location\":{\"lat\":91,\"lng\":2},\"accuracy\":3}" },
+        { "Negative accuracy",
+          "{\"location\":{\"lat\":1,\"lng\":2},\"accuracy\":-5}" },
+};
+
+static void
+assert_location (GClueLocation *location,
+                 gdouble        latitude,
+                 gdouble        longitude,
+                 gdouble        accuracy)
+{
+        g_assert_nonnull (location);
+        g_assert_cmpfloat (fabs (gclue_location_get_latitude (location) -
+                                 latitude), <, 1e-9);
+        g_assert_cmpfloat (fabs (gclue_location_get_longitude (location) -
+                                 longitude), <, 1e-9);
+        g_assert_cmpfloat (fabs (gclue_location_get_accuracy (location) -
+                                 accuracy), <, 1e-9);
+}
+
+static void
+test_parse_valid (void)
+{
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (valid_replies); i++) {
+                const ValidReply *reply = &valid_replies[i];
+                GClueLocation *location;
+                GError *error = NULL;
+
+                g_test_message ("%s", reply->description);
+
+                location = gclue_mozilla_parse_response (reply->json, &error);
+                g_assert_no_error (error);
+                assert_location (location,
+                                 reply->latitude,
+                                 reply->longitude,
+                                 reply->accuracy);
+                g_object_unref (location);
+        }
+}
+
+static void
+test_parse_error (void)
+{
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (error_replies); i++) {
+                const ErrorReply *reply = &error_replies[i];
+                GClueLocation *location;
+                GError *error = NULL;
+
+                g_test_message ("%s", reply->description);
+
+                location = gclue_mozilla_parse_response (reply->json, &error);
+                g_assert_null (location);
+                g_assert_error (error, G_IO_ERROR, reply->code);
+                g_assert_cmpstr (error->message, ==, reply->message);
+                g_error_free (error);
+        }
+}
+
+static void
+test_parse_invalid (void)
+{
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (invalid_replies); i++) {
+                const InvalidReply *reply = &invalid_replies[i];
+                GClueLocation *location;
+                GError *error = NULL;
+
+                g_test_message ("%s", reply->description);
+
+                location = gclue_mozilla_parse_response (reply->json, &error);
+                g_assert_null (location);
+                g_assert_nonnull (error);
+                g_error_free (error);
+        }
+}
+
+/* Deeper than the pull parser goes, so the full parser has to take it */
+static void
+test_parse_deep (void)
+{
+        GClueLocation *location;
+        GString *json;
+        GError *error = NULL;
+        guint i;
+
+        json = g_string_new ("{\"deep\":");
+        for (i = 0; i < 20; i++)
+                g_string_append (json, "[{\"a\":");
+        g_string_append (json, "1");
+        for (i = 0; i < 20; i++)
+                g_string_append (json, "}]");
+        g_string_append (json,
+                         ",\"location\":{\"lat\":1.5,\"lng\":2.5},"
+                         "\"accuracy\":3}");
+
+        location = gclue_mozilla_parse_response (json->str, &error);
+        g_assert_no_error (error);
+        assert_location (location, 1.5, 2.5, 3.0);
+
+        g_object_unref (location);
+        g_string_free (json, TRUE);
+}
+
+typedef struct {
+        const char *mac;
+        const char *ssid;
+        gint16 signal;
+        guint16 frequency;
+} AccessPoint;
+
+/* In the order of their BSSIDs, as in scans */
+static const AccessPoint access_points[] = {
+        { "02:00:00:00:00:01", "Home", -45, 5180 },
+        { "02:00:00:00:00:02", "Back\\slash", -70, 2437 },
+        { "02:00:00:00:00:03", "Caf\xc3\xa9 \"WiFi\"", -60, 2412 },
+};
+
+static GClueWifiScan *
+create_scan (void)
+{
+        GHashTable *records;
+        GClueWifiScan *scan;
+        guint i;
+
+        records = g_hash_table_new_full (g_int64_hash,
+                                         g_int64_equal,
+                                         NULL,
+                                         (GDestroyNotify) gclue_wifi_bss_free);
+
+        /* Inserted backwards, to check the payloads follow the scan order */
+        for (i = G_N_ELEMENTS (access_points); i > 0; i--) {
+                const AccessPoint *ap = &access_points[i - 1];
+                GClueWifiBSS *bss;
+
+                bss = gclue_wifi_bss_new_for_mac (ap->mac, ap->ssid, i);
+                bss->signal = ap->signal;
+                bss->frequency = ap->frequency;
+                bss->last_seen = g_get_monotonic_time ();
+                g_hash_table_insert (records, &bss->bssid, bss);
+        }
+
+        scan = gclue_wifi_scan_new (records, -90, 0);
+        g_hash_table_unref (records);
+
+        return scan;
+}
+
+static JsonObject *
+parse_object (JsonParser *parser,
+              const char *json,
+              gssize      length)
+{
+        GError *error = NULL;
+
+        json_parser_load_from_data (parser, json, length, &error);
+        g_assert_no_error (error);
+        g_assert_true (JSON_NODE_HOLDS_OBJECT (json_parser_get_root (parser)));
+
+        return json_node_get_object (json_parser_get_root (parser));
+}
+
+static void
+test_create_query (void)
+{
+        GClue3GTower tower = { 234, 15, 0x1234, 0xabcdef };
+        GClueWifiScan *scan;
+        SoupMessage *msg;
+        JsonParser *parser;
+        JsonObject *object;
+        JsonArray *array;
+        GError *error = NULL;
+        guint i;
+
+        scan = create_scan ();
+        msg = gclue_mozilla_create_query (scan, &tower, &error);
+        g_assert_no_error (error);
+        g_assert_nonnull (msg);
+        g_assert_cmpstr (soup_uri_get_path (soup_message_get_uri (msg)),
+                         ==,
+                         "/v1/geolocate");
+
+        parser = json_parser_new ();
+        object = parse_object (parser,
+                               msg->request_body->data,
+                               msg->request_body->length);
+
+        g_assert_cmpstr (json_object_get_string_member (object, "radioType"),
+                         ==,
+                         "gsm");
+
+        array = json_object_get_array_member (object, "cellTowers");
+        g_assert_cmpuint (json_array_get_length (array), ==, 1);
+        object = json_array_get_object_element (array, 0);
+        g_assert_cmpint (json_object_get_int_member (object, "cellId"),
+                         ==,
+                         tower.cell_id);
+        g_assert_cmpint (json_object_get_int_member (object,
+                                                     "mobileCountryCode"),
+                         ==,
+                         tower.mcc);
+        g_assert_cmpint (json_object_get_int_member (object,
+                                                     "mobileNetworkCode"),
+                         ==,
+                         tower.mnc);
+        g_assert_cmpint (json_object_get_int_member (object,
+                                                     "locationAreaCode"),
+                         ==,
+                         tower.lac);
+
+        object = json_node_get_object (json_parser_get_root (parser));
+        array = json_object_get_array_member (object, "wifiAccessPoints");
+        g_assert_cmpuint (json_array_get_length (array),
+                          ==,
+                          G_N_ELEMENTS (access_points));
+        for (i = 0; i < G_N_ELEMENTS (access_points); i++) {
+                object = json_array_get_object_element (array, i);
+                g_assert_cmpstr (json_object_get_string_member (object,
+                                                                "macAddress"),
+                                 ==,
+                                 access_points[i].mac);
+                g_assert_cmpint (json_object_get_int_member (object,
+                                                             "signalStrength"),
+                                 ==,
+                                 access_points[i].signal);
+        }
+
+        g_object_unref (parser);
+        g_object_unref (msg);
+        gclue_wifi_scan_unref (scan);
+}
+
+static void
+test_create_submission (void)
+{
+        GClueLocation *location;
+        GClueWifiScan *scan;
+        GClueSubmission *submission;
+        JsonParser *parser;
+        JsonObject *object;
+        JsonArray *array;
+        GError *error = NULL;
+        guint i;
+
+        location = gclue_location_new_full (51.5073219,
+                                            -0.1276474,
+                                            25.5,
+                                            GCLUE_LOCATION_SPEED_UNKNOWN,
+                                            GCLUE_LOCATION_HEADING_UNKNOWN,
+                                            11.25,
+                                            1600000000,
+                                            NULL);
+        scan = create_scan ();
+        submission = gclue_mozilla_create_submission (location,
+                                                      scan,
+                                                      NULL,
+                                                      &error);
+        g_assert_no_error (error);
+        g_assert_nonnull (submission);
+        g_assert_cmpstr (submission->url, ==, "http://localhost/v1/submit");
+        g_assert_cmpstr (submission->nick, ==, "geoclue-test");
+        g_assert_cmpstr (submission->networks,
+                         ==,
+                         "02:00:00:00:00:01,"
+                         "02:00:00:00:00:02,"
+                         "02:00:00:00:00:03");
+
+        parser = json_parser_new ();
+        object = parse_object (parser, submission->item, -1);
+
+        /* Read back exactly, not just approximately */
+        g_assert_cmpfloat (json_object_get_double_member (object, "lat"),
+                           ==,
+                           51.5073219);
+        g_assert_cmpfloat (json_object_get_double_member (object, "lon"),
+                           ==,
+                           -0.1276474);
+        g_assert_cmpfloat (json_object_get_double_member (object, "accuracy"),
+                           ==,
+                           25.5);
+        g_assert_cmpfloat (json_object_get_double_member (object, "altitude"),
+                           ==,
+                           11.25);
+        g_assert_cmpstr (json_object_get_string_member (object, "time"),
+                         ==,
+                         "2020-09-13T12:26:40Z");
+        g_assert_false (json_object_has_member (object, "cell"));
+
+        array = json_object_get_array_member (object, "wifi");
+        g_assert_cmpuint (json_array_get_length (array),
+                          ==,
+                          G_N_ELEMENTS (access_points));
+        for (i = 0; i < G_N_ELEMENTS (access_points); i++) {
+                object = json_array_get_object_element (array, i);
+                g_assert_cmpstr (json_object_get_string_member (object, "key"),
+                                 ==,
+                                 access_points[i].mac);
+                g_assert_cmpint (json_object_get_int_member (object, "signal"),
+                                 ==,
+                                 access_points[i].signal);
+                g_assert_cmpint (json_object_get_int_member (object,
+                                                             "frequency"),
+                                 ==,
+                                 access_points[i].frequency);
+        }
+
+        g_object_unref (parser);
+        gclue_submission_free (submission);
+        gclue_wifi_scan_unref (scan);
+        g_object_unref (location);
+}
+
+int
+main (int argc, char **argv)
+{
+        char *dir, *path;
+        GError *error = NULL;
+        int ret;
+
+        g_test_init (&argc, &argv, NULL);
+
+        dir = g_dir_make_tmp ("geoclue-test-XXXXXX", &error);
+        g_assert_no_error (error);
+        path = g_build_filename (dir, "geoclue.conf", NULL);
+        g_file_set_contents (path, config, -1, &error);
+        g_assert_no_error (error);
+        g_setenv ("GEOCLUE_CONFIG", path, TRUE);
+
+        g_test_add_func ("/mozilla/parse-response/valid", test_parse_valid);
+        g_test_add_func ("/mozilla/parse-response/error", test_parse_error);
+        g_test_add_func ("/mozilla/parse-response/invalid",
+                         test_parse_invalid);
+        g_test_add_func ("/mozilla/parse-response/deep", test_parse_deep);
+        g_test_add_func ("/mozilla/create-query", test_create_query);
+        g_test_add_func ("/mozilla/create-submission", test_create_submission);
+
+        ret = g_test_run ();
+
+        g_unlink (path);
+        g_rmdir (dir);
+        g_free (path);
+        g_free (dir);
+
+        return ret;
+}